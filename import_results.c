@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include "results.h"
+#include "syslinks.h"
+
+int main(int argc, const char **argv) {
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <results log> [<instances directory>]\n", argv[0]);
+        return -1;
+    }
+
+    // Without an explicit tree, the instances directory is imported, as seen from the executables directory
+    char root[1024];
+    if (argc == 3) {
+        snprintf(root, sizeof(root), "%s", argv[2]);
+    } else {
+        snprintf(root, sizeof(root), "..%cinstances", path_sep());
+    }
+
+    const int64_t num_imported = import_results_tree(root, argv[1]);
+    if (num_imported < 0) {
+        printf("Error: Could not import %s into %s.", root, argv[1]);
+        return -1;
+    }
+
+    results_index_t index;
+    if (!load_results_index(argv[1], &index)) {
+        printf("Error: Could not read %s.", argv[1]);
+        return -1;
+    }
+    printf("Imported %lld runs; %s holds %zu distinct runs, %zu superseded and %zu damaged records.\n",
+           (long long) num_imported, argv[1], index.num_records, index.num_superseded, index.num_damaged);
+    free_results_index(&index);
+    return 0;
+}
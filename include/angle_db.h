@@ -0,0 +1,145 @@
+#ifndef ANGLE_DB_H
+#define ANGLE_DB_H
+
+
+/*
+ * =============================================================================
+ *                                includes
+ * =============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/*
+ * =============================================================================
+ *                                C++ check
+ * =============================================================================
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                              Type definitions
+ * =============================================================================
+ */
+
+/*
+ * Struct:              angle_key_t
+ * ---------------------------
+ * Description:         Describes the QAOA and the instance that a set of optimized angles belongs to. Angles are only
+ *                      transferred between equal QAOA types, problem types and depths; the instance features determine
+ *                      the distance between two keys.
+ * Contents:
+ *      qaoa:           Name of the QAOA type, i.e. "qtg" or "copula".
+ *      quadratic:      Whether the instance is a quadratic knapsack instance.
+ *      depth:          Depth of the QAOA.
+ *      size:           Number of items.
+ *      capacity_ratio: Capacity divided by the total cost of all items.
+ *      num_groups:     Number of item groups of the instance generator; 0 if unknown, e.g. for instances whose
+ *                      name does not carry it.
+ *      mean_profit:    Mean profit per item; gamma values are rescaled by it when being transferred.
+ */
+typedef struct angle_key {
+    char qaoa[16];
+    int quadratic;
+    int depth;
+    int size;
+    double capacity_ratio;
+    int num_groups;
+    double mean_profit;
+} angle_key_t;
+
+
+/*
+ * Struct:              angle_record_t
+ * ---------------------------
+ * Description:         One entry of the angle database.
+ * Contents:
+ *      key:            Key of the entry.
+ *      approx_ratio:   Total approximation ratio reached by the angles.
+ *      angles:         The 2 * depth optimized angles, gamma values at even and beta values at odd positions.
+ */
+typedef struct angle_record {
+    angle_key_t key;
+    double approx_ratio;
+    double* angles;
+} angle_record_t;
+
+
+/*
+ * =============================================================================
+ *                                  Access
+ * =============================================================================
+ */
+
+/*
+ * Function:            angle_key_distance
+ * --------------------
+ * Description:         Computes the distance between the instance features of two keys as the sum of the relative
+ *                      size difference, the capacity ratio difference and the relative group count difference. The
+ *                      group count only counts if it is known for both keys.
+ * Parameters:
+ *      key1:           Pointer to the first key.
+ *      key2:           Pointer to the second key.
+ * Returns:             The distance, or INFINITY if the keys differ in the QAOA type, problem type or depth.
+ */
+double angle_key_distance(const angle_key_t* key1, const angle_key_t* key2);
+
+
+/*
+ * Function:            angle_db_append
+ * --------------------
+ * Description:         Appends an entry to the angle database, which is a text file holding one entry per line. Each
+ *                      entry is written by a single write in append mode, so that concurrent runs may share the file.
+ * Parameters:
+ *      path:           Pointer to the path of the database file; the file is created if necessary.
+ *      key:            Pointer to the key of the entry.
+ *      approx_ratio:   Total approximation ratio reached by the angles.
+ *      angles:         Pointer to the 2 * key->depth optimized angles.
+ * Returns:             Whether the entry has been written.
+ */
+int angle_db_append(const char* path, const angle_key_t* key, double approx_ratio, const double* angles);
+
+
+/*
+ * Function:            angle_db_nearest
+ * --------------------
+ * Description:         Looks up the entries of the angle database whose keys are nearest to the given key. Only
+ *                      entries with finite distance qualify; among equally distant entries, the one with the higher
+ *                      approximation ratio comes first. The file is read into an in-memory index once per process,
+ *                      which is extended by the entries appended since the previous lookup; only the entries of the
+ *                      same QAOA type, problem type and depth are compared.
+ * Parameters:
+ *      path:           Pointer to the path of the database file.
+ *      key:            Pointer to the key to be looked up.
+ *      max_records:    Maximal number of entries to be returned.
+ *      records:        Pointer to storage for max_records entries; will be set, nearest first.
+ * Returns:             The number of entries found.
+ * Side Effect:         Allocates the angles of the returned entries dynamically; should be freed via
+ *                      free_angle_records.
+ */
+int angle_db_nearest(const char* path, const angle_key_t* key, int max_records, angle_record_t* records);
+
+
+/*
+ * Function:            free_angle_records
+ * --------------------
+ * Description:         Frees the angles of database entries.
+ * Parameters:
+ *      records:        Pointer to the entries.
+ *      num_records:    Number of entries.
+ */
+void free_angle_records(angle_record_t* records, int num_records);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ANGLE_DB_H
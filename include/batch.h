@@ -0,0 +1,145 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+
+/*
+ * =============================================================================
+ *                                includes
+ * =============================================================================
+ */
+
+#include "qaoa.h"
+
+
+/*
+ * =============================================================================
+ *                                C++ check
+ * =============================================================================
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define BATCH_PAD               8 // Amplitudes every segment is padded to a multiple of, i.e. a cache line of doubles
+#define BATCH_MAX_STATES        16384 // Largest number of states of an instance that is batched with others
+#define BATCH_MAX_INSTANCES     256 // Largest number of instances of a single batch
+
+
+/*
+ * =============================================================================
+ *                              Type definitions
+ * =============================================================================
+ */
+
+/*
+ * Struct:              batch_t
+ * ---------------------------
+ * Description:         Many small QTG instances of the same depth, whose state vectors are packed into one buffer as
+ *                      structure of arrays, i.e. real and imaginary parts apart. Every instance owns a segment of the
+ *                      buffer that is padded with states of amplitude and profit 0, which the evolution leaves at 0.
+ * Contents:
+ *      num_instances:  Number of instances.
+ *      depth:          Depth of the QAOA of all instances.
+ *      num_amplitudes: Length of the buffer, including the padding.
+ *      offsets:        Start of the segment of every instance, followed by num_amplitudes.
+ *      init:           Real initial amplitude of every state, see qtg_initial_state_prep.
+ *      profits:        Profit of every state.
+ *      gamma_periods:  Period of gamma of every instance, see compute_gamma_period.
+ *      re:             Real parts of the evolved amplitudes.
+ *      im:             Imaginary parts of the evolved amplitudes.
+ */
+typedef struct batch {
+    int num_instances;
+    int depth;
+    size_t num_amplitudes;
+    size_t* offsets;
+    double* init;
+    double* profits;
+    double* gamma_periods;
+    double* re;
+    double* im;
+} batch_t;
+
+
+/*
+ * =============================================================================
+ *                                  Batches
+ * =============================================================================
+ */
+
+/*
+ * Function:            create_batch
+ * --------------------
+ * Description:         Packs the initial states and the profits of prepared QTG instances into a batch.
+ * Parameters:
+ *      prepared:       Pointer to the preparations of the instances; all of type QTG on the statevector backend.
+ *      num_instances:  Number of instances.
+ *      depth:          Depth of the QAOA of all instances.
+ * Returns:             Pointer to the batch.
+ * Side Effect:         Allocates dynamically; should eventually be freed via free_batch.
+ */
+batch_t* create_batch(instance_context_t** prepared, int num_instances, int depth);
+
+
+/*
+ * Function:            free_batch
+ * --------------------
+ * Description:         Frees a batch together with its buffers.
+ * Parameters:
+ *      batch:          Pointer to the batch.
+ */
+void free_batch(batch_t* batch);
+
+
+/*
+ * =============================================================================
+ *                                 Evaluation
+ * =============================================================================
+ */
+
+/*
+ * Function:            evaluate_batch
+ * --------------------
+ * Description:         Evolves all instances of a batch in lockstep, each with angles of its own, and computes their
+ *                      expectation values. Every layer is a single pass over a segment, which applies the Grover
+ *                      mixer of the previous layer, rotates the phases and accumulates the scalar product with the
+ *                      initial state for the next mixer; a last pass applies the final mixer and accumulates the
+ *                      expectation value. The instances are distributed among the threads.
+ * Parameters:
+ *      batch:          Pointer to the batch.
+ *      angles:         Pointer to the angles, 2 * depth per instance in the order of the instances.
+ *      num_layers:     Number of leading layers to evolve, at most the depth; the angles of the others must be 0.
+ *      values:         Pointer to the expectation value of every instance; will be set.
+ */
+void evaluate_batch(batch_t* batch, const double* angles, int num_layers, double* values);
+
+
+/*
+ * Function:            batch_grid_search
+ * --------------------
+ * Description:         Layer-wise fine-grid search of all instances of a batch in lockstep, with the same grid points
+ *                      and ties as fine_grid_search with a single candidate, scaled by the period of gamma of every
+ *                      instance. Every grid point is evaluated for all instances by a single call of evaluate_batch.
+ * Parameters:
+ *      batch:          Pointer to the batch.
+ *      m:              Grid resolution per angle.
+ *      best_angles:    Pointer to the best angles, 2 * depth per instance; will be set.
+ *      best_values:    Pointer to the value of the best angles of every instance; will be set.
+ * Returns:             The number of evaluations per instance.
+ */
+size_t batch_grid_search(batch_t* batch, int m, double* best_angles, double* best_values);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BATCH_H
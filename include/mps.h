@@ -0,0 +1,199 @@
+#ifndef MPS_H
+#define MPS_H
+
+
+/*
+ * =============================================================================
+ *                                includes
+ * =============================================================================
+ */
+
+#include <complex.h>
+#include "knapsack.h"
+
+
+/*
+ * =============================================================================
+ *                                C++ check
+ * =============================================================================
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                              Type definitions
+ * =============================================================================
+ */
+
+/*
+ * Struct:              mps_t
+ * ---------------------------
+ * Description:         Matrix product state with open boundaries over qubits 0, ..., size - 1. Site i carries the
+ *                      tensor A_i[l][s][r] with physical index s and bond indices l, r; it is stored row-major as
+ *                      tensors[i][(l * 2 + s) * bonds[i + 1] + r]. Bond dimensions are truncated to max_bond.
+ * Contents:
+ *      size:           Number of sites, i.e. qubits.
+ *      max_bond:       Maximal bond dimension kept after every two-qubit gate.
+ *      center:         Site of the orthogonality center; all sites left of it are left-orthonormal and all sites
+ *                      right of it are right-orthonormal.
+ *      bonds:          Bond dimensions; bonds[i] connects sites i - 1 and i, and bonds[0] = bonds[size] = 1.
+ *      tensors:        Site tensors.
+ *      trunc_weight:   Accumulated squared norm of all discarded singular values.
+ */
+typedef struct mps {
+    bit_t size;
+    int max_bond;
+    bit_t center;
+    int* bonds;
+    double complex** tensors;
+    double trunc_weight;
+} mps_t;
+
+
+/*
+ * =============================================================================
+ *                              Linear algebra
+ * =============================================================================
+ */
+
+/*
+ * Function:            svd
+ * --------------------
+ * Description:         Singular value decomposition M = U S V^H of a complex matrix via one-sided Jacobi rotations.
+ *                      Singular values are returned in descending order.
+ * Parameters:
+ *      mat:            Pointer to the row-major rows x cols matrix M; not modified.
+ *      rows:           Number of rows of M.
+ *      cols:           Number of columns of M.
+ *      u:              Pointer to row-major rows x min(rows, cols) storage for U.
+ *      s:              Pointer to min(rows, cols) storage for the singular values.
+ *      v:              Pointer to row-major cols x min(rows, cols) storage for V.
+ * Returns:             The number min(rows, cols) of singular values.
+ */
+int svd(const double complex* mat, int rows, int cols, double complex* u, double* s, double complex* v);
+
+
+/*
+ * =============================================================================
+ *                              MPS manipulation
+ * =============================================================================
+ */
+
+/*
+ * Function:            create_product_mps
+ * --------------------
+ * Description:         Creates the product state with amplitude sqrt(1 - probs[i]) for |0> and sqrt(probs[i]) for |1>
+ *                      on every qubit i, i.e. the initial state of the Copula-QAOA.
+ * Parameters:
+ *      size:           Number of qubits.
+ *      probs:          Pointer to the probabilities of measuring 1 on each qubit.
+ *      max_bond:       Maximal bond dimension.
+ * Returns:             Pointer to the MPS.
+ * Side Effect:         Allocates dynamically; should eventually be freed via free_mps.
+ */
+mps_t* create_product_mps(bit_t size, const double* probs, int max_bond);
+
+
+/*
+ * Function:            free_mps
+ * --------------------
+ * Description:         Frees an MPS including all of its tensors.
+ * Parameters:
+ *      mps:            Pointer to the MPS.
+ */
+void free_mps(mps_t* mps);
+
+
+/*
+ * Function:            mps_move_center
+ * --------------------
+ * Description:         Shifts the orthogonality center to a given site by successive SVDs, without truncation.
+ * Parameters:
+ *      mps:            Pointer to the MPS; will be updated.
+ *      site:           New orthogonality center.
+ */
+void mps_move_center(mps_t* mps, bit_t site);
+
+
+/*
+ * Function:            mps_apply_phase
+ * --------------------
+ * Description:         Multiplies the |1> component of a qubit by a phase, i.e. applies diag(1, phase).
+ * Parameters:
+ *      mps:            Pointer to the MPS; will be updated.
+ *      qubit:          Qubit onto which the phase is applied.
+ *      phase:          Complex phase.
+ */
+void mps_apply_phase(mps_t* mps, bit_t qubit, double complex phase);
+
+
+/*
+ * Function:            mps_apply_two_qubit
+ * --------------------
+ * Description:         Applies a two-qubit gate and truncates the affected bond to max_bond. Qubits that are not
+ *                      neighbours are made adjacent by a chain of SWAP gates that is undone afterwards.
+ * Parameters:
+ *      mps:            Pointer to the MPS; will be updated.
+ *      qubit1:         First qubit; corresponds to the lower bit of the gate's basis index.
+ *      qubit2:         Second qubit; corresponds to the higher bit of the gate's basis index.
+ *      gate:           Row-major 4x4 matrix in the basis |s_1 + 2 s_2>.
+ */
+void mps_apply_two_qubit(mps_t* mps, bit_t qubit1, bit_t qubit2, const double complex gate[16]);
+
+
+/*
+ * =============================================================================
+ *                                 Evaluation
+ * =============================================================================
+ */
+
+/*
+ * Function:            mps_norm
+ * --------------------
+ * Description:         Computes the squared norm of the MPS, which deviates from 1 by the truncated weight.
+ * Parameters:
+ *      mps:            Pointer to the MPS.
+ * Returns:             The squared norm.
+ */
+double mps_norm(const mps_t* mps);
+
+
+/*
+ * Function:            mps_feasible_expectation
+ * --------------------
+ * Description:         Computes the expectation value of the modified objective function, which assigns 0 to every
+ *                      infeasible solution, by a transfer-matrix contraction from left to right. The left
+ *                      environments are resolved by the cumulative cost of the qubits contracted so far, and those
+ *                      exceeding the capacity are dropped. The result is normalized by the squared norm.
+ * Parameters:
+ *      mps:            Pointer to the MPS.
+ *      kp:             Pointer to the knapsack; qubit i corresponds to item i.
+ * Returns:             The expectation value.
+ */
+double mps_feasible_expectation(const mps_t* mps, const knapsack_t* kp);
+
+
+/*
+ * Function:            mps_prob_beating_greedy
+ * --------------------
+ * Description:         Estimates the probability of measuring a feasible solution with a profit larger than the
+ *                      integer Greedy solution by drawing perfect samples from the MPS.
+ * Parameters:
+ *      mps:            Pointer to the MPS; its orthogonality center is moved to the first site.
+ *      kp:             Pointer to the knapsack; qubit i corresponds to item i.
+ *      int_greedy_sol_val: Solution value of integer Greedy.
+ *      num_samples:    Number of samples to be drawn.
+ * Returns:             The estimated probability.
+ */
+double mps_prob_beating_greedy(mps_t* mps, const knapsack_t* kp, num_t int_greedy_sol_val, size_t num_samples);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //MPS_H
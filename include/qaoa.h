@@ -16,6 +16,9 @@
 #include "copula_count.h"
 #include "stategen.h"
 #include "combowrp.h"
+#include "mps.h"
+#include "angle_db.h"
+#include "results.h"
 
 
 /*
@@ -39,17 +42,47 @@ typedef double complex      cmplx;
 
 
 /*
- * Struct:          cbs_t
+ * enum:            profit_width_t
+ * ------------------------------------
+ * Description:     Width of the unsigned integers in which the profits of all simulated states are stored.
+ *
+ * Contents:        One value per supported integer width; PROFIT_64 holds the full num_t.
+ */
+typedef enum profit_width {
+    PROFIT_8,
+    PROFIT_16,
+    PROFIT_32,
+    PROFIT_64
+} profit_width_t;
+
+
+/*
+ * Struct:          profit_table_t
+ * ---------------------------
+ * Description:     This struct stores the profit (objective function value) of every simulated state, separately from
+ *                  the amplitudes and in the narrowest integer type that fits the instance's profit sum.
+ * Contents:
+ *      width:      Width of the stored integers.
+ *      data:       Pointer to the profits, to be interpreted according to width.
+ */
+typedef struct profit_table {
+    profit_width_t width;
+    void* data;
+} profit_table_t;
+
+/*
+ * Struct:          workspace_t
  * ---------------------------
- * Description:     This struct equips a solution, identified via its profit, with a complex amplitude.
+ * Description:     This struct holds the memory that one evaluation of the objective function works in, so that it is
+ *                  allocated once per optimization instead of once per evaluation.
  * Contents:
- *      profit:     Profit (objective function value) of the computational basis state / feasible solution.
- *      amplitude:  Complex amplitude associated with this computational basis state / feasible solution.
+ *      ctx:        Pointer to the QAOA context the workspace belongs to; lets the NLopt callback reach it.
+ *      angle_state: Amplitudes of the state being evolved; NULL for the MPS backend.
  */
-typedef struct cbs {
-    num_t profit;
-    cmplx amplitude;
-} cbs_t;
+typedef struct workspace {
+    struct qaoa_context* ctx;
+    cmplx* angle_state;
+} workspace_t;
 
 /*
  * enum:            qaoa_type_t
@@ -79,25 +112,441 @@ typedef enum opt {
 
 
 /*
- * =============================================================================
- *                              Global variables
- * =============================================================================
+ * enum:                backend_t
+ * ------------------------------------
+ * Description:         Choose how the quantum state is simulated.
+ *
+ * Contents:            Full state vector or matrix product state (Copula QAOA on linear instances only).
+ */
+typedef enum backend {
+    STATEVECTOR,
+    MPS,
+} backend_t;
+
+
+/*
+ * enum:                init_t
+ * ------------------------------------
+ * Description:         Choose how the angles are initialized before the local optimization.
+ *
+ * Contents:            Layer-wise fine-grid search, or transfer of the angles of the nearest instances in the angle
+ *                      database (falling back to the grid search if they are not good enough).
+ */
+typedef enum init {
+    INIT_GRID,
+    INIT_TRANSFER,
+} init_t;
+
+
+/*
+ * enum:                grid_t
+ * ------------------------------------
+ * Description:         Choose the grid search that precedes the local optimization.
+ *
+ * Contents:            Uniform grid of m x m points per layer, coarse grid refined around its best cells, or uniform
+ *                      gammas with a Fourier surrogate in beta interpolating a few samples.
+ */
+typedef enum grid {
+    GRID_UNIFORM,
+    GRID_ADAPTIVE,
+    GRID_FOURIER,
+} grid_t;
+
+
+/*
+ * enum:                raw_data_t
+ * ------------------------------------
+ * Description:         Choose what is exported about the distribution of the final state.
+ *
+ * Contents:            Only the histogram over the distinct profits with its quantiles, or additionally the ratio and
+ *                      probability of every single state.
+ */
+typedef enum raw_data {
+    RAW_SUMMARY,
+    RAW_STATES,
+} raw_data_t;
+
+#define MAX_QUANTILES   16 // Maximal number of quantiles of the distribution summary
+
+
+/*
+ * Struct:              run_options_t
+ * ---------------------------
+ * Description:         Optional settings of a QAOA run, given as key=value tokens after the mandatory fields of a
+ *                      benchmark line.
+ * Contents:
+ *      backend:        Simulation backend (backend=statevector|mps).
+ *      max_bond_dim:   Maximal bond dimension of the MPS backend (bond=<int>).
+ *      num_workers:    Maximal number of concurrent worker processes of a Copula sweep (workers=<int>); 0 uses one
+ *                      per online processor.
+ *      num_starts:     Number of best grid points from which local optimizations are started (starts=<int>).
+ *      init:           Initialization of the angles (init=grid|transfer).
+ *      grid:           Grid search preceding the local optimization (grid=uniform|adaptive|fourier).
+ *      grid_budget:    Evaluations of the adaptive grid search over all layers (grid_evals=<int>); 0 uses a quarter
+ *                      of those of the uniform grid.
+ *      fourier_order:  Order in beta of the Fourier surrogate (fourier_order=<int>); 0 uses 1 for the QTG-QAOA, where
+ *                      it is exact, and m/4 - 1 for the Copula-QAOA.
+ *      max_evals:      Maximal number of evaluations of the angle optimization (max_evals=<int>); 0 for no limit.
+ *      max_time:       Maximal wall-clock seconds of the angle optimization (max_time=<float>); 0 for no limit.
+ *      raw_data:       Export of the final distribution (raw_data=summary|states).
+ *      quantiles:      Probabilities of the quantiles of the approximation ratio (quantiles=<list>).
+ *      num_quantiles:  Number of quantiles.
+ *      resume:         Whether the run continues from its checkpoint instead of starting over (set by --resume).
+ *      results_log:    Path of the results log every run appends its record to (set for the lines of a benchmark
+ *                      file); empty for none.
+ *      max_memory:     Bytes of memory the run may take (set from --memory for the lines of a benchmark file); 0 for
+ *                      the physical memory.
+ */
+typedef struct run_options {
+    backend_t backend;
+    int max_bond_dim;
+    int num_workers;
+    int num_starts;
+    init_t init;
+    grid_t grid;
+    int grid_budget;
+    int fourier_order;
+    int max_evals;
+    double max_time;
+    raw_data_t raw_data;
+    double quantiles[MAX_QUANTILES];
+    int num_quantiles;
+    bool_t resume;
+    char results_log[256];
+    uint64_t max_memory;
+} run_options_t;
+
+
+/*
+ * Struct:              trace_t
+ * ---------------------------
+ * Description:         Record of all evaluations of the objective function during the angle optimization of a run,
+ *                      against which the budgets are checked and which is exported as trace.
+ * Contents:
+ *      num_evals:      Number of evaluations so far.
+ *      num_search_evals: Number of those spent on grid searches and transferred starts.
+ *      capacity:       Number of evaluations the records have room for.
+ *      records:        Per evaluation, the elapsed seconds, the value and the 2 * depth angles.
+ *      start_time:     Wall-clock time at which the optimization started.
+ *      elapsed:        Wall-clock seconds the optimization took; set once it has finished.
+ *      exhausted:      Whether a budget has cut the optimization short.
+ */
+typedef struct trace {
+    size_t num_evals;
+    size_t num_search_evals;
+    size_t capacity;
+    double* records;
+    double start_time;
+    double elapsed;
+    bool_t exhausted;
+} trace_t;
+
+
+/*
+ * Struct:              memo_cache_t
+ * ---------------------------
+ * Description:         Bounded hash table from bit-exact angle vectors to their expectation values, which spares the
+ *                      evaluation of angles that a run has visited before. Collisions are resolved by linear probing
+ *                      over MEMO_CACHE_PROBES slots; if all of them are taken, the key the angles hash to is evicted.
+ * Contents:
+ *      num_slots:      Number of slots, a power of two; 0 if the cache is disabled.
+ *      key_size:       Number of angles per key, i.e. twice the depth.
+ *      entries:        Per slot, the key_size angles followed by their value.
+ *      used:           Per slot, whether it holds an entry.
+ *      hits:           Number of lookups that found their angles.
+ *      misses:         Number of lookups that did not.
+ */
+typedef struct memo_cache {
+    size_t num_slots;
+    size_t key_size;
+    double* entries;
+    unsigned char* used;
+    size_t hits;
+    size_t misses;
+} memo_cache_t;
+
+
+/*
+ * Struct:              checkpoint_t
+ * ---------------------------
+ * Description:         Progress of the angle optimization of a run that is periodically written to checkpoint.bin,
+ *                      so that a run that dies can be resumed instead of redone, see checkpoint_header_t.
+ * Contents:
+ *      path:           Pointer to the path of the checkpoint file; NULL if the run is not checkpointed.
+ *      instance_hash:  Hash of the instance context, see instance_hash.
+ *      resumed:        Whether the progress below was read from a checkpoint of an earlier process.
+ *      completed_layers: Number of layers of the grid search that are completed.
+ *      search_done:    Whether the grid search is completed; the starts then hold its candidates.
+ *      num_starts:     Number of starts of the local optimization.
+ *      starts:         While searching, the best angles of the completed layers; then the num_starts candidates.
+ *      start_values:   Values of the starts; while searching, only the first one is set.
+ *      best_angles:    Best angles evaluated so far.
+ *      best_value:     Their value; -INFINITY before the first evaluation.
+ *      prior_evals:    Number of evaluations of earlier processes, which count towards the budget.
+ *      last_write:     Wall-clock time of the last write.
+ */
+typedef struct checkpoint {
+    char* path;
+    uint64_t instance_hash;
+    bool_t resumed;
+    int completed_layers;
+    bool_t search_done;
+    int num_starts;
+    double* starts;
+    double* start_values;
+    double* best_angles;
+    double best_value;
+    size_t prior_evals;
+    double last_write;
+} checkpoint_t;
+
+
+/*
+ * Struct:              distribution_t
+ * ---------------------------
+ * Description:         Exact distribution of the objective function value in a state, i.e. the total probability of
+ *                      every distinct profit of the feasible states, in ascending order of the profits.
+ * Contents:
+ *      num_profits:    Number of distinct profits.
+ *      profits:        Distinct profits.
+ *      probs:          Total probability of each profit.
+ *      infeasible_prob: Total probability of the infeasible states.
  */
+typedef struct distribution {
+    size_t num_profits;
+    num_t* profits;
+    double* probs;
+    double infeasible_prob;
+} distribution_t;
 
-extern knapsack_t* kp;
-extern qaoa_type_t qaoa_type;
-extern int depth;
-extern opt_t opt_type;
-extern int m;
-extern size_t bias;
-extern double k;
-extern double theta;
 
-extern size_t num_states;
-extern node_t *qtg_nodes;
-extern num_t* sol_profits;
-extern double* prob_dist_vals;
-extern bool_t* sol_feasibilities;
+/*
+ * Struct:              landscape_header_t
+ * ---------------------------
+ * Description:         Header of a binary landscape file. It is followed by the 2 * depth fixed angles and then by
+ *                      num_gammas * num_betas expectation values, all as native doubles; the values are stored row by
+ *                      row, where row i has gamma = i * gamma_period / num_gammas and column l has
+ *                      beta = l * 2pi / num_betas for the scanned layer.
+ * Contents:
+ *      magic:          LANDSCAPE_MAGIC without the terminating null character.
+ *      version:        Version of the format.
+ *      depth:          Depth of the QAOA.
+ *      layer:          Scanned layer, counted from 0.
+ *      num_gammas:     Number of rows.
+ *      num_betas:      Number of columns.
+ *      reserved:       Padding; 0.
+ *      gamma_period:   Period of gamma, see compute_gamma_period.
+ */
+typedef struct landscape_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t depth;
+    uint32_t layer;
+    uint32_t num_gammas;
+    uint32_t num_betas;
+    uint32_t reserved;
+    double gamma_period;
+} landscape_header_t;
+
+#define LANDSCAPE_MAGIC "QAOALAND"
+
+
+/*
+ * Struct:              raw_data_header_t
+ * ---------------------------
+ * Description:         Header of a binary raw-data file. It is followed by two columns of num_states native doubles:
+ *                      first the approximation ratio of every state, then its probability in the final state.
+ * Contents:
+ *      magic:          RAW_DATA_MAGIC without the terminating null character.
+ *      version:        Version of the format.
+ *      reserved:       Padding; 0.
+ *      num_states:     Number of states, i.e. rows.
+ *      optimal_sol_val: Optimal solution value the ratios refer to; multiplying by it recovers the profits.
+ */
+typedef struct raw_data_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_states;
+    double optimal_sol_val;
+} raw_data_header_t;
+
+#define RAW_DATA_MAGIC "QAOARAWD"
+
+
+/*
+ * Struct:              checkpoint_header_t
+ * ---------------------------
+ * Description:         Header of a binary checkpoint file. It is followed by native doubles: the 2 * depth best angles,
+ *                      the num_starts * 2 * depth starts and the num_starts start values, see checkpoint_t.
+ * Contents:
+ *      magic:          CHECKPOINT_MAGIC without the terminating null character.
+ *      version:        Version of the format.
+ *      depth:          Depth of the QAOA.
+ *      m:              Grid resolution per angle.
+ *      grid:           Grid search preceding the local optimization.
+ *      num_starts:     Number of starts of the local optimization.
+ *      completed_layers: Number of layers of the grid search that are completed.
+ *      search_done:    Whether the grid search is completed.
+ *      reserved:       Padding; 0.
+ *      instance_hash:  Hash of the instance context the checkpoint belongs to.
+ *      num_evals:      Number of evaluations so far.
+ *      elapsed:        Wall-clock seconds of the angle optimization so far.
+ *      best_value:     Value of the best angles.
+ */
+typedef struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t depth;
+    uint32_t m;
+    uint32_t grid;
+    uint32_t num_starts;
+    uint32_t completed_layers;
+    uint32_t search_done;
+    uint32_t reserved;
+    uint64_t instance_hash;
+    uint64_t num_evals;
+    double elapsed;
+    double best_value;
+} checkpoint_header_t;
+
+#define CHECKPOINT_MAGIC "QAOACKPT"
+
+
+/*
+ * Struct:              estimate_t
+ * ---------------------------
+ * Description:         Projected resources of a single QAOA run, obtained before anything is allocated.
+ * Contents:
+ *      num_states:     Number of simulated states, i.e. the feasible leaves of the QTG or 2^n for the Copula QAOA.
+ *      exact:          Whether num_states is exact; otherwise it is an upper bound.
+ *      peak_bytes:     Peak memory of the tables, the state generation and the state vectors.
+ *      flops_per_eval: Floating-point operations of one evaluation of the objective function.
+ *      num_evals:      Number of evaluations of the angle optimization.
+ *      seconds:        Wall-clock time of the angle optimization.
+ */
+typedef struct estimate {
+    double num_states;
+    bool_t exact;
+    double peak_bytes;
+    double flops_per_eval;
+    double num_evals;
+    double seconds;
+} estimate_t;
+
+
+/*
+ * Struct:              instance_context_t
+ * ---------------------------
+ * Description:         The preparation of an instance that does not depend on the depth, the optimizer, the grid
+ *                      resolution, k or theta. It is immutable once prepared and shared by reference counting among
+ *                      the contexts of all runs on the instance; worker processes inherit it copy-on-write.
+ * Contents:
+ *      kp:             Pointer to the sorted knapsack with all items removed; owned.
+ *      qaoa_type:      QAOA type the tables were built for.
+ *      bias:           Bias of the QTG.
+ *      kp_type:        Linear or quadratic objective function.
+ *      backend:        Simulation backend the tables were built for.
+ *      int_greedy_sol_val: Integer Greedy solution value.
+ *      optimal_sol_val: Optimal solution value.
+ *      num_states:     Number of simulated states.
+ *      qtg_nodes:      Nodes of the QTG (QTG QAOA only).
+ *      sol_profits:    Profit of every simulated state (QTG or quadratic Copula QAOA).
+ *      sol_feasibilities: Packed feasibility bits of every state (Copula QAOA only).
+ *      num_phase_blocks: Number of qubit blocks of the factorised profits (linear Copula QAOA only).
+ *      block_profits:  Profits of every assignment of every block (linear Copula QAOA only).
+ *      gamma_period:   Period of gamma, see compute_gamma_period.
+ *      ref_count:      Number of holders of the preparation; it is freed when the last one releases it.
+ */
+typedef struct instance_context {
+    knapsack_t* kp;
+    qaoa_type_t qaoa_type;
+    size_t bias;
+    knapsack_type_t kp_type;
+    backend_t backend;
+    num_t int_greedy_sol_val;
+    num_t optimal_sol_val;
+    size_t num_states;
+    node_t* qtg_nodes;
+    profit_table_t sol_profits;
+    uint64_t* sol_feasibilities;
+    int num_phase_blocks;
+    num_t* block_profits;
+    double gamma_period;
+    int ref_count;
+} instance_context_t;
+
+
+/*
+ * Struct:              qaoa_context_t
+ * ---------------------------
+ * Description:         All state of a QAOA run, i.e. its hyperparameters, the tables of the instance and the memory of
+ *                      the evaluations. Every function that needs any of it receives the context explicitly, so that
+ *                      independent contexts can be used concurrently, e.g. one per thread.
+ * Contents:
+ *      kp:             Pointer to the knapsack; not owned.
+ *      qaoa_type:      QAOA type, i.e. the mixer.
+ *      bias:           Bias of the QTG.
+ *      depth:          Depth of the QAOA.
+ *      opt_type:       Local optimizer.
+ *      m:              Grid resolution per angle.
+ *      k:              Parameter k of the Copula mixer.
+ *      theta:          Correlation parameter of the Copula mixer.
+ *      memory_size:    Memory size of the local optimizer.
+ *      kp_type:        Linear or quadratic objective function.
+ *      options:        Run options.
+ *      run_label:      Name of the subdirectory the results of a sweep run go to; empty outside of sweeps.
+ *      num_states:     Number of simulated states.
+ *      qtg_nodes:      Nodes of the QTG (QTG QAOA only).
+ *      sol_profits:    Profit of every simulated state (QTG or quadratic Copula QAOA).
+ *      prob_dist_vals: Probabilities of the Copula mixer for the current k (Copula QAOA only).
+ *      sol_feasibilities: Packed feasibility bits of every state (Copula QAOA only).
+ *      num_phase_blocks: Number of qubit blocks of the factorised profits (linear Copula QAOA only).
+ *      block_profits:  Profits of every assignment of every block (linear Copula QAOA only).
+ *      initial_state:  Initial state, restored at the start of every evaluation.
+ *      eval_workspace: Workspace of the serial evaluations.
+ *      gamma_period:   Period of gamma, see compute_gamma_period.
+ *      eval_trace:     Trace of the evaluations of the angle optimization.
+ *      eval_cache:     Memo cache of the evaluations of the angle optimization.
+ *      shared:         Shared preparation the instance-dependent tables are borrowed from; NULL if they are owned.
+ *      checkpoint:     Progress of the angle optimization for checkpoints.
+ *      grid_starts:    Candidates of a grid search done outside of the run, e.g. in lockstep with other instances by
+ *                      batch_grid_search, which replace the search of nlopt_optimizer; NULL otherwise. Not owned.
+ *      grid_values:    Values of these candidates. Not owned.
+ *      num_grid_evals: Number of evaluations of that search, which are neither traced nor cached.
+ */
+typedef struct qaoa_context {
+    knapsack_t* kp;
+    qaoa_type_t qaoa_type;
+    size_t bias;
+    int depth;
+    opt_t opt_type;
+    int m;
+    double k;
+    double theta;
+    int memory_size;
+    knapsack_type_t kp_type;
+    run_options_t options;
+    char run_label[64];
+
+    size_t num_states;
+    node_t* qtg_nodes;
+    profit_table_t sol_profits;
+    double* prob_dist_vals;
+    uint64_t* sol_feasibilities;
+    int num_phase_blocks;
+    num_t* block_profits;
+    cmplx* initial_state;
+    workspace_t* eval_workspace;
+    double gamma_period;
+    trace_t eval_trace;
+    memo_cache_t eval_cache;
+    instance_context_t* shared;
+    checkpoint_t checkpoint;
+    const double* grid_starts;
+    const double* grid_values;
+    size_t num_grid_evals;
+} qaoa_context_t;
 
 
 /*
@@ -117,12 +566,135 @@ double random_value_on_windows_or_linux();
 
 
 /*
-* Function:            free_global_variables
+* Function:            free_context
+* --------------------
+* Description:         Frees a QAOA context together with the tables allocated for the QTG or the Copula QAOA. The
+*                      knapsack is not owned by the context and is kept; borrowed tables are released instead.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*/
+
+void free_context(qaoa_context_t* ctx);
+
+
+/*
+* Function:            free_run_variables
+* --------------------
+* Description:         Frees the variables of a context that depend on the hyperparameters of a single run, i.e. the
+*                      probability distribution values, the initial state and the evaluation workspace. The
+*                      instance-dependent tables are kept.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*/
+
+void free_run_variables(qaoa_context_t* ctx);
+
+
+/*
+* Function:            gcd
+* --------------------
+* Description:         Computes the greatest common divisor of two non-negative integers; gcd(0, b) = b.
+* Parameters:
+*      a:              First integer.
+*      b:              Second integer.
+* Returns:             The greatest common divisor.
+*/
+
+num_t gcd(num_t, num_t);
+
+
+/*
+* Function:            narrowest_profit_width
+* --------------------
+* Description:         Determines the narrowest unsigned integer width that can hold a given profit.
+* Parameters:
+*      max_profit:     Largest profit to be stored, e.g. the profit sum of the instance.
+* Returns:             The corresponding profit width.
+*/
+
+profit_width_t narrowest_profit_width(num_t);
+
+
+/*
+* Function:            create_profit_table
 * --------------------
-* Description:         Frees the global variables assigned for the QTG or the Copula QAOA.
+* Description:         Allocates a profit table for a given number of states in the narrowest fitting width.
+* Parameters:
+*      table:          Pointer to the profit table to be set up.
+*      size:           Number of states.
+*      max_profit:     Largest profit to be stored, e.g. the profit sum of the instance.
+* Side Effect:         Allocates dynamically; table->data should eventually be freed.
+*/
+
+void create_profit_table(profit_table_t*, size_t, num_t);
+
+
+/*
+* Function:            set_profit
+* --------------------
+* Description:         Stores the profit of one state in a profit table.
+* Parameters:
+*      table:          Pointer to the profit table.
+*      idx:            Index of the state.
+*      profit:         Profit to be stored.
+*/
+
+void set_profit(profit_table_t*, size_t, num_t);
+
+
+/*
+* Function:            get_profit
+* --------------------
+* Description:         Reads the profit of one state from a profit table.
+* Parameters:
+*      table:          Pointer to the profit table.
+*      idx:            Index of the state.
+* Returns:             The stored profit.
+*/
+
+num_t get_profit(const profit_table_t*, size_t);
+
+
+/*
+* Function:            state_profit
+* --------------------
+* Description:         Returns the profit of a simulated state, either from the factorised per-block tables (linear
+*                      Copula QAOA) or from the profit table (QTG or quadratic Copula QAOA).
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      idx:            Index of the state.
+* Returns:             The profit of the state.
+*/
+
+num_t state_profit(qaoa_context_t*, size_t);
+
+
+/*
+* Function:            kernel_threads
+* --------------------
+* Description:         Returns the number of threads a kernel, i.e. a gate, phase separation, mixer or expectation
+*                      value, shares its states among: the processors that the team of the caller leaves idle, or 1
+*                      for fewer than KERNEL_MIN_STATES states.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+* Returns:             The number of threads, at least 1.
+*/
+
+int kernel_threads(qaoa_context_t*);
+
+
+/*
+* Function:            feasibility_word
+* --------------------
+* Description:         Returns the packed feasibilities of 64 consecutive states, one bit per state. Without a
+*                      feasibility bitmap (QTG QAOA), all states are feasible.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      word:           Index of the word, i.e. the index of the first state divided by 64.
+* Returns:             The word of feasibility bits.
 */
 
-void free_global_variables();
+uint64_t feasibility_word(qaoa_context_t*, size_t);
 
 
 /*
@@ -135,7 +707,7 @@ void free_global_variables();
 * Returns:             The corresponding probability.
 */
 
-double prob_for_amplitude(const cbs_t*, size_t);
+double prob_for_amplitude(const cmplx*, size_t);
 
 
 /*
@@ -143,12 +715,57 @@ double prob_for_amplitude(const cbs_t*, size_t);
 * -------------------------
 * Description:             Computes the probability that the QAOA ultimately beats Greedy.
 * Parameters:
+*      ctx:                Pointer to the QAOA context.
 *      angle_state:        Pointer to the current state.
 *      int_greedy_sol_val: Solution value of integer Greedy.
 * Returns:                 Probability of beating Greedy.
 */
 
-double prob_beating_greedy(const cbs_t*, num_t);
+double prob_beating_greedy(qaoa_context_t*, const cmplx*, num_t);
+
+
+/*
+ * =============================================================================
+ *                                 Run options
+ * =============================================================================
+ */
+
+/*
+* Function:            default_run_options
+* --------------------
+* Description:         Returns the run options that apply if a benchmark line specifies none.
+* Returns:             The default run options.
+*/
+
+run_options_t default_run_options();
+
+
+/*
+* Function:            parse_run_option
+* --------------------
+* Description:         Parses a single key=value token of a benchmark line into the run options.
+* Parameters:
+*      run_options:    Pointer to the run options; will be updated.
+*      token:          Pointer to the token.
+* Returns:             Whether the token is a valid run option.
+*/
+
+bool_t parse_run_option(run_options_t*, const char*);
+
+
+/*
+* Function:            parse_value_list
+* --------------------
+* Description:         Parses a comma-separated list of numbers such as "5,10,20", e.g. a k or theta field of a
+*                      benchmark line that requests a sweep.
+* Parameters:
+*      token:          Pointer to the token.
+*      values:         Pointer to the storage for the parsed values.
+*      max_values:     Maximal number of values that fit into the storage.
+* Returns:             The number of parsed values, or 0 if the token is malformed or has too many values.
+*/
+
+int parse_value_list(const char*, double*, int);
 
 
 /*
@@ -162,12 +779,13 @@ double prob_beating_greedy(const cbs_t*, num_t);
 * --------------------
 * Description:         Applies a rotation gate around the y-axis on a specified qubit in a given state.
 * Parameters:
+*      ctx:            Pointer to the QAOA context.
 *      angle_state:    Pointer to the current state before the application; will be updated.
 *      qubit:          Qubit onto which the rotation shall be applied.
 *      prob:           Probability value that serves as input parameter for the rotation.
 */
 
-void apply_ry(cbs_t*, int, double);
+void apply_ry(qaoa_context_t*, cmplx*, int, double);
 
 
 /*
@@ -175,12 +793,13 @@ void apply_ry(cbs_t*, int, double);
 * --------------------
 * Description:         Applies an inverse rotation gate around the y-axis on a specified qubit in a given state.
 * Parameters:
+*      ctx:            Pointer to the QAOA context.
 *      angle_state:    Pointer to the current state before the application; will be updated.
 *      qubit:          Qubit onto which the inverse rotation shall be applied.
 *      prob:           Probability value that serves as input parameter for the inverse rotation.
 */
 
-void apply_ry_inv(cbs_t*, int, double);
+void apply_ry_inv(qaoa_context_t*, cmplx*, int, double);
 
 
 /*
@@ -188,6 +807,7 @@ void apply_ry_inv(cbs_t*, int, double);
 * --------------------
 * Description:         Applies a rotation gate around the y-axis on a target qubit controlled on another qubit.
 * Parameters:
+*      ctx:            Pointer to the QAOA context.
 *      angle_state:    Pointer to the current state before the application; will be updated.
 *      control:        Qubit onto which the rotation shall be controlled.
 *      target:         Qubit onto which the rotation shall be applied.
@@ -195,7 +815,7 @@ void apply_ry_inv(cbs_t*, int, double);
 *      prob:           Probability value that serves as input parameter for the rotation.
 */
 
-void apply_cry(cbs_t*, int, int, bool_t, double);
+void apply_cry(qaoa_context_t*, cmplx*, int, int, bool_t, double);
 
 
 /*
@@ -203,6 +823,7 @@ void apply_cry(cbs_t*, int, int, bool_t, double);
 * --------------------
 * Description:         Applies an inverse rotation gate around the y-axis on a target qubit controlled on another qubit.
 * Parameters:
+*      ctx:            Pointer to the QAOA context.
 *      angle_state:    Pointer to the current state before the application; will be updated.
 *      control:        Qubit onto which the inverse rotation shall be controlled.
 *      target:         Qubit onto which the inverse rotation shall be applied.
@@ -210,7 +831,7 @@ void apply_cry(cbs_t*, int, int, bool_t, double);
 *      prob:           Probability value that serves as input parameter for the inverse rotation.
 */
 
-void apply_cry_inv(cbs_t*, int, int, bool_t, double);
+void apply_cry_inv(qaoa_context_t*, cmplx*, int, int, bool_t, double);
 
 
 /*
@@ -218,12 +839,13 @@ void apply_cry_inv(cbs_t*, int, int, bool_t, double);
 * --------------------
 * Description:         Applies a rotation gate around the z-axis on a specified qubit in a given state.
 * Parameters:
+*      ctx:            Pointer to the QAOA context.
 *      angle_state:    Pointer to the current state before the application; will be updated.
 *      qubit:          Qubit onto which the rotation shall be applied.
 *      angle:          Angle of the rotation.
 */
 
-void apply_rz(cbs_t*, int, double);
+void apply_rz(qaoa_context_t*, cmplx*, int, double);
 
 
 /*
@@ -237,10 +859,24 @@ void apply_rz(cbs_t*, int, double);
 * --------------------
 * Description:         Classical emulation of the application of the QTG to prepare the initial state of the QTG QAOA.
 * Parameters:
+*      ctx:            Pointer to the QAOA context.
 *      angle_state:    Pointer to the current state before the application; will be updated.
 */
 
-void qtg_initial_state_prep(cbs_t*);
+void qtg_initial_state_prep(qaoa_context_t*, cmplx*);
+
+
+/*
+* Function:            build_profit_table
+* --------------------
+* Description:         Fills the profit table with the profits of all simulated states, i.e. the QTG output
+*                      nodes or all computational basis states of a quadratic Copula instance.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+* Side Effect:         Allocates dynamically; freed by free_context.
+*/
+
+void build_profit_table(qaoa_context_t* ctx);
 
 
 /*
@@ -251,10 +887,11 @@ void qtg_initial_state_prep(cbs_t*);
  *                      initial QTG application and the current state. The result is used in an expression that comes
  *                      out when cleverly re-writing the action of the mixing unitary.
  * Parameters:
+ *      ctx:            Pointer to the QAOA context.
  *      angle_state:    Pointer to the current state before the application; will be updated.
  *      beta:           Value of the angle beta that parametrizes the unitary.
  */
-void qtg_grover_mixer(cbs_t*, double);
+void qtg_grover_mixer(qaoa_context_t*, cmplx*, double);
 
 
 /*
@@ -264,17 +901,42 @@ void qtg_grover_mixer(cbs_t*, double);
  */
 
 /*
- * Function:            prob_dist
+ * Function:            build_prob_dist_vals
+ * --------------------
+ * Description:         Computes the values of the probability distribution that the initial state is to be biased
+ *                      towards in the Copula-QAOA for all items, depending on the hyperparameter k. The constants
+ *                      that only depend on the instance (cost sum and break item) are computed once for all items.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ * Side Effect:         Allocates ctx->prob_dist_vals dynamically; freed by free_context.
+ */
+void build_prob_dist_vals(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            build_phase_blocks
+ * --------------------
+ * Description:         Partitions the qubits into blocks of PHASE_BLOCK_BITS consecutive qubits and tabulates, for
+ *                      every block, the total profit of each of its bit patterns. Since the objective function of a
+ *                      linear knapsack is a sum of single-item profits, the profit of any computational basis state is
+ *                      the sum of one table entry per block.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ * Side Effect:         Allocates ctx->block_profits dynamically; freed by free_context.
+ */
+void build_phase_blocks(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            factorised_profit
  * --------------------
- * Description:         Computes the value of the probability distribution that the initial state is to be biased
- *                      towards in the Copula-QAOA for a certain index.
+ * Description:         Computes the profit of a computational basis state from the per-block profit tables.
  * Parameters:
- *      index:          Item in the knapsack whose value is wanted.
- *      kp:             Pointer to the underlying knapsack.
- *      k:              Hyperparameter of the probability distribution.
- * Returns:             The value of the probability distribution.
+ *      ctx:            Pointer to the QAOA context.
+ *      idx:            Index of the computational basis state.
+ * Returns:             The profit of the computational basis state.
  */
-double prob_dist(bit_t index);
+num_t factorised_profit(qaoa_context_t* ctx, size_t idx);
 
 
 /*
@@ -282,9 +944,10 @@ double prob_dist(bit_t index);
  * --------------------
  * Description:         Prepares the initial state of the Copula-QAOA based on the underlying probability distribution.
  * Parameters:
+ *      ctx:            Pointer to the QAOA context.
  *      angle_state:    Pointer to the current state before the application; will be updated.
  */
-void copula_initial_state_prep(cbs_t* angle_state);
+void copula_initial_state_prep(qaoa_context_t* ctx, cmplx* angle_state);
 
 
 /*
@@ -293,6 +956,7 @@ void copula_initial_state_prep(cbs_t* angle_state);
  * Description:         Applies the operator R from the van Dam paper, depending on the values of the probability
  *                      distribution corresponding to two (distinct) qubits, to the angle state.
  * Parameters:
+ *      ctx:            Pointer to the QAOA context.
  *      angle_state:    Pointer to the current state before the application; will be updated.
  *      qubit1:         First qubit onto which the operator will be applied.
  *      qubit2:         Second qubit onto which the operator will be applied.
@@ -300,7 +964,15 @@ void copula_initial_state_prep(cbs_t* angle_state);
  *      d2given1:       Value of the probability distribution corresponding to the second item, given the first.
  *      d2givennot1:    Value of the probability distribution corresponding to the second item, given not the first.
  */
-void apply_r_dist(cbs_t* angle_state, num_t qubit1, num_t qubit2, double d1, double d2given1, double d2givennot1);
+void apply_r_dist(
+    qaoa_context_t* ctx,
+    cmplx* angle_state,
+    num_t qubit1,
+    num_t qubit2,
+    double d1,
+    double d2given1,
+    double d2givennot1
+);
 
 
 /*
@@ -309,6 +981,7 @@ void apply_r_dist(cbs_t* angle_state, num_t qubit1, num_t qubit2, double d1, dou
  * Description:         Applies the inverse of the operator R from the van Dam paper, depending on the values of the
  *                      probability distribution corresponding to two (distinct) qubits, to the angle state.
  * Parameters:
+ *      ctx:            Pointer to the QAOA context.
  *      angle_state:    Pointer to the current state before the application; will be updated.
  *      qubit1:         First qubit onto which the operator will be applied.
  *      qubit2:         Second qubit onto which the operator will be applied.
@@ -316,7 +989,15 @@ void apply_r_dist(cbs_t* angle_state, num_t qubit1, num_t qubit2, double d1, dou
  *      d2given1:       Value of the probability distribution corresponding to the second item, given the first.
  *      d2givennot1:    Value of the probability distribution corresponding to the second item, given not the first.
  */
-void apply_r_dist_inv(cbs_t* angle_state, num_t qubit1, num_t qubit2, double d1, double d2given1, double d2givennot1);
+void apply_r_dist_inv(
+    qaoa_context_t* ctx,
+    cmplx* angle_state,
+    num_t qubit1,
+    num_t qubit2,
+    double d1,
+    double d2given1,
+    double d2givennot1
+);
 
 
 /*
@@ -324,11 +1005,41 @@ void apply_r_dist_inv(cbs_t* angle_state, num_t qubit1, num_t qubit2, double d1,
  * --------------------
  * Description:         Applies the two-qubit Copula unitary from the van Dam paper.
  * Parameters:
+ *      ctx:            Pointer to the QAOA context.
  *      angle_state:    Pointer to the current state before the application; will be updated.
  *      qubit1:         First qubit onto which the operator will be applied.
  *      qubit2:         Second qubit onto which the operator will be applied.
  */
-void apply_two_copula(cbs_t* angle_state, int qubit1, int qubit2, double beta);
+void apply_two_copula(qaoa_context_t* ctx, cmplx* angle_state, int qubit1, int qubit2, double beta);
+
+
+/*
+ * Function:            copula_mixer_pairs
+ * --------------------
+ * Description:         Lists the qubit pairs onto which the Copula mixer applies two-qubit Copula unitaries, in order
+ *                      of application: first (1, 2), (3, 4), ..., then (0, 1), (2, 3), ..., with the ring being closed
+ *                      by (size - 1, 0) in whichever layer the pair fits.
+ * Parameters:
+ *      size:           Number of qubits.
+ *      pairs:          Pointer to storage for (at least) size pairs; will be updated.
+ * Returns:             The number of pairs, which equals the number of qubits.
+ */
+int copula_mixer_pairs(bit_t size, int pairs[][2]);
+
+
+/*
+ * Function:            copula_gate_matrix
+ * --------------------
+ * Description:         Assembles the two-qubit Copula unitary as a 4x4 matrix in the basis |s_1 + 2 s_2>, where s_1
+ *                      and s_2 are the states of the first and second qubit. Used by the MPS backend.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      qubit1:         First qubit onto which the operator will be applied.
+ *      qubit2:         Second qubit onto which the operator will be applied.
+ *      beta:           Angle by which the mixer is parametrized.
+ *      gate:           Pointer to storage for the row-major matrix; will be updated.
+ */
+void copula_gate_matrix(qaoa_context_t* ctx, int qubit1, int qubit2, double beta, cmplx gate[16]);
 
 
 /*
@@ -336,10 +1047,11 @@ void apply_two_copula(cbs_t* angle_state, int qubit1, int qubit2, double beta);
  * --------------------
  * Description:         Applies the assembled Copula mixer from the van Dam paper.
  * Parameters:
+ *      ctx:            Pointer to the QAOA context.
  *      angle_state:    Pointer to the current state before the application; will be updated.
  *      beta:           Angle by which the mixer is parametrized.
  */
-void copula_mixer(cbs_t* angle_state, double beta);
+void copula_mixer(qaoa_context_t* ctx, cmplx* angle_state, double beta);
 
 
 /*
@@ -355,60 +1067,394 @@ void copula_mixer(cbs_t* angle_state, double beta);
  *                      is based on theoretical considerations. It owes its simplicity to the objective Hamiltonian
  *                      being diagonal in the computational basis by design.
  * Parameters:
+ *      ctx:            Pointer to the QAOA context.
  *      angle_state:    Pointer to the current state before the application; will be updated.
  *      gamma:          Value of the angle gamma that parametrizes the unitary.
  */
-void phase_separation_unitary(cbs_t*, double);
+void phase_separation_unitary(qaoa_context_t*, cmplx*, double);
+
 
 /*
- * Function:        quasiadiabatic_evolution
+ * Function:            factorised_phase_separation
  * --------------------
- * Description:     Depending on the type of the QAOA (either QTG- or Copula-based), this function performs the
- *                  corresponding quasi-adiabatic evolution. In case of the QTG-approach, it emulates one execution of
- *                  the full circuit, whereas it actually simulates the gates for the Copula-QAOA. The basic structure
- *                  in both cases is as follows: After initializing the angle state in the first place, the initial
- *                  state is prepared. Afterwards, the depth specifies the number of alternating repitions of calling
- *                  the phase separation and mixing unitaries, respectively.
+ * Description:         Phase separation unitary for linear Copula instances. As the phase factorises into
+ *                      single-qubit Z rotations, one table of phases is computed per block of qubits. The phase of an
+ *                      amplitude is then the product of one entry per block, where the entries of all but the lowest
+ *                      block are combined once per row of 2^PHASE_BLOCK_BITS amplitudes.
  * Parameters:
- *      angles:     Pointer to list of angles with length equaling twice the depth.
- * Returns:         The state with updated amplitudes after the alternating application.
- * Side Effect:     Allocates dynamically; pointer should eventually be freed.
+ *      ctx:            Pointer to the QAOA context.
+ *      angle_state:    Pointer to the current state before the application; will be updated.
+ *      gamma:          Value of the angle gamma that parametrizes the unitary.
  */
-cbs_t* quasiadiabatic_evolution(const double* angles);
-
+void factorised_phase_separation(qaoa_context_t*, cmplx*, double);
 
 /*
- * =============================================================================
- *                                 Evaluation
- * =============================================================================
+ * Function:        prepare_initial_state
+ * --------------------
+ * Description:     Prepares the initial state of the QTG or Copula QAOA once per run. It is kept as pristine copy that
+ *                  every evaluation restores instead of preparing it anew; the Grover mixer of the QTG QAOA also
+ *                  reads its amplitudes.
+ * Parameters:
+ *      ctx:        Pointer to the QAOA context.
+ * Side Effect:     Allocates ctx->initial_state dynamically; freed by free_context.
  */
+void prepare_initial_state(qaoa_context_t* ctx);
+
 
 /*
- * Function:            expectation_value
+ * Function:        restore_initial_state
  * --------------------
- * Description:         Computes the expectation value of the objective Hamiltonian in a given state based on the actual
-                        amplitudes of the state.
+ * Description:     Overwrites a state with the pristine initial state by a parallel chunk-wise copy.
  * Parameters:
- *      angle_state:    Pointer to the state to compute the expectation value for.
- * Returns:             The sum of all terms making the expectation value.
+ *      ctx:        Pointer to the QAOA context.
+ *      angle_state: Pointer to the state; will be updated.
  */
-double expectation_value(const cbs_t* angle_state);
+void restore_initial_state(qaoa_context_t* ctx, cmplx* angle_state);
 
 
 /*
- * Function:            angles_to_value
+ * Function:        evolve_state
  * --------------------
- * Description:         Computes the expectation value, given a set of angles, by executing the quasi-adiabatic
- *                      evolution first and processing the result afterwards.
+ * Description:     Depending on the type of the QAOA (either QTG- or Copula-based), this function performs the
+ *                  corresponding quasi-adiabatic evolution. In case of the QTG-approach, it emulates one execution of
+ *                  the full circuit, whereas it actually simulates the gates for the Copula-QAOA. The basic structure
+ *                  in both cases is as follows: First, the initial state is restored into the given memory.
+ *                  Afterwards, the depth specifies the number of alternating repitions of calling the phase
+ *                  separation and mixing unitaries, respectively.
  * Parameters:
- *      angles:         Pointer to list of angles with length equaling twice the depth.
- * Returns:             The negative expectation value corresponding to the specified angles.
+ *      ctx:        Pointer to the QAOA context.
+ *      angle_state: Pointer to memory for num_states amplitudes; will be updated.
+ *      angles:     Pointer to list of angles with length equaling twice the depth.
  */
-double angles_to_value(const double* angles);
+void evolve_state(qaoa_context_t* ctx, cmplx* angle_state, const double* angles);
 
 
 /*
- * =============================================================================
+ * Function:        quasiadiabatic_evolution
+ * --------------------
+ * Description:     Performs the quasi-adiabatic evolution (see evolve_state) in newly allocated memory.
+ * Parameters:
+ *      ctx:        Pointer to the QAOA context.
+ *      angles:     Pointer to list of angles with length equaling twice the depth.
+ * Returns:         The state with updated amplitudes after the alternating application.
+ * Side Effect:     Allocates dynamically; pointer should eventually be freed.
+ */
+cmplx* quasiadiabatic_evolution(qaoa_context_t* ctx, const double* angles);
+
+
+/*
+ * Function:        create_workspace
+ * --------------------
+ * Description:     Allocates the memory needed for evaluating the objective function once.
+ * Parameters:
+ *      ctx:        Pointer to the QAOA context.
+ * Returns:         Pointer to the workspace.
+ * Side Effect:     Allocates dynamically; should eventually be freed via free_workspace.
+ */
+workspace_t* create_workspace(qaoa_context_t* ctx);
+
+
+/*
+ * Function:        free_workspace
+ * --------------------
+ * Description:     Frees a workspace including the memory it holds.
+ * Parameters:
+ *      workspace:  Pointer to the workspace.
+ */
+void free_workspace(workspace_t* workspace);
+
+
+/*
+ * Function:        mps_quasiadiabatic_evolution
+ * --------------------
+ * Description:     Quasi-adiabatic evolution of the Copula QAOA on a linear instance with the MPS backend. The phase
+ *                  separation unitary acts as single-qubit phases, and the two-qubit Copula unitaries are applied with
+ *                  truncation to the maximal bond dimension of the run options.
+ * Parameters:
+ *      ctx:        Pointer to the QAOA context.
+ *      angles:     Pointer to list of angles with length equaling twice the depth.
+ * Returns:         The evolved MPS.
+ * Side Effect:     Allocates dynamically; should eventually be freed via free_mps.
+ */
+mps_t* mps_quasiadiabatic_evolution(qaoa_context_t* ctx, const double* angles);
+
+
+/*
+ * =============================================================================
+ *                                 Evaluation
+ * =============================================================================
+ */
+
+/*
+ * Function:            expectation_value
+ * --------------------
+ * Description:         Computes the expectation value of the objective Hamiltonian in a given state based on the actual
+                        amplitudes of the state.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      angle_state:    Pointer to the state to compute the expectation value for.
+ * Returns:             The sum of all terms making the expectation value.
+ */
+double expectation_value(qaoa_context_t* ctx, const cmplx* angle_state);
+
+
+/*
+ * Function:            workspace_value
+ * --------------------
+ * Description:         Computes the expectation value, given a set of angles, by executing the quasi-adiabatic
+ *                      evolution in the given workspace and processing the result afterwards.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      workspace:      Pointer to the workspace that the evolution is carried out in.
+ *      angles:         Pointer to list of angles with length equaling twice the depth.
+ * Returns:             The expectation value corresponding to the specified angles.
+ */
+double workspace_value(qaoa_context_t* ctx, workspace_t* workspace, const double* angles);
+
+
+/*
+ * Function:            angles_to_value
+ * --------------------
+ * Description:         Computes the expectation value, given a set of angles, by executing the quasi-adiabatic
+ *                      evolution in the run's evaluation workspace and processing the result afterwards.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      angles:         Pointer to list of angles with length equaling twice the depth.
+ * Returns:             The expectation value corresponding to the specified angles.
+ */
+double angles_to_value(qaoa_context_t* ctx, const double* angles);
+
+
+/*
+ * =============================================================================
+ *                            Budgets and tracing
+ * =============================================================================
+ */
+
+/*
+ * Function:            start_trace
+ * --------------------
+ * Description:         Resets the evaluation trace and starts the clock of the budgets.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ */
+void start_trace(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            remaining_evals
+ * --------------------
+ * Description:         Computes the number of evaluations left within options.max_evals.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ * Returns:             The number of evaluations left, or SIZE_MAX if there is no limit.
+ */
+size_t remaining_evals(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            remaining_time
+ * --------------------
+ * Description:         Computes the wall-clock seconds left within options.max_time.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ * Returns:             The seconds left, or INFINITY if there is no limit.
+ */
+double remaining_time(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            budget_left
+ * --------------------
+ * Description:         Checks whether both budgets allow further evaluations and marks the trace as exhausted
+ *                      otherwise.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ * Returns:             Whether further evaluations are allowed.
+ */
+bool_t budget_left(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            traced_value
+ * --------------------
+ * Description:         Computes the expectation value of the given angles in a workspace and appends the evaluation
+ *                      to the trace, unless the angles are found in the memo cache; then their cached value
+ *                      is returned without an evaluation. Keeps track of the best angles and writes a checkpoint
+ *                      every CHECKPOINT_INTERVAL seconds. Safe to call from concurrent threads.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      workspace:      Pointer to the workspace to evaluate in.
+ *      angles:         Pointer to list of angles with length equaling twice the depth.
+ * Returns:             The expectation value corresponding to the specified angles.
+ */
+double traced_value(qaoa_context_t* ctx, workspace_t* workspace, const double* angles);
+
+
+/*
+ * =============================================================================
+ *                                 Memo cache
+ * =============================================================================
+ */
+
+/*
+ * Function:            create_eval_cache
+ * --------------------
+ * Description:         Replaces the memo cache by an empty one for angle vectors of the current depth, with
+ *                      as many slots as fit into the given number of bytes.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      max_bytes:      Maximal size of the cache in bytes; the cache is disabled if not even one slot fits.
+ * Side Effect:         Allocates dynamically; freed by free_eval_cache.
+ */
+void create_eval_cache(qaoa_context_t* ctx, size_t max_bytes);
+
+
+/*
+ * Function:            free_eval_cache
+ * --------------------
+ * Description:         Frees the memo cache and disables it.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ */
+void free_eval_cache(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            cache_lookup
+ * --------------------
+ * Description:         Looks up angles in the memo cache and counts the hit or miss. Safe to call from
+ *                      concurrent threads.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      angles:         Pointer to list of angles with length equaling twice the depth.
+ *      value:          Pointer to the storage of the value; set if the angles are found.
+ * Returns:             Whether the angles are found.
+ */
+bool_t cache_lookup(qaoa_context_t* ctx, const double* angles, double* value);
+
+
+/*
+ * Function:            cache_insert
+ * --------------------
+ * Description:         Stores the value of angles in the memo cache. Safe to call from concurrent threads.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      angles:         Pointer to list of angles with length equaling twice the depth.
+ *      value:          Expectation value of the angles.
+ */
+void cache_insert(qaoa_context_t* ctx, const double* angles, double value);
+
+
+/*
+ * =============================================================================
+ *                                 Checkpoints
+ * =============================================================================
+ */
+
+/*
+ * Function:            instance_hash
+ * --------------------
+ * Description:         Hashes everything the expectation values of a run depend on apart from its angles, i.e. the
+ *                      items, the capacity, the QAOA type, the bias, k, theta, the objective function and the backend,
+ *                      by 64-bit FNV-1a.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ * Returns:             The hash of the instance context.
+ */
+uint64_t instance_hash(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            open_checkpoint
+ * --------------------
+ * Description:         Starts checkpointing the angle optimization of a run to checkpoint.bin in its storage directory.
+ *                      With options.resume, the progress of a checkpoint that matches the instance hash, the depth,
+ *                      the grid resolution, the grid search and the number of starts is restored; its evaluations
+ *                      and seconds count towards the budgets. Requires the trace to be started.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      instance:       Pointer to the name of the instance.
+ * Side Effect:         Allocates the progress dynamically; it should eventually be freed via close_checkpoint.
+ */
+void open_checkpoint(qaoa_context_t* ctx, const char* instance);
+
+
+/*
+ * Function:            checkpoint_snapshot
+ * --------------------
+ * Description:         Copies the progress into a buffer laid out as the checkpoint file, so that it can be written
+ *                      while the optimization goes on; see store_checkpoint. Requires the run to be checkpointed.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      num_bytes:      Pointer to the size of the buffer; will be set.
+ * Returns:             Pointer to the buffer.
+ * Side Effect:         Allocates the buffer dynamically; it should eventually be freed.
+ */
+char* checkpoint_snapshot(qaoa_context_t* ctx, size_t* num_bytes);
+
+
+/*
+ * Function:            store_checkpoint
+ * --------------------
+ * Description:         Writes a snapshot of the progress to a temporary file and renames it to the checkpoint file,
+ *                      so that a crash never leaves a truncated checkpoint behind. Concurrent stores are serialized.
+ * Parameters:
+ *      path:           Pointer to the path of the checkpoint file.
+ *      snapshot:       Pointer to the snapshot, see checkpoint_snapshot.
+ *      num_bytes:      Size of the snapshot.
+ */
+void store_checkpoint(const char* path, const char* snapshot, size_t num_bytes);
+
+
+/*
+ * Function:            write_checkpoint
+ * --------------------
+ * Description:         Writes the progress to the checkpoint file via checkpoint_snapshot and store_checkpoint. Does
+ *                      nothing if the run is not checkpointed.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ */
+void write_checkpoint(qaoa_context_t* ctx);
+
+
+/*
+ * Function:            checkpoint_layers
+ * --------------------
+ * Description:         Records and writes the progress of a layer-wise grid search.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      completed_layers: Number of layers that are completed.
+ *      best_angles:    Pointer to the best angles of the completed layers, followed by zeros.
+ *      best_value:     Value of the best angles.
+ */
+void checkpoint_layers(qaoa_context_t* ctx, int completed_layers, const double* best_angles, double best_value);
+
+
+/*
+ * Function:            checkpoint_search
+ * --------------------
+ * Description:         Records and writes the candidates of a completed grid search.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ *      starts:         Pointer to the num_starts candidates, sorted by their values.
+ *      start_values:   Pointer to their values.
+ */
+void checkpoint_search(qaoa_context_t* ctx, const double* starts, const double* start_values);
+
+
+/*
+ * Function:            close_checkpoint
+ * --------------------
+ * Description:         Removes the checkpoint file of a run whose results are exported and frees the progress.
+ * Parameters:
+ *      ctx:            Pointer to the QAOA context.
+ */
+void close_checkpoint(qaoa_context_t* ctx);
+
+
+/*
+ * =============================================================================
  *                                 Optimization
  * =============================================================================
  */
@@ -422,7 +1468,7 @@ double angles_to_value(const double* angles);
  *      n:              The number of parameters to optimize (not used).
  *      angles:         Pointer to list of angles with length equaling twice the depth.
  *      grad:           Gradient (not used).
- *      my_func_data:   Function data, e.g. parameters that shall not be optimized over (not used).
+ *      my_func_data:   Pointer to the workspace to evaluate in, which refers to its context.
  * Returns:             The negative expectation value corresponding to the specified angles.
  */
 double angles_to_value_nlopt(unsigned n, const double* angles, double* grad, void* my_func_data);
@@ -441,30 +1487,293 @@ nlopt_algorithm map_enum_to_nlopt_algorithm(opt_t opt_type);
 
 
 /*
-* Function:            fine_grid_search
-* --------------------
-* Description:         Performs a layer-wise fine-grid search on the domain [0,2pi)x[0,2pi) for every pair of angles.
-*                      Each pair of angles gets optimized independently and one after the other.
-* Parameters:
-*      m:              Number of steps into which each [0,2pi) interval is partitioned.
-*      best_angles:    Pointer to the best angles found so far; will be updated.
-*      best_value:     Pointer to the best objective value; starts at -infinity and will be updated.
-*/
-void fine_grid_search(int m, double* best_angles, double* best_value);
+* Function:            compute_gamma_period
+* --------------------
+* Description:         Sets ctx->gamma_period to 2pi/g, where g is the greatest common divisor of the profits of
+*                      all simulated states. Since the phase separator multiplies every state by exp(-i gamma profit),
+*                      the expectation value is periodic in each gamma with this period.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*/
+void compute_gamma_period(qaoa_context_t* ctx);
+
+
+/*
+* Function:            canonicalize_angles
+* --------------------
+* Description:         Maps angles into the reduced domain searched by the optimizer. Every gamma is reduced modulo
+*                      gamma_period and every beta modulo 2pi. As the initial state and the mixers are real, complex
+*                      conjugation maps the evolution for (gamma, beta) to the one for (-gamma, -beta) with the same
+*                      expectation value; hence angles whose first gamma exceeds half a period are replaced by their
+*                      negatives, which puts the first gamma into [0, gamma_period / 2].
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      angles:         Pointer to 2 * depth angles; will be updated.
+*/
+void canonicalize_angles(qaoa_context_t* ctx, double* angles);
+
+
+/*
+* Function:            workspace_budget
+* --------------------
+* Description:         Determines the bytes that the per-thread workspaces of a batch evaluation may take together, i.e.
+*                      WORKSPACE_MEMORY_SHARE of the memory limit of the run or else of the physical memory.
+* Parameters:
+*      options:        Pointer to the run options.
+* Returns:             The number of bytes.
+*/
+size_t workspace_budget(const run_options_t* options);
+
+
+/*
+* Function:            workspace_threads
+* --------------------
+* Description:         Determines the number of threads for independent tasks that each need an evaluation workspace,
+*                      such that all workspaces together fit into workspace_budget. The processors left idle are
+*                      shared by the kernels of every evaluation, see kernel_threads.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      num_tasks:      Number of independent tasks.
+* Returns:             The number of threads, at least 1 and at most num_tasks.
+*/
+int workspace_threads(qaoa_context_t* ctx, size_t num_tasks);
+
+
+/*
+* Function:            evaluate_angle_batch
+* --------------------
+* Description:         Computes the expectation values of a batch of independent angle vectors. The batch is
+*                      distributed across threads that each own an evaluation workspace; the number of threads is
+*                      limited such that all workspaces together fit into workspace_budget, and the kernels of every
+*                      evaluation share the processors left idle. All evaluations are traced; points beyond the
+*                      evaluation or time budget are skipped and get the value -INFINITY.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      batch:          Pointer to num_points angle vectors of length 2 * depth, stored one after the other.
+*      num_points:     Number of angle vectors.
+*      values:         Pointer to the storage for the num_points expectation values.
+*/
+void evaluate_angle_batch(qaoa_context_t* ctx, const double* batch, size_t num_points, double* values);
+
+
+/*
+* Function:            fine_grid_search
+* --------------------
+* Description:         Performs a layer-wise fine-grid search on the domain [0,gamma_period)x[0,2pi) for every pair of
+*                      angles, with m steps per period; the first gamma is restricted to [0,gamma_period/2] (see
+*                      canonicalize_angles). Each pair of angles gets optimized independently and one after the other. The m^2 grid points
+*                      of a layer are evaluated in parallel; ties are broken in favour of the lowest grid index, so
+*                      the result equals the one of a serial search. Besides the best angles, the runners-up among the
+*                      grid points of the last layer are returned as further candidates. Every completed layer is
+*                      checkpointed, and a resumed search starts after the layers of its checkpoint.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      m:              Number of steps into which each [0,2pi) interval is partitioned.
+*      num_candidates: Number of candidates to be returned.
+*      best_angles:    Pointer to storage for num_candidates angle vectors; will be set to the candidates, the best
+*                      one first.
+*      best_values:    Pointer to storage for the num_candidates objective values of the candidates; will be set.
+*/
+void fine_grid_search(qaoa_context_t* ctx, int m, int num_candidates, double* best_angles, double* best_values);
+
+
+/*
+* Function:            adaptive_grid_search
+* --------------------
+* Description:         Layer-wise coarse-to-fine alternative to fine_grid_search with the same outputs. Each layer
+*                      spends half of its share of the budget on a coarse uniform grid; then the step is halved
+*                      repeatedly and the 8 neighbours of the ADAPTIVE_REFINE_CELLS best points found so far are
+*                      evaluated, until the budget is exhausted or the step falls below 1/ADAPTIVE_MAX_ZOOM of the
+*                      uniform step 2pi/m. Every level is evaluated in parallel and ties go to the earlier point.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      m:              Number of steps of the uniform grid, which determines the finest step.
+*      budget:         Number of evaluations over all layers.
+*      num_candidates: Number of candidates to be returned.
+*      best_angles:    Pointer to storage for num_candidates angle vectors; will be set to the candidates, the best
+*                      one first.
+*      best_values:    Pointer to storage for the num_candidates objective values of the candidates; will be set.
+*/
+void adaptive_grid_search(qaoa_context_t* ctx, int m, int budget, int num_candidates, double* best_angles,
+                          double* best_values);
+
+
+/*
+* Function:            dirichlet_kernel
+* --------------------
+* Description:         Dirichlet kernel sin(N x / 2) / (N sin(x / 2)), through which the trigonometric polynomial of
+*                      order (N - 1) / 2 that interpolates N equispaced samples f_k at x_k is sum_k f_k D(x - x_k).
+* Parameters:
+*      num_samples:    Odd number N of samples per period.
+*      x:              Argument.
+* Returns:             The value of the kernel; 1 at multiples of 2pi.
+*/
+double dirichlet_kernel(int num_samples, double x);
+
+
+/*
+* Function:            fourier_search
+* --------------------
+* Description:         Layer-wise alternative to fine_grid_search with the same outputs that exploits that the
+*                      expectation value is a trigonometric polynomial in the beta of a layer. On each of the m lines
+*                      of constant gamma of the uniform grid (m/2 + 1 for the first layer), only 2 beta_order + 1
+*                      equispaced betas are evaluated, in parallel, and their trigonometric interpolant is maximized
+*                      on a grid of FOURIER_RESOLUTION points between two samples. The maxima of the
+*                      FOURIER_VERIFY_POINTS best lines are evaluated exactly, and the best evaluated point of a layer
+*                      is kept; ties go to the earlier point. The interpolant is exact if the expectation value has no
+*                      higher frequency in beta, e.g. beta_order = 1 for the Grover mixer.
+* Parameters:
+*      ctx:            Pointer to the QAOA context.
+*      m:              Number of steps into which the period of gamma is partitioned.
+*      beta_order:     Order of the trigonometric interpolant in beta.
+*      num_candidates: Number of candidates to be returned.
+*      best_angles:    Pointer to storage for num_candidates angle vectors; will be set to the candidates, the best
+*                      one first.
+*      best_values:    Pointer to storage for the num_candidates objective values of the candidates; will be set.
+*/
+void fourier_search(qaoa_context_t* ctx, int m, int beta_order, int num_candidates, double* best_angles,
+                    double* best_values);
+
+
+/*
+* Function:               nlopt_optimizer
+* -----------------------
+* Description:            Performs the full angle optimization routine. Every angle gets initialized to 0, the chosen
+*                         classical optimization type is mapped to an NLOpt algorithm with a constraint of one period
+*                         for each angle, i.e. [0,gamma_period] for gamma and [0,2pi] for beta, and only about half
+*                         a period for the first gamma; the optimized angles are canonicalized. A layer-wise fine-grid search is applied as a warm start. After the
+*                         Fourier surrogate search (grid=fourier), every local optimization is limited to
+*                         FOURIER_REFINE_EVALS evaluations per angle. One local
+*                         optimization is started from each of the options.num_starts best grid points; the starts
+*                         run concurrently with an optimizer and a workspace of their own, and the best result is kept.
+*                         If the run resumes from a checkpoint of a completed search, the search is skipped and the
+*                         best start is replaced by the best angles evaluated so far, if they are better. If the
+*                         context holds the candidates of a batched search, see grid_starts, they are the starts.
+* Parameters:
+*      ctx:               Pointer to the QAOA context.
+*      optimization_type: Classical optimization type.
+*      m:                 Number of partitions in the fine-grid search.
+*      memory_size:       Memory size for the classical optimizer; only needed in case of BFGS.
+*/
+double* nlopt_optimizer(qaoa_context_t* ctx, opt_t optimization_type, int m, int memory_size);
+
+
+/*
+* Function:               multi_start_optimizer
+* -----------------------
+* Description:            Runs one local optimization from each of the given starts concurrently, each with an
+*                         optimizer and a workspace of its own, logs their results and keeps the best one.
+* Parameters:
+*      ctx:               Pointer to the QAOA context.
+*      optimization_type: Classical optimization type.
+*      memory_size:       Memory size for the classical optimizer; only needed in case of BFGS.
+*      num_starts:        Number of starts.
+*      starts:            Pointer to num_starts angle vectors, stored one after the other; will be overwritten by the
+*                         local optima.
+*      start_values:      Pointer to the objective values of the starts; only used for logging.
+*      max_evals_per_start: Maximal number of evaluations of each local optimization on top of the budgets;
+*                         SIZE_MAX for none.
+* Returns:                Pointer to the best angles found.
+* Side Effect:            Allocates the returned angles dynamically.
+*/
+double* multi_start_optimizer(qaoa_context_t* ctx, opt_t optimization_type, int memory_size, int num_starts,
+                              double* starts, const double* start_values, size_t max_evals_per_start);
+
+
+/*
+* Function:               warm_start_optimizer
+* -----------------------
+* Description:            Performs a local optimization from the given angles without any preceding grid search. A
+*                         resumed run starts from the best angles of its checkpoint instead.
+* Parameters:
+*      ctx:               Pointer to the QAOA context.
+*      optimization_type: Classical optimization type.
+*      memory_size:       Memory size for the classical optimizer; only needed in case of BFGS.
+*      start_angles:      Pointer to the angles to start from.
+* Returns:                Pointer to the optimized angles.
+* Side Effect:            Allocates the returned angles dynamically.
+*/
+double* warm_start_optimizer(qaoa_context_t* ctx, opt_t optimization_type, int memory_size, const double* start_angles);
+
+
+/*
+* Function:               interpolate_angles
+* -----------------------
+* Description:            Extends optimized angles of depth p to depth p + 1 by the INTERP strategy of Zhou et al.:
+*                         the new gamma (beta) values sample the piecewise linear interpolation of the old ones, i.e.
+*                         new_i = (i * old_{i-1} + (p - i) * old_i) / p for i = 0, ..., p with old_{-1} = old_p = 0.
+* Parameters:
+*      prev_depth:        The depth p of the given angles.
+*      prev_angles:       Pointer to 2 * p angles.
+*      angles:            Pointer to storage for 2 * (p + 1) angles; will be set.
+*/
+void interpolate_angles(int prev_depth, const double* prev_angles, double* angles);
+
+
+/*
+ * =============================================================================
+ *                              Parameter transfer
+ * =============================================================================
+ */
+
+/*
+ * Function:                        instance_angle_key
+ * ----------------------
+ * Description:                     Builds the key of the current run for the angle database from the context
+ *                                  and the instance name, whose "_g_<int>" part gives the number of item groups.
+ *                                  The count cannot be recovered from the items themselves, so it is 0, i.e.
+ *                                  unknown and ignored by the distance, for names without that part.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      instance:                   Pointer to the name of the instance.
+ * Returns:                         The key.
+ */
+angle_key_t instance_angle_key(qaoa_context_t* ctx, const char* instance);
+
+
+/*
+ * Function:                        path_to_angle_db
+ * ----------------------
+ * Description:                     Returns the path to the angle database shared by all instances, which is located
+ *                                  in the instances directory.
+ * Returns:                         Pointer to the path.
+ * Side Effect:                     Allocates dynamically; should be freed.
+ */
+char* path_to_angle_db();
+
+
+/*
+ * Function:                        transfer_optimizer
+ * ----------------------
+ * Description:                     Looks up the options.num_starts nearest entries of the angle database, rescales their
+ *                                  gamma values to the mean profit of the instance at hand and evaluates them. If the
+ *                                  best of them reaches at least TRANSFER_ACCEPT times the approximation ratio that
+ *                                  was recorded for it, local optimizations are started from all of them and the
+ *                                  fine-grid search is skipped.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      optimization_type:          Classical optimization type.
+ *      memory_size:                Memory size for the classical optimizer; only needed in case of BFGS.
+ *      instance:                   Pointer to the name of the instance.
+ *      optimal_sol_val:            Optimal solution value.
+ * Returns:                         Pointer to the optimized angles, or NULL if no transferred start is good enough.
+ * Side Effect:                     Allocates the returned angles dynamically.
+ */
+double* transfer_optimizer(qaoa_context_t* ctx, opt_t optimization_type, int memory_size, const char* instance,
+                           num_t optimal_sol_val);
 
 
 /*
-* Function:               nlopt_optimizer
-* -----------------------
-* Description:            Performs the full angle optimization routine. Every angle gets initialized to 0, the chosen
-*                         classical optimization type is mapped to an NLOpt algorithm with a constraint of [0,2pi)
-*                         domain for each angle. A layer-wise fine-grid search is applied as a warm start.
-* Parameters:
-*      optimization_type: Classical optimization type.
-*      m:                 Number of partitions in the fine-grid search.
-*      memory_size:       Memory size for the classical optimizer; only needed in case of BFGS.
-*/
-double* nlopt_optimizer(opt_t optimization_type, int m, int memory_size);
+ * Function:                        export_angles
+ * ----------------------
+ * Description:                     Appends the optimized angles of the current run to the angle database.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      instance:                   Pointer to the name of the instance.
+ *      tot_approx_ratio:           Total approximation ratio reached by the angles.
+ *      angles:                     Pointer to the optimized angles.
+ */
+void export_angles(qaoa_context_t* ctx, const char* instance, double tot_approx_ratio, const double* angles);
 
 
 /*
@@ -478,10 +1787,11 @@ double* nlopt_optimizer(opt_t optimization_type, int m, int memory_size);
  * ----------------------
  * Description:                     Assembles the path to the folder of the instance at hand.
  * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
  *      instance:                   Pointer to the name of the instance.
  * Returns:                         Pointer to the path.
  */
-char* path_for_instance(const char* instance);
+char* path_for_instance(qaoa_context_t* ctx, const char* instance);
 
 
 /*
@@ -489,10 +1799,22 @@ char* path_for_instance(const char* instance);
  * ----------------------
  * Description:                     Combines the path to the instance with an addition for the classical optimizer .
  * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
  *      instance:                   Pointer to the name of the instance.
  * Returns:                         Pointer to the path.
  */
-char* path_to_storage(const char* instance);
+char* path_to_storage(qaoa_context_t* ctx, const char* instance);
+
+
+/*
+ * Function:                        create_storage_dirs
+ * ----------------------
+ * Description:                     Creates all missing directories on the path returned by path_to_storage.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      instance:                   Pointer to the name of the instance.
+ */
+void create_storage_dirs(qaoa_context_t* ctx, const char* instance);
 
 
 /*
@@ -504,6 +1826,7 @@ char* path_to_storage(const char* instance);
  *                                  whose profit is larger than the Greedy solution.
  *
  * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
  *      instance:                   Pointer to the name of the instance.
  *      optimal_sol_val:            Optimal solution value of the knapsack instance at hand.
  *      int_greedy_sol_val:         Integer Greedy solution value.
@@ -511,6 +1834,7 @@ char* path_to_storage(const char* instance);
  *      prob_beating_greedy:        Probability of measuring a state with an objective value better than Greedy.
  */
 void export_results(
+    qaoa_context_t* ctx,
     const char* instance,
     num_t optimal_sol_val,
     num_t int_greedy_sol_val,
@@ -519,19 +1843,141 @@ void export_results(
 );
 
 
+/*
+ * Function:                        build_distribution
+ * ----------------------
+ * Description:                     Accumulates the probabilities of a state by distinct profit in a single pass over
+ *                                  the states, via a hash table that grows with the number of distinct profits.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      angle_state:                Pointer to the state.
+ *      dist:                       Pointer to the distribution; will be set.
+ * Side Effect:                     Allocates the profits and probabilities dynamically; freed by free_distribution.
+ */
+void build_distribution(qaoa_context_t* ctx, const cmplx* angle_state, distribution_t* dist);
+
+
+/*
+ * Function:                        free_distribution
+ * ----------------------
+ * Description:                     Frees the profits and probabilities of a distribution.
+ * Parameters:
+ *      dist:                       Pointer to the distribution.
+ */
+void free_distribution(distribution_t* dist);
+
+
+/*
+ * Function:                        distribution_quantile
+ * ----------------------
+ * Description:                     Returns the smallest profit whose cumulative probability reaches the given one,
+ *                                  where infeasible states count as profit 0 as in the modified objective function.
+ * Parameters:
+ *      dist:                       Pointer to the distribution.
+ *      prob:                       Cumulative probability between 0 and 1.
+ * Returns:                         The quantile of the profit.
+ */
+num_t distribution_quantile(const distribution_t* dist, double prob);
+
+
+/*
+ * Function:                        export_distribution
+ * ----------------------
+ * Description:                     Exports the distribution of the final state of the QAOA run: distribution.csv lists
+ *                                  the profit, approximation ratio, probability and cumulative probability of every
+ *                                  distinct feasible profit, and quantiles.txt the probability of the infeasible states
+ *                                  and the approximation ratios at the quantiles of the options. Its size grows with
+ *                                  the number of distinct profits instead of the number of states.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      instance:                   Pointer to the name of the instance.
+ *      angle_state:                Pointer to the final state of the run.
+ *      optimal_sol_val:            Optimal solution value of the knapsack instance at hand.
+ */
+void export_distribution(qaoa_context_t* ctx, const char* instance, const cmplx* angle_state, num_t optimal_sol_val);
+
+
 /*
  * Function:                        export_raw_data
  * ----------------------
- * Description:                     Exports the raw data of the QAOA run to an external file, consisting of as many
- *                                  pairs of approximation ratio and probability as there are states in the simulation.
+ * Description:                     Exports the raw data of the QAOA run to raw_data.bin, consisting of as many pairs of
+ *                                  approximation ratio and probability as there are states in the simulation, in the
+ *                                  binary format of raw_data_header_t. Each column is computed and written in chunks
+ *                                  of RAW_DATA_CHUNK states; convert_raw_data recovers the former text format.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      instance:                   Pointer to the name of the instance.
+ *      angle_state:                Pointer to the final state of the run.
+ *      optimal_sol_val:            Optimal solution value of the knapsack instance at hand.
+ */
+void export_raw_data(qaoa_context_t* ctx, const char* instance, const cmplx* angle_state, num_t optimal_sol_val);
+
+
+/*
+ * Function:                        convert_raw_data
+ * ----------------------
+ * Description:                     Streams a binary raw-data file as text with one line "<ratio> <probability>" per
+ *                                  state, as formerly written by export_raw_data.
+ * Parameters:
+ *      path:                       Pointer to the path of the binary raw-data file.
+ *      out:                        Pointer to the file the text is written to.
+ * Returns:                         Whether the file could be read and is of a known version.
+ */
+bool_t convert_raw_data(const char* path, FILE* out);
+
+
+/*
+ * Function:                        export_trace
+ * ----------------------
+ * Description:                     Exports the evaluation trace of the angle optimization as trace.csv next to the
+ *                                  results, holding one line with evaluation index, elapsed seconds, value and angles
+ *                                  per evaluation in the order of their completion.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      instance:                   Pointer to the name of the instance.
+ */
+void export_trace(qaoa_context_t* ctx, const char* instance);
+
+
+/*
+ * Function:                        export_summary
+ * ----------------------
+ * Description:                     Exports key=value statistics of the angle optimization as summary.txt next to the
+ *                                  results: the number of evaluations (in total, in searches, in local
+ *                                  optimizations and in a batched search beforehand), the elapsed seconds, the budgets and whether they were exhausted,
+ *                                  and the hits, misses and hit rate of the memo cache.
+ * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
+ *      instance:                   Pointer to the name of the instance.
+ */
+void export_summary(qaoa_context_t* ctx, const char* instance);
+
+
+/*
+ * Function:                        export_result_record
+ * ----------------------
+ * Description:                     Appends the record of a run to options.results_log via append_result, keyed by the
+ *                                  instance, the QAOA type, the depth, the optimizer and the parameters m, bias, k,
+ *                                  theta and the non-default initialization, grid search and number of starts, as
+ *                                  written by format_result_params. Does nothing without a results log.
  * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
  *      instance:                   Pointer to the name of the instance.
  *      optimal_sol_val:            Optimal solution value of the knapsack instance at hand.
  *      int_greedy_sol_val:         Integer Greedy solution value.
- *      tot_approx_ratio:           Total approximation ratio returned by QAOA.
- *      prob_beating_greedy:        Probability of measuring a state with an objective value better than Greedy.
+ *      tot_approx_ratio:           Total approximation ratio of the QAOA.
+ *      prob_beating_greedy:        Probability of beating Greedy.
+ *      warm_start:                 Whether the angles were optimized from those of the previous depth only.
  */
-void export_raw_data(const char* instance, const cbs_t* angke_state, num_t optimal_sol_val);
+void export_result_record(
+    qaoa_context_t* ctx,
+    const char* instance,
+    num_t optimal_sol_val,
+    num_t int_greedy_sol_val,
+    double tot_approx_ratio,
+    double prob_beating_greedy,
+    bool_t warm_start
+);
 
 
 /*
@@ -541,10 +1987,11 @@ void export_raw_data(const char* instance, const cbs_t* angke_state, num_t optim
  *                                  external file. This includes the qubit count, the cycle count, the gate count as
  *                                  well as the latter two with Toffoli gates being decomposed.
  * Parameters:
+ *      ctx:                        Pointer to the QAOA context.
  *      instance:                   Pointer to the name of the instance.
  *      res:                        Resources counted.
  */
-void export_resources(const char* instance, resource_t res);
+void export_resources(qaoa_context_t* ctx, const char* instance, resource_t res);
 
 
 /*
@@ -553,57 +2000,378 @@ void export_resources(const char* instance, resource_t res);
  * =============================================================================
  */
 
+/*
+ * Function:                create_context
+ * --------------------
+ * Description:             Creates the context of a QAOA run with the given hyperparameters; its tables are filled by
+ *                          prepare_instance and run_qaoa.
+ * Parameters:
+ *      input_kp:           Pointer to the knapsack; it must outlive the context.
+ *      input_qaoa_type:    The type of the QAOA, i.e. QTG or Copula.
+ *      input_depth:        The depth of the QAOA.
+ *      input_opt_type:     The classical method that shall be used for the optimization.
+ *      input_m:            Grid resolution per angle.
+ *      input_bias:         The bias for the QTG.
+ *      copula_k:           The hyperparameter k for the probability distribution in the Copula ansatz.
+ *      copula_theta:       The hyperparameter theta for the two-qubit Copula unitaries.
+ *      input_memory_size:  Memory size for the classical optimizer; only needed in case of BFGS.
+ *      input_kp_type:      Whether the knapsack instance is linear or quadratic.
+ *      input_options:      Pointer to the run options.
+ * Returns:                 Pointer to the context; NULL if the options do not fit the QAOA type.
+ * Side Effect:             Allocates dynamically; should eventually be freed via free_context.
+ */
+qaoa_context_t* create_context(
+    knapsack_t* input_kp,
+    qaoa_type_t input_qaoa_type,
+    int input_depth,
+    opt_t input_opt_type,
+    int input_m,
+    size_t input_bias,
+    double copula_k,
+    double copula_theta,
+    int input_memory_size,
+    knapsack_type_t input_kp_type,
+    const run_options_t* input_options
+);
+
+
+/*
+ * Function:                prepare_instance
+ * --------------------
+ * Description:             Computes everything that only depends on the instance and not on the hyperparameters of a
+ *                          run: the integer Greedy solution, the QTG states or the Copula objective function values and
+ *                          feasibilities, and the optimal solution value.
+ * Parameters:
+ *      ctx:                Pointer to the QAOA context.
+ *      int_greedy_sol_val: Pointer to the integer Greedy solution value; will be set.
+ *      optimal_sol_val:    Pointer to the optimal solution value; will be set.
+ * Side Effect:             Allocates the instance-dependent tables of the context; freed by free_context.
+ */
+void prepare_instance(qaoa_context_t* ctx, num_t* int_greedy_sol_val, num_t* optimal_sol_val);
+
+
+/*
+ * Function:                prepare_instance_context
+ * --------------------
+ * Description:             Prepares an instance once for all runs that only differ in the depth, the optimizer, the
+ *                          grid resolution, k or theta, see prepare_instance.
+ * Parameters:
+ *      input_kp:           Pointer to the knapsack; owned by the preparation on success.
+ *      input_qaoa_type:    The type of the QAOA, i.e. QTG or Copula.
+ *      input_bias:         The bias for the QTG.
+ *      input_kp_type:      Whether the knapsack instance is linear or quadratic.
+ *      input_options:      Pointer to the run options; only the backend is used.
+ * Returns:                 Pointer to the preparation with a reference count of 1; NULL if the options do not fit the
+ *                          QAOA type.
+ * Side Effect:             Allocates dynamically; should eventually be released via release_instance_context.
+ */
+instance_context_t* prepare_instance_context(
+    knapsack_t* input_kp,
+    qaoa_type_t input_qaoa_type,
+    size_t input_bias,
+    knapsack_type_t input_kp_type,
+    const run_options_t* input_options
+);
+
+
+/*
+ * Function:                retain_instance_context
+ * --------------------
+ * Description:             Adds a holder to a shared preparation.
+ * Parameters:
+ *      prepared:           Pointer to the preparation.
+ */
+void retain_instance_context(instance_context_t* prepared);
+
+
+/*
+ * Function:                release_instance_context
+ * --------------------
+ * Description:             Removes a holder from a shared preparation and frees it, including its knapsack, once no
+ *                          holder is left.
+ * Parameters:
+ *      prepared:           Pointer to the preparation.
+ */
+void release_instance_context(instance_context_t* prepared);
+
+
+/*
+ * Function:                instance_context_bytes
+ * --------------------
+ * Description:             Returns the memory held by a preparation, i.e. its knapsack and its tables.
+ * Parameters:
+ *      prepared:           Pointer to the preparation.
+ * Returns:                 The number of bytes.
+ */
+double instance_context_bytes(const instance_context_t* prepared);
+
+
+/*
+ * Function:                create_shared_context
+ * --------------------
+ * Description:             Creates the context of a QAOA run on a shared preparation, whose tables it borrows.
+ * Parameters:
+ *      prepared:           Pointer to the preparation; retained until the context is freed.
+ *      input_depth:        The depth of the QAOA.
+ *      input_opt_type:     The classical method that shall be used for the optimization.
+ *      input_m:            Grid resolution per angle.
+ *      copula_k:           The hyperparameter k for the probability distribution in the Copula ansatz.
+ *      copula_theta:       The hyperparameter theta for the two-qubit Copula unitaries.
+ *      input_memory_size:  Memory size for the classical optimizer; only needed in case of BFGS.
+ *      input_options:      Pointer to the run options.
+ * Returns:                 Pointer to the context; NULL if the options do not fit the QAOA type.
+ * Side Effect:             Allocates dynamically; should eventually be freed via free_context.
+ */
+qaoa_context_t* create_shared_context(
+    instance_context_t* prepared,
+    int input_depth,
+    opt_t input_opt_type,
+    int input_m,
+    double copula_k,
+    double copula_theta,
+    int input_memory_size,
+    const run_options_t* input_options
+);
+
+
+/*
+ * Function:                run_qaoa
+ * --------------------
+ * Description:             Executes a single QAOA run on the prepared instance with the hyperparameters held by the
+ *                          context: it prepares the initial state, optimizes the angles, evaluates the
+ *                          optimized state and exports its results into the storage directory of the run. The angle
+ *                          optimization is checkpointed there until the results are exported, see open_checkpoint.
+ * Parameters:
+ *      ctx:                Pointer to the QAOA context.
+ *      instance:           Pointer to the name of the instance.
+ *      int_greedy_sol_val: Integer Greedy solution value.
+ *      optimal_sol_val:    Optimal solution value.
+ *      start_angles:       Pointer to angles from which only a local optimization is started; NULL for the usual fine-
+ *                          grid search followed by local optimization.
+ * Returns:                 Pointer to the optimized angles.
+ * Side Effect:             Frees the variables allocated for the run via free_run_variables.
+ *                          Allocates the returned angles dynamically.
+ */
+double* run_qaoa(qaoa_context_t* ctx, const char* instance, num_t int_greedy_sol_val, num_t optimal_sol_val,
+                 const double* start_angles);
+
+
+/*
+ * Function:                export_resource_counts
+ * --------------------
+ * Description:             Counts the resources required by the chosen QAOA method and exports them.
+ * Parameters:
+ *      ctx:                Pointer to the QAOA context.
+ *      instance:           Pointer to the name of the instance.
+ */
+void export_resource_counts(qaoa_context_t* ctx, const char* instance);
+
+
 /*
  * Function:                qaoa
  * --------------------
  * Description:             This is the main function for executing the QTG-induced or Copula-based QAOA, depending on
- *                          the input QAOA type. It wraps up all other functions defined in this file. First, it updates
- *                          all the global variables, i.e. the underlying knapsack, the QAOA type, the depth, the bias
- *                          and the hyperparameter k of the probability distribution neeeded in the Copula approach.
- *                          Then, it sorts the input knapsack by the relative profit of each item (i.e. the
- *                          profit divided by the weight). Depending on the context, it computes an integer greedy
- *                          solution for the given knapsack instance, which is needed for the application of the QTG.
- *                          The resulting lower bound is used in the following initial application of the QTG
- *                          for biasing. Then, the chosen classical optimizing routine minimizes the function
+ *                          the QAOA type of the preparation. The preparation holds the knapsack sorted by the relative
+ *                          profit of each item (i.e. the profit divided by the weight), its integer greedy solution,
+ *                          which is used for biasing the QTG, the states of the QTG or the tables of the Copula QAOA,
+ *                          and the optimal solution computed once by combo, which transforms the not
+ *                          instance-agnostic profits to approximation ratios. On top of it, a context is set up with
+ *                          the depth and the hyperparameter k of the probability distribution neeeded in the Copula
+ *                          approach. Then, the chosen classical optimizing routine minimizes the function
  *                          angles_to_value. The negative optimization result is the solution of the QAOA. For creating
  *                          expressive graphics, the quasi-adiabatic evolution must be run a last time with the optimal
- *                          angle values as input. In order to transform the not instance-agnostic profits in the
- *                          probability dictionary to approximation ratios, combo is executed once to compute the
- *                          optimal solution of the given knapsack instance. Both the final angle state and the exact
- *                          solution are passed to the function write_plot_data_to_file which exports the needed data to
- *                          an external file. Ultimately, the resources required to run the routine are counted.
+ *                          angle values as input, and the final angle state is exported together with the exact
+ *                          solution. Ultimately, the resources required to run the routine are counted.
  * Parameters:
  *      instance:           Pointer to the name of the instance.
- *      input_kp:           Pointer to the knapsack on which the QAOA is to be applied.
- *      input_qaoa_type:    The type of the QAOA, i.e. QTG or Copula.
+ *      prepared:           Pointer to the preparation of the instance, see prepare_instance_context.
  *      input_depth:        The depth of the QAOA.
  *      opt_type:           The classical method that shall be used for the optimization.
- *      input_bias:         The bias for the QTG.
+ *      input_m:            Number of grid points per angle in the initial grid search.
  *      copula_k:           The hyperparameter k for the probability distribution in the Copula ansatz.
  *      copula_theta:       The hyperparameter theta for the two-qubit Copula unitaries.
- * Returns:                 The negative solution value obtained from inserting the optimized angles returned by the
- *                          classical optimization routine, i.e. a positive result to the given knapsack problem.
- * Side Effect:             Frees the memory allocated in path_rep for the integer greedy solution.
- *                          Frees the memory allocated in qtg for its output nodes.
- *                          Frees the memory allocated in quasiadiabatic_evolution for the final QAOA state obtained
+ *      input_memory_size:  Memory size for the classical optimizer; only needed in case of BFGS.
+ *      options:            Pointer to the optional settings of the run.
+ * Side Effect:             Frees the memory allocated in quasiadiabatic_evolution for the final QAOA state obtained
  *                          from inserting the optimized angles.
  */
 void qaoa(
     const char* instance,
-    knapsack_t* input_kp,
-    qaoa_type_t input_qaoa_type,
+    instance_context_t* prepared,
     int input_depth,
     opt_t input_opt_type,
     int input_m,
-    size_t input_bias,
     double copula_k,
     double copula_theta,
     int input_memory_size,
-    knapsack_type_t kp_type
+    const run_options_t* options
+);
+
+
+/*
+ * Function:                copula_sweep
+ * --------------------
+ * Description:             Runs the Copula QAOA for every combination of the given values of the hyperparameters k
+ *                          and theta on a shared preparation. The combinations are run by up to
+ *                          options->num_workers worker processes that share its tables, or one after another
+ *                          where workers are not supported. The results of each combination are exported into the
+ *                          subdirectory k_<k>_theta_<theta> of the usual storage directory.
+ * Parameters:
+ *      instance:           Pointer to the name of the instance.
+ *      prepared:           Pointer to the preparation of the instance for the Copula QAOA.
+ *      input_depth:        The depth of the QAOA.
+ *      opt_type:           The classical method that shall be used for the optimization.
+ *      input_m:            Number of grid points per angle in the initial grid search.
+ *      copula_ks:          Pointer to the values of the hyperparameter k.
+ *      num_ks:             Number of values of k.
+ *      copula_thetas:      Pointer to the values of the hyperparameter theta.
+ *      num_thetas:         Number of values of theta.
+ *      input_memory_size:  Memory size for the classical optimizer; only needed in case of BFGS.
+ *      options:            Pointer to the optional settings of the runs.
+ */
+void copula_sweep(
+    const char* instance,
+    instance_context_t* prepared,
+    int input_depth,
+    opt_t input_opt_type,
+    int input_m,
+    const double* copula_ks,
+    int num_ks,
+    const double* copula_thetas,
+    int num_thetas,
+    int input_memory_size,
+    const run_options_t* options
+);
+
+
+/*
+ * Function:                depth_sweep
+ * --------------------
+ * Description:             Runs the QAOA for every depth from min_depth to max_depth on a shared preparation. The lowest depth is optimized as usual; every further depth starts a local
+ *                          optimization from the optimized angles of the previous depth, extended by
+ *                          interpolate_angles, and skips the fine-grid search. Results and resource counts are exported
+ *                          into the usual directory of each depth.
+ * Parameters:
+ *      instance:           Pointer to the name of the instance.
+ *      prepared:           Pointer to the preparation of the instance, see prepare_instance_context.
+ *      min_depth:          The lowest depth of the QAOA.
+ *      max_depth:          The highest depth of the QAOA.
+ *      opt_type:           The classical method that shall be used for the optimization.
+ *      input_m:            Number of grid points per angle in the fine-grid search of the lowest depth.
+ *      copula_k:           The hyperparameter k for the probability distribution in the Copula ansatz.
+ *      copula_theta:       The hyperparameter theta for the two-qubit Copula unitaries.
+ *      input_memory_size:  Memory size for the classical optimizer; only needed in case of BFGS.
+ *      options:            Pointer to the optional settings of the runs.
+ */
+void depth_sweep(
+    const char* instance,
+    instance_context_t* prepared,
+    int min_depth,
+    int max_depth,
+    opt_t input_opt_type,
+    int input_m,
+    double copula_k,
+    double copula_theta,
+    int input_memory_size,
+    const run_options_t* options
+);
+
+
+/*
+ * =============================================================================
+ *                                  Landscape
+ * =============================================================================
+ */
+
+/*
+ * Function:                scan_landscape
+ * --------------------
+ * Description:             Evaluates the expectation value on a dense grid over one pair of angles, gamma in
+ *                          [0,gamma_period) and beta in [0,2pi), while all other angles are fixed. Chunks of
+ *                          LANDSCAPE_CHUNK_POINTS grid points are evaluated in parallel by evaluate_angle_batch and
+ *                          streamed to landscape_layer_<layer + 1>.bin in the directory of the depth (see
+ *                          landscape_header_t), and optionally every csv_stride-th row and column also to
+ *                          landscape_layer_<layer + 1>.csv with the columns gamma, beta and value. The budgets of
+ *                          the options do not apply.
+ * Parameters:
+ *      instance:           Pointer to the name of the instance.
+ *      input_kp:           Pointer to the knapsack on which the QAOA is to be applied.
+ *      input_qaoa_type:    The type of the QAOA, i.e. QTG or Copula.
+ *      input_depth:        The depth of the QAOA.
+ *      layer:              The layer whose angles are scanned, counted from 0.
+ *      resolution:         Number of grid points per angle.
+ *      input_bias:         The bias for the QTG.
+ *      copula_k:           The hyperparameter k for the probability distribution in the Copula ansatz.
+ *      copula_theta:       The hyperparameter theta for the two-qubit Copula unitaries.
+ *      kp_type:            Whether the knapsack instance is linear or quadratic.
+ *      options:            Pointer to the optional settings of the run.
+ *      fixed_angles:       Pointer to 2 * input_depth angles; those of the scanned layer are ignored.
+ *      csv_stride:         Stride of the downsampled CSV file; 0 for none.
+ */
+void scan_landscape(
+    const char* instance,
+    knapsack_t* input_kp,
+    qaoa_type_t input_qaoa_type,
+    int input_depth,
+    int layer,
+    int resolution,
+    size_t input_bias,
+    double copula_k,
+    double copula_theta,
+    knapsack_type_t kp_type,
+    const run_options_t* options,
+    const double* fixed_angles,
+    int csv_stride
 );
 
 
 
+/*
+ * =============================================================================
+ *                             Resource estimation
+ * =============================================================================
+ */
+
+/*
+ * Function:            measure_flop_rate
+ * --------------------
+ * Description:         Measures how many floating-point operations a single thread performs per second on complex
+ *                      multiplications of a state vector that fits into the cache. Large states are bound by the
+ *                      memory bandwidth instead, so the rate is optimistic for them.
+ * Returns:             The floating-point operations per second.
+ */
+double measure_flop_rate();
+
+
+/*
+ * Function:            estimate_run
+ * --------------------
+ * Description:         Projects the resources of a QAOA run without allocating any states. For the QTG QAOA, the
+ *                      states are counted by qtg_layer_sizes; for the Copula QAOA, they are 2^n. The evaluations
+ *                      comprise the grid search chosen by the options and ESTIMATE_LOCAL_EVALS evaluations of the
+ *                      local optimizer per angle and start, capped by the evaluation budget.
+ * Parameters:
+ *      kp:             Pointer to the knapsack.
+ *      qaoa_type:      The type of the QAOA, i.e. QTG or Copula.
+ *      kp_type:        Whether the knapsack instance is linear or quadratic.
+ *      depth:          The depth of the QAOA.
+ *      m:              Grid resolution per angle.
+ *      options:        Pointer to the run options.
+ *      num_threads:    Number of threads the run may use.
+ *      flop_rate:      Floating-point operations per second of a single thread, see measure_flop_rate.
+ * Returns:             The estimate.
+ */
+estimate_t estimate_run(
+    const knapsack_t* kp,
+    qaoa_type_t qaoa_type,
+    knapsack_type_t kp_type,
+    int depth,
+    int m,
+    const run_options_t* options,
+    int num_threads,
+    double flop_rate
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,236 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+
+/*
+ * =============================================================================
+ *                                includes
+ * =============================================================================
+ */
+
+#include "knapsack.h"
+
+
+/*
+ * =============================================================================
+ *                                C++ check
+ * =============================================================================
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define RESULT_TAG          "@result" // First field of every record of a results log
+#define RESULT_MAX_LINE     4096 // Maximal length of a record of a results log
+#define RESULT_UNKNOWN      "?" // Value of a hyperparameter that is not known, e.g. m of an imported run
+
+
+/*
+ * =============================================================================
+ *                              Type definitions
+ * =============================================================================
+ */
+
+/*
+ * Struct:              result_key_t
+ * ---------------------------
+ * Description:         Identity of a QAOA run in a results log.
+ * Contents:
+ *      instance:       Name of the instance.
+ *      qaoa_type:      Name of the QAOA type as in the results tree, i.e. "qtg", "copula" or "copula-mps".
+ *      depth:          Depth of the QAOA.
+ *      optimizer:      Name of the local optimizer as in the results tree.
+ *      params:         Further hyperparameters in the canonical form of format_result_params, e.g. "m=10 bias=2
+ *                      k=10 theta=-1", or "m=? bias=? k=? theta=?" for an imported run.
+ */
+typedef struct result_key {
+    char instance[256];
+    char qaoa_type[16];
+    int depth;
+    char optimizer[16];
+    char params[256];
+} result_key_t;
+
+
+/*
+ * Struct:              result_record_t
+ * ---------------------------
+ * Description:         One record of a results log, i.e. the outcome of a QAOA run.
+ * Contents:
+ *      key:            Identity of the run.
+ *      num_states:     Number of simulated states.
+ *      optimal_sol_val: Optimal solution value.
+ *      greedy_ratio:   Approximation ratio of integer Greedy.
+ *      approx_ratio:   Total approximation ratio of the QAOA.
+ *      prob_beating_greedy: Probability of measuring a feasible state that beats integer Greedy.
+ *      num_evals:      Number of evaluations of the angle optimization; 0 if unknown.
+ *      elapsed:        Wall-clock seconds of the angle optimization; 0 if unknown.
+ */
+typedef struct result_record {
+    result_key_t key;
+    uint64_t num_states;
+    num_t optimal_sol_val;
+    double greedy_ratio;
+    double approx_ratio;
+    double prob_beating_greedy;
+    uint64_t num_evals;
+    double elapsed;
+} result_record_t;
+
+
+/*
+ * Struct:              results_index_t
+ * ---------------------------
+ * Description:         Hash index of the latest record of every key of a results log, built by a single pass over
+ *                      the log. Collisions are resolved by linear probing, and the table is kept at most half full.
+ * Contents:
+ *      records:        Latest record per key, in the order in which the keys first appear.
+ *      num_records:    Number of distinct keys.
+ *      capacity:       Number of records memory is allocated for.
+ *      slots:          Per slot, 1 + the index of a record; 0 if the slot is free.
+ *      num_slots:      Number of slots, a power of two.
+ *      num_superseded: Number of records replaced by a later record of the same key.
+ *      num_damaged:    Number of lines that are no valid record, e.g. torn by a crash during a write.
+ */
+typedef struct results_index {
+    result_record_t* records;
+    size_t num_records;
+    size_t capacity;
+    size_t* slots;
+    size_t num_slots;
+    size_t num_superseded;
+    size_t num_damaged;
+} results_index_t;
+
+
+/*
+ * =============================================================================
+ *                                  Records
+ * =============================================================================
+ */
+
+/*
+ * Function:            format_result_params
+ * --------------------
+ * Description:         Writes the hyperparameters of a key in canonical form, "m=<m> bias=<bias> k=<k> theta=<theta>"
+ *                      followed by further options, with RESULT_UNKNOWN for every value that is not known. Live and
+ *                      imported records are keyed by it alike.
+ * Parameters:
+ *      params:         Pointer to the parameters of a key; will be set.
+ *      m:              Grid resolution; negative if unknown.
+ *      bias:           Bias of the QTG; negative if unknown.
+ *      k:              Parameter k of the Copula mixer; NAN if unknown.
+ *      theta:          Parameter theta of the Copula mixer; NAN if unknown.
+ *      options:        Pointer to further space-separated "key=value" pairs; empty if there are none.
+ */
+void format_result_params(char params[256], int m, long long bias, double k, double theta, const char* options);
+
+
+/*
+ * Function:            append_result
+ * --------------------
+ * Description:         Appends a record to a results log as a single line of tab-separated fields, starting with
+ *                      RESULT_TAG and ending with the 64-bit FNV-1a checksum of all preceding characters in hex. The
+ *                      line is written by a single append, so that records of concurrent writers, e.g. parallel
+ *                      jobs, never interleave; a record torn by a crash fails its checksum and is skipped.
+ * Parameters:
+ *      path:           Pointer to the path of the log; it is created if needed.
+ *      record:         Pointer to the record.
+ * Returns:             Whether the record was written entirely.
+ */
+bool_t append_result(const char* path, const result_record_t* record);
+
+
+/*
+ * Function:            parse_result
+ * --------------------
+ * Description:         Parses a line of a results log and verifies its checksum. If a torn record has been
+ *                      continued by the next one on the same line, the last complete record of the line is taken.
+ * Parameters:
+ *      line:           Pointer to the line, with or without the line break; not modified.
+ *      record:         Pointer to the record; will be set.
+ * Returns:             Whether the line holds a valid record.
+ */
+bool_t parse_result(const char* line, result_record_t* record);
+
+
+/*
+ * =============================================================================
+ *                                   Index
+ * =============================================================================
+ */
+
+/*
+ * Function:            load_results_index
+ * --------------------
+ * Description:         Reads a results log and indexes its latest record per key. Damaged lines are counted and
+ *                      skipped. A record of a live run supersedes an earlier imported record of the same run, i.e.
+ *                      one whose known hyperparameters agree with it.
+ * Parameters:
+ *      path:           Pointer to the path of the log.
+ *      index:          Pointer to the index; will be set.
+ * Returns:             Whether the log could be read.
+ * Side Effect:         Allocates the index dynamically; it should eventually be freed via free_results_index.
+ */
+bool_t load_results_index(const char* path, results_index_t* index);
+
+
+/*
+ * Function:            lookup_result
+ * --------------------
+ * Description:         Finds the latest record of a key in constant expected time. If the key has none, the record
+ *                      an import of the results tree would have written for the same run is returned, i.e. the one
+ *                      with only k and theta known, or else the one with no hyperparameter known.
+ * Parameters:
+ *      index:          Pointer to the index.
+ *      key:            Pointer to the key.
+ * Returns:             Pointer to the record within the index; NULL if the key has no record.
+ */
+const result_record_t* lookup_result(const results_index_t* index, const result_key_t* key);
+
+
+/*
+ * Function:            free_results_index
+ * --------------------
+ * Description:         Frees the records and slots of an index.
+ * Parameters:
+ *      index:          Pointer to the index.
+ */
+void free_results_index(results_index_t* index);
+
+
+/*
+ * =============================================================================
+ *                                   Import
+ * =============================================================================
+ */
+
+/*
+ * Function:            import_results_tree
+ * --------------------
+ * Description:         Appends a record for every results.txt of a results tree of the form
+ *                      <instance>/<qaoa type>/p_<depth>/<optimizer>/[k_<k>_theta_<theta>/]results.txt to a results
+ *                      log, with the evaluations and seconds of the summary.txt next to it if there is one. The
+ *                      label of a Copula sweep gives k and theta; the other hyperparameters are not known from the
+ *                      tree and are RESULT_UNKNOWN. Runs that the log already holds a record of are skipped.
+ * Parameters:
+ *      root:           Pointer to the path of the tree, e.g. the instances directory.
+ *      path:           Pointer to the path of the log.
+ * Returns:             The number of imported records, or -1 if the tree cannot be read or a record not written.
+ */
+int64_t import_results_tree(const char* root, const char* path);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RESULTS_H
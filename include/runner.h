@@ -0,0 +1,252 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+
+/*
+ * =============================================================================
+ *                                includes
+ * =============================================================================
+ */
+
+#include "knapsack.h"
+#include "qaoa.h"
+
+
+/*
+ * =============================================================================
+ *                                C++ check
+ * =============================================================================
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define MAX_SWEEP_VALUES    64 // Maximal number of values of k or theta in one benchmark line
+
+
+/*
+ * =============================================================================
+ *                              Type definitions
+ * =============================================================================
+ */
+
+/*
+ * Struct:              job_t
+ * ---------------------------
+ * Description:         One line of a benchmark file, i.e. a single QAOA run, a depth sweep or a Copula sweep, together
+ *                      with the estimate of its resources by which it is scheduled.
+ * Contents:
+ *      line:           Number of the line in the benchmark file, counted from 1.
+ *      instance:       Name of the instance.
+ *      qaoa_type:      Type of the QAOA.
+ *      min_depth:      Depth of the QAOA, or the first depth of a depth sweep.
+ *      max_depth:      Last depth of a depth sweep; equal to min_depth otherwise.
+ *      opt_type:       Local optimizer.
+ *      m:              Grid resolution per angle.
+ *      bias:           Bias of the QTG.
+ *      ks:             Values of k of a Copula sweep; only the first is used otherwise.
+ *      num_ks:         Number of values of k.
+ *      thetas:         Values of theta of a Copula sweep; only the first is used otherwise.
+ *      num_thetas:     Number of values of theta.
+ *      memory_size:    Memory size of the local optimizer.
+ *      kp_type:        Linear or quadratic objective function.
+ *      options:        Run options.
+ *      estimate:       Estimated resources of the job: the states and the evaluation cost of its largest run, the
+ *                      peak memory of all its concurrent runs and the time and evaluations of all its runs.
+ */
+typedef struct job {
+    int line;
+    char instance[1024];
+    qaoa_type_t qaoa_type;
+    int min_depth;
+    int max_depth;
+    opt_t opt_type;
+    int m;
+    size_t bias;
+    double ks[MAX_SWEEP_VALUES];
+    int num_ks;
+    double thetas[MAX_SWEEP_VALUES];
+    int num_thetas;
+    int memory_size;
+    knapsack_type_t kp_type;
+    run_options_t options;
+    estimate_t estimate;
+} job_t;
+
+
+/*
+ * =============================================================================
+ *                                   Jobs
+ * =============================================================================
+ */
+
+/*
+ * Function:            parse_kp_type
+ * --------------------
+ * Description:         Parses the name of an objective function, i.e. "linear" or "quadratic".
+ * Parameters:
+ *      name:           Pointer to the name.
+ *      kp_type:        Pointer to the objective function; will be set if the name is valid.
+ * Returns:             Whether the name is valid.
+ */
+bool_t parse_kp_type(const char* name, knapsack_type_t* kp_type);
+
+
+/*
+ * Function:            parse_job
+ * --------------------
+ * Description:         Parses a benchmark line of the form
+ *                      "instance qaoa p optimizer m bias k theta memory_size [key=value ...]", where p may be a range
+ *                      of depths "min-max" and k and theta may be comma-separated lists of values. The token
+ *                      kp=linear or kp=quadratic overrides the objective function of the line.
+ * Parameters:
+ *      line:           Pointer to the line; not modified.
+ *      line_number:    Number of the line in the benchmark file, for error messages.
+ *      kp_type:        Linear or quadratic objective function, unless the line overrides it.
+ *      job:            Pointer to the job; will be set.
+ * Returns:             Whether the line is a valid job; an error is printed otherwise.
+ */
+bool_t parse_job(const char* line, int line_number, knapsack_type_t kp_type, job_t* job);
+
+
+/*
+ * Function:            read_jobs
+ * --------------------
+ * Description:         Parses all lines of a benchmark file that are neither empty nor start with '#'.
+ * Parameters:
+ *      path:           Pointer to the path of the benchmark file.
+ *      kp_type:        Linear or quadratic objective function.
+ *      jobs:           Pointer to the array of jobs; will be set.
+ * Returns:             The number of jobs, or -1 if the file cannot be read or contains an invalid line.
+ * Side Effect:         Allocates the jobs dynamically; they should eventually be freed.
+ */
+int read_jobs(const char* path, knapsack_type_t kp_type, job_t** jobs);
+
+
+/*
+ * Function:            load_job_knapsack
+ * --------------------
+ * Description:         Reads the knapsack instance of a job from the instances directory.
+ * Parameters:
+ *      job:            Pointer to the job.
+ *      verbose:        Whether the instance is printed.
+ * Returns:             Pointer to the knapsack; NULL if it cannot be read.
+ * Side Effect:         Allocates dynamically; should eventually be freed via free_knapsack.
+ */
+knapsack_t* load_job_knapsack(const job_t* job, bool_t verbose);
+
+
+/*
+ * Function:            estimate_job
+ * --------------------
+ * Description:         Estimates the resources of a job by estimate_run for each of its depths and, in a Copula
+ *                      sweep, for each of its combinations of k and theta.
+ * Parameters:
+ *      job:            Pointer to the job; its estimate will be set.
+ *      kp:             Pointer to the knapsack of the job.
+ *      num_threads:    Number of threads the job runs with.
+ *      flop_rate:      Floating-point operations per second of a single thread, see measure_flop_rate.
+ */
+void estimate_job(job_t* job, const knapsack_t* kp, int num_threads, double flop_rate);
+
+
+/*
+ * Function:            print_estimates
+ * --------------------
+ * Description:         Estimates all jobs of a benchmark file and prints their states, memory, floating-point
+ *                      operations per evaluation, evaluations and time as a table, without running any of them.
+ * Parameters:
+ *      jobs:           Pointer to the jobs; their estimates will be set.
+ *      num_jobs:       Number of jobs.
+ *      max_workers:    Number of concurrent jobs the processors are shared among; 0 for one per online processor.
+ * Returns:             Whether all instances could be read.
+ */
+bool_t print_estimates(job_t* jobs, int num_jobs, int max_workers);
+
+
+/*
+ * Function:            prepare_job
+ * --------------------
+ * Description:         Loads the instance of a job and prepares it via prepare_instance_context.
+ * Parameters:
+ *      job:            Pointer to the job.
+ * Returns:             Pointer to the preparation; NULL if the instance cannot be read or does not fit the options.
+ * Side Effect:         Allocates dynamically; should eventually be released via release_instance_context.
+ */
+instance_context_t* prepare_job(const job_t* job);
+
+
+/*
+ * Function:            same_preparation
+ * --------------------
+ * Description:         Tells whether two jobs can share the preparation of their instance, i.e. whether they only
+ *                      differ in the depth, the optimizer, the grid resolution, k, theta or options other than the
+ *                      backend.
+ * Parameters:
+ *      first:          Pointer to the first job.
+ *      second:         Pointer to the second job.
+ * Returns:             Whether the preparation of either job fits the other.
+ */
+bool_t same_preparation(const job_t* first, const job_t* second);
+
+
+/*
+ * Function:            run_job
+ * --------------------
+ * Description:         Prints the input parameters of a job and executes it via qaoa, depth_sweep or copula_sweep
+ *                      on the preparation of its instance.
+ * Parameters:
+ *      job:            Pointer to the job.
+ *      prepared:       Pointer to the preparation of the instance of the job; NULL if it failed.
+ * Returns:             Whether the instance was prepared.
+ */
+bool_t run_job(const job_t* job, instance_context_t* prepared);
+
+
+/*
+ * =============================================================================
+ *                                 Scheduling
+ * =============================================================================
+ */
+
+/*
+ * Function:            run_jobs
+ * --------------------
+ * Description:         Executes all jobs of a benchmark file. Jobs on the same instance that only differ in the depth,
+ *                      the optimizer, the grid resolution, k or theta share a single preparation of the instance, which
+ *                      is released once the last of them has started. With a single worker, they run one after the
+ *                      other in the order of the file; consecutive single QTG runs on at most BATCH_MAX_STATES states
+ *                      with the same depth and grid resolution, the uniform grid search from scratch and one start
+ *                      search their grids in lockstep, see batch_grid_search. Otherwise, every job runs in a worker
+ *                      process of its own with its share of the processors and its output written to a log file. The
+ *                      jobs are started in the order of decreasing estimated run time, whenever a worker is free and
+ *                      the estimated peak memory of all running jobs and of the preparations held by the parent stays
+ *                      below the limit; a job that exceeds the limit on its own runs alone. The only job of a group
+ *                      prepares its instance in its worker. The parent prepares the groups of several jobs, which its
+ *                      workers inherit, and releases such a preparation while none of the pending jobs of its group
+ *                      fits, to rebuild it once one does.
+ * Parameters:
+ *      jobs:           Pointer to the jobs; they are reordered.
+ *      num_jobs:       Number of jobs.
+ *      max_workers:    Maximal number of concurrent jobs; 0 uses one per online processor.
+ *      max_memory:     Limit of the estimated peak memory of all running jobs in bytes; 0 uses RUNNER_MEMORY_SHARE
+ *                      of the physical memory.
+ *      log_dir:        Pointer to the directory of the log files, ending with a path separator.
+ * Returns:             The number of failed jobs.
+ */
+int run_jobs(job_t* jobs, int num_jobs, int max_workers, uint64_t max_memory, const char* log_dir);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //RUNNER_H
@@ -0,0 +1,136 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+
+/*
+ * =============================================================================
+ *                                includes
+ * =============================================================================
+ */
+
+#include "runner.h"
+
+
+/*
+ * =============================================================================
+ *                                C++ check
+ * =============================================================================
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * =============================================================================
+ *                              Type definitions
+ * =============================================================================
+ */
+
+/*
+ * Struct:              cache_entry_t
+ * ---------------------------
+ * Description:         A prepared instance kept by the server.
+ * Contents:
+ *      key:            The job the instance was prepared for; see same_preparation.
+ *      prepared:       Pointer to the preparation; the cache holds one reference to it.
+ *      bytes:          Memory held by the preparation, see instance_context_bytes.
+ *      last_use:       Value of the clock of the cache when the entry was last used.
+ */
+typedef struct cache_entry {
+    job_t key;
+    instance_context_t* prepared;
+    double bytes;
+    uint64_t last_use;
+} cache_entry_t;
+
+
+/*
+ * Struct:              instance_cache_t
+ * ---------------------------
+ * Description:         Least-recently-used cache of prepared instances whose total memory is bounded. An entry is
+ *                      only evicted if a new preparation does not fit; a single preparation beyond the bound is kept
+ *                      until the next one.
+ * Contents:
+ *      entries:        Pointer to the entries.
+ *      num_entries:    Number of entries.
+ *      capacity:       Number of entries memory is allocated for.
+ *      used_bytes:     Total memory of the entries.
+ *      max_bytes:      Bound of the total memory of the entries.
+ *      clock:          Number of lookups so far, which orders the entries by their last use.
+ *      hits:           Number of lookups that found a preparation.
+ *      misses:         Number of lookups that prepared the instance.
+ */
+typedef struct instance_cache {
+    cache_entry_t* entries;
+    int num_entries;
+    int capacity;
+    double used_bytes;
+    double max_bytes;
+    uint64_t clock;
+    size_t hits;
+    size_t misses;
+} instance_cache_t;
+
+
+/*
+ * =============================================================================
+ *                                Instance cache
+ * =============================================================================
+ */
+
+/*
+ * Function:            acquire_cached_instance
+ * --------------------
+ * Description:         Looks up the preparation of the instance of a job and prepares it on a miss, evicting the
+ *                      least recently used entries until it fits into the bound of the cache.
+ * Parameters:
+ *      cache:          Pointer to the cache.
+ *      job:            Pointer to the job.
+ * Returns:             Pointer to the preparation, retained for the caller; NULL if it cannot be prepared.
+ */
+instance_context_t* acquire_cached_instance(instance_cache_t* cache, const job_t* job);
+
+
+/*
+ * Function:            free_instance_cache
+ * --------------------
+ * Description:         Releases all entries of a cache.
+ * Parameters:
+ *      cache:          Pointer to the cache.
+ */
+void free_instance_cache(instance_cache_t* cache);
+
+
+/*
+ * =============================================================================
+ *                                   Server
+ * =============================================================================
+ */
+
+/*
+ * Function:            serve
+ * --------------------
+ * Description:         Runs a job server on a local socket. Clients connect one after another and send benchmark
+ *                      lines, each of which is executed in a worker process on the cached preparation of its instance
+ *                      while its output is streamed back, followed by a line "@done <line> ok" or
+ *                      "@done <line> error". The line "stats" is answered by "@stats" with the state of the cache,
+ *                      and "shutdown" stops the server. Empty lines and lines starting with '#' are ignored.
+ * Parameters:
+ *      path:           Pointer to the path of the socket.
+ *      kp_type:        Linear or quadratic objective function of all jobs that do not override it by kp=.
+ *      results_log:    Pointer to the path of the results log every job appends its record to; empty for none.
+ *      max_bytes:      Bound of the memory of the cached preparations in bytes; 0 uses SERVER_MEMORY_SHARE of the
+ *                      physical memory.
+ * Returns:             Whether the server stopped on request, i.e. FALSE if the socket could not be created or a
+ *                      client could not be accepted.
+ */
+bool_t serve(const char* path, knapsack_type_t kp_type, const char* results_log, uint64_t max_bytes);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SERVER_H
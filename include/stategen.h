@@ -110,6 +110,31 @@ double branch_prob(const knapsack_t*, bit_t, size_t, bool_t, array_t);
  */
 node_t* qtg(const knapsack_t*, size_t, array_t, size_t*, knapsack_type_t);
 
+/* 
+ * =============================================================================
+ *                            QTG state count
+ * =============================================================================
+ */
+
+/*
+ * Function:        qtg_layer_sizes
+ * ----------------------------
+ * Description:     This function counts the nodes of every layer of the
+ *                  decision tree that qtg traverses, without generating them,
+ *                  by a dynamic program over the items and the used capacity.
+ *                  The last layer holds the feasible paths, i.e. the states
+ *                  of the QTG.
+ * Parameters:
+ *      parameter1: Pointer to knapsack whose decision tree should be counted.
+ *      parameter2: Maximal number of capacities the dynamic program may
+ *                  distinguish; larger capacities are coarsened.
+ *      parameter3: Array of size + 1 layer sizes; will be set, starting with
+ *                  the root layer.
+ * Returns:         Whether the counts are exact; otherwise they are upper
+ *                  bounds, obtained with coarsened costs.
+ */
+bool_t qtg_layer_sizes(const knapsack_t*, size_t, double[]);
+
 #ifdef __cplusplus
 }
 #endif
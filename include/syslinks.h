@@ -79,6 +79,14 @@ uint8_t create_dir(const char*);
  */
 uint64_t rdtsc();
 
+/*
+ * Function:    wall_time
+ * ----------------------
+ * Description: This function returns a monotonic wall-clock time.
+ * Returns:     Seconds elapsed since an arbitrary but fixed point in time.
+ */
+double wall_time();
+
 /* 
  * =============================================================================
  *                            read meta data
@@ -98,6 +106,183 @@ uint64_t rdtsc();
  */
 void rdmd(const char*, size_t, char*[], uint64_t*, uint64_t*);
 
+/* 
+ * =============================================================================
+ *                            worker processes
+ * =============================================================================
+ */
+
+/*
+ * Function:    num_processors
+ * ---------------------------
+ * Description: This function returns the number of online processors.
+ * Returns:     The number of online processors, at least 1.
+ */
+uint32_t num_processors();
+
+/*
+ * Function:    fork_worker
+ * ------------------------
+ * Description: This function forks the calling process into a worker process
+ *              that shares all memory copy-on-write.
+ * Returns:     0 in the worker, a positive value in the parent and a negative
+ *              value if workers are not supported or forking failed.
+ */
+int64_t fork_worker();
+
+/*
+ * Function:    wait_for_worker
+ * ----------------------------
+ * Description: This function blocks until any worker process has finished.
+ * Returns:     Whether the worker terminated successfully.
+ */
+uint8_t wait_for_worker();
+
+/*
+ * Function:    wait_for_worker_id
+ * -------------------------------
+ * Description: This function blocks until any worker process has finished
+ *              and tells which one it was.
+ * Parameter:   Pointer to whether the worker terminated successfully; will
+ *              be set.
+ * Returns:     The value fork_worker returned in the parent for the worker,
+ *              or a negative value if no worker is left or workers are not
+ *              supported.
+ */
+int64_t wait_for_worker_id(uint8_t*);
+
+/*
+ * Function:    physical_memory
+ * ----------------------------
+ * Description: This function returns the size of the physical memory.
+ * Returns:     The number of bytes of physical memory; 0 if unknown.
+ */
+uint64_t physical_memory();
+
+/* 
+ * =============================================================================
+ *                            local sockets
+ * =============================================================================
+ */
+
+/*
+ * Function:    listen_local
+ * -------------------------
+ * Description: This function creates a local stream socket at the given
+ *              path, replacing a stale one, and listens on it. A file at the
+ *              path that is not a socket is never replaced.
+ * Parameter:   Path of the socket.
+ * Returns:     The socket, or a negative value if it cannot be created, the
+ *              path is taken by another file or local sockets are not
+ *              supported.
+ */
+int64_t listen_local(const char*);
+
+/*
+ * Function:    accept_local
+ * -------------------------
+ * Description: This function blocks until a client connects to a socket
+ *              created by listen_local; interrupted calls are retried.
+ * Parameter:   The listening socket.
+ * Returns:     The connection to the client, or a negative value on failure,
+ *              e.g. when no descriptors are left; retrying is then futile.
+ */
+int64_t accept_local(int64_t);
+
+/*
+ * Function:    close_local
+ * ------------------------
+ * Description: This function closes a socket or a connection.
+ * Parameter:   The socket or connection.
+ */
+void close_local(int64_t);
+
+/*
+ * Function:    local_stream
+ * -------------------------
+ * Description: This function opens a buffered stream on a copy of a
+ *              connection, which is closed together with the stream.
+ * Parameter:   The connection.
+ * Parameter:   Mode of the stream as for fopen.
+ * Returns:     The stream, or NULL on failure.
+ */
+FILE* local_stream(int64_t, const char*);
+
+/*
+ * Function:    redirect_output
+ * ----------------------------
+ * Description: This function flushes the standard output and redirects it
+ *              to a connection until restore_output is called.
+ * Parameter:   The connection.
+ * Returns:     The saved standard output, to be passed to restore_output.
+ */
+int64_t redirect_output(int64_t);
+
+/*
+ * Function:    restore_output
+ * ---------------------------
+ * Description: This function flushes the redirected standard output and
+ *              restores the one saved by redirect_output.
+ * Parameter:   The saved standard output.
+ */
+void restore_output(int64_t);
+
+/* 
+ * =============================================================================
+ *                            shared files
+ * =============================================================================
+ */
+
+/*
+ * Function:    append_file
+ * ------------------------
+ * Description: This function appends data to a file, which is created if
+ *              needed, by a single write in append mode, so that the data of
+ *              concurrent writers never interleaves.
+ * Parameter:   Path of the file.
+ * Parameter:   Pointer to the data.
+ * Parameter:   Number of bytes of the data.
+ * Returns:     1 if all of the data was written, 0 otherwise.
+ */
+uint8_t append_file(const char*, const char*, size_t);
+
+/*
+ * Function:    seek_file
+ * ----------------------
+ * Description: This function moves the position of a stream to an offset
+ *              from the start of its file, which may exceed the range of
+ *              long, e.g. beyond 2 GiB on Windows.
+ * Parameter:   Pointer to the stream.
+ * Parameter:   Offset in bytes.
+ * Returns:     1 if the position was moved, 0 otherwise.
+ */
+uint8_t seek_file(FILE*, uint64_t);
+
+/*
+ * Function:    tell_file
+ * ----------------------
+ * Description: This function determines the position of a stream as an
+ *              offset from the start of its file, which may exceed the range
+ *              of long.
+ * Parameter:   Pointer to the stream.
+ * Returns:     The offset in bytes, or a negative value on error.
+ */
+int64_t tell_file(FILE*);
+
+/*
+ * Function:    list_dir
+ * ---------------------
+ * Description: This function lists the names of the entries of a directory
+ *              other than "." and "..", in no particular order.
+ * Parameter:   Path of the directory.
+ * Parameter:   Pointer to the array of names; will be set. The names and
+ *              the array are allocated dynamically and should eventually be
+ *              freed.
+ * Returns:     The number of names, or a negative value if the directory
+ *              cannot be read.
+ */
+int64_t list_dir(const char*, char***);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include "knapsack.h"
+#include "qaoa.h"
+#include "stategen.h"
+
+#define MAX_DEPTH 64
+
+int main(int argc, const char **argv) {
+
+    int p, layer, resolution, bias;
+    double k, theta;
+    char instance[256];
+    char input_qaoa_type[16];
+    char line[4096];
+    int num_consumed;
+    int line_number = 0;
+
+    if (argc < 2) {
+        printf("Usage: %s <benchmark name>\n", argv[0]);
+        return -1;
+    }
+    const char *benchmark_instance = argv[1];
+    char *path_to_benchmark = calloc(1024, sizeof(char));
+    snprintf(path_to_benchmark, 1024, "../benchmark_instances/%s.txt", benchmark_instance);
+    FILE *file = fopen(path_to_benchmark, "r");
+    if (file == NULL) {
+        printf("Error: Could not open %s.", path_to_benchmark);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file)) { // all the instances will be considered
+        ++line_number;
+        if (line[0] != '#' && strspn(line, " \t\r\n") < strlen(line)) { // '#' and blank lines are ignored
+            num_consumed = 0;
+            if (sscanf(
+                line,
+                "%255s %15s %d %d %d %d %lf %lf%n",
+                instance, input_qaoa_type, &p, &layer, &resolution, &bias, &k, &theta, &num_consumed
+            ) != 8) {
+                printf("Error: Line %d needs the instance, QAOA type, p, layer, grid size, bias, k and theta.",
+                       line_number);
+                return -1;
+            }
+            printf("\n===== Input parameters =====\n");
+
+            printf("QAOA type = %s\n", input_qaoa_type);
+            qaoa_type_t qaoa_type;
+            if (strcmp(input_qaoa_type, "qtg") == 0) {
+                qaoa_type = QTG;
+            } else if (strcmp(input_qaoa_type, "copula") == 0) {
+                qaoa_type = COPULA;
+            } else {
+                printf("Error: Input for QAOA type does not match any of the permitted values.");
+                return -1;
+            }
+
+            printf("p = %d, layer = %d, grid = %d x %d\n", p, layer, resolution, resolution);
+            if (p < 1 || p > MAX_DEPTH || layer < 1 || layer > p || resolution < 1) {
+                printf("Error: Input for p, layer or grid size is out of range.");
+                return -1;
+            }
+
+            // Optional tokens after the mandatory fields: the fixed angles, the CSV stride and the run options
+            double fixed_angles[2 * MAX_DEPTH] = {0};
+            int csv_stride = 0;
+            run_options_t run_options = default_run_options();
+            for (char* token = strtok(line + num_consumed, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+                if (strncmp(token, "angles=", 7) == 0) {
+                    if (parse_value_list(token + 7, fixed_angles, 2 * MAX_DEPTH) != 2 * p) {
+                        printf("Error: angles= needs the 2p angles gamma_1,beta_1,...,gamma_p,beta_p.");
+                        return -1;
+                    }
+                } else if (strncmp(token, "csv=", 4) == 0) {
+                    csv_stride = atoi(token + 4);
+                    if (csv_stride < 1) {
+                        printf("Error: Invalid CSV stride %s.", token + 4);
+                        return -1;
+                    }
+                } else if (!parse_run_option(&run_options, token)) {
+                    printf("Error: Invalid run option %s.", token);
+                    return -1;
+                }
+            }
+
+            knapsack_type_t kp_type;
+            kp_type = QUADRATIC;
+
+            printf("Instance = %s\n", instance);
+            char path_to_instance[1024];
+            knapsack_t* kp;
+            switch (kp_type) {
+                case LINEAR:
+                    snprintf(path_to_instance, sizeof(path_to_instance), "..%cinstances%c%s%ctest.in", path_sep(),
+                             path_sep(), instance, path_sep());
+                    kp = create_jooken_knapsack(path_to_instance);
+                    break;
+                case QUADRATIC:
+                    snprintf(path_to_instance, sizeof(path_to_instance), "..%cinstances%c%s%cquad_knap.txt",
+                             path_sep(), path_sep(), instance, path_sep());
+                    kp = create_quadratic_knapsack(path_to_instance);
+                    break;
+            }
+            if (kp == NULL) {
+                printf("Error: Could not read the instance %s.", path_to_instance);
+                return -1;
+            }
+
+            scan_landscape(
+                instance, kp, qaoa_type, p, layer - 1, resolution, bias, k, theta, kp_type, &run_options,
+                fixed_angles, csv_stride
+            );
+        }
+    }
+    fclose(file);
+    free(path_to_benchmark);
+
+    return 0;
+}
@@ -1,108 +1,92 @@
 #include <stdio.h>
 #include "knapsack.h"
 #include "qaoa.h"
+#include "runner.h"
+#include "server.h"
 #include "stategen.h"
-#include "qaoa.h"
 
 int main(int argc, const char **argv) {
 
-    int p, m, bias, memory_size;
-    double k, theta;
-    char instance[1023];
-    char input_qaoa_type[16], input_opt_type[16];
-    char line[1023];
-
-    const char *benchmark_instance = argv[1];
-    char *path_to_benchmark = calloc(1024, sizeof(char));
-    sprintf(path_to_benchmark, "../benchmark_instances/%s.txt", benchmark_instance);
-    FILE *file = fopen(path_to_benchmark, "r");
-
-    while (fgets(line, sizeof(line), file)) { // all the instances will be considered
-        if (line[0] != '#') { // lines startin with '#' are ignored
-            sscanf(
-                line,
-                "%s %s %d %s %d %d %lf %lf %d\n",
-                instance, input_qaoa_type, &p, input_opt_type, &m, &bias, &k,  &theta, &memory_size
-            );
-            printf("\n===== Input parameters =====\n");
-            
-            knapsack_type_t kp_type;
-            kp_type = QUADRATIC;
-            
-            printf("Instance = %s\n", instance);
-            char path_to_instance[1024];
-            char path_to_instance2[1024];
-            knapsack_t* kp;
-            switch (kp_type) {
-                case LINEAR:
-                    sprintf(path_to_instance, "..%cinstances%c%s%ctest.in", path_sep(), path_sep(), instance, path_sep());
-                    kp = create_jooken_knapsack(path_to_instance);
-                    print_knapsack(kp);
-                    break;
-                case QUADRATIC:
-                    sprintf(path_to_instance2, "..%cinstances%c%s%cquad_knap.txt", path_sep(), path_sep(), instance, path_sep());
-                    sprintf(path_to_instance, "..%cinstances%c%s%c", path_sep(), path_sep(), instance, path_sep());
-                    printf("%s", path_to_instance2);
-                    kp = create_quadratic_knapsack(path_to_instance2);
-//                    apply_quad_int_greedy(kp);
-                    print_quadratic_knapsack(kp);
-                    break;
-            }
+    int max_workers = 1;
+    double max_memory = 0;
+    bool_t estimate_only = FALSE;
+    bool_t resume = FALSE;
+    knapsack_type_t kp_type = QUADRATIC; // Lines may override it by kp=linear
+    const char *socket_path = NULL;
+    const char *benchmark_instance = NULL;
 
-            printf("QAOA type = %s\n", input_qaoa_type);
-            qaoa_type_t qaoa_type;
-            if (strcmp(input_qaoa_type, "qtg") == 0) {
-                qaoa_type = QTG;
-            } else if (strcmp(input_qaoa_type, "copula") == 0) {
-                qaoa_type = COPULA;
-            } else {
-                printf("Error: Input for QAOA type does not match any of the permitted values.");
+    for (int arg = 1; arg < argc; ++arg) { // Jobs run in parallel only on request
+        if (strncmp(argv[arg], "--workers=", 10) == 0) {
+            max_workers = atoi(argv[arg] + 10);
+        } else if (strncmp(argv[arg], "--memory=", 9) == 0) {
+            max_memory = atof(argv[arg] + 9);
+        } else if (strcmp(argv[arg], "--estimate") == 0) {
+            estimate_only = TRUE;
+        } else if (strcmp(argv[arg], "--resume") == 0) {
+            resume = TRUE;
+        } else if (strncmp(argv[arg], "--kp=", 5) == 0) {
+            if (!parse_kp_type(argv[arg] + 5, &kp_type)) {
+                printf("Error: Input for --kp is neither linear nor quadratic.");
                 return -1;
             }
+        } else if (strncmp(argv[arg], "--serve=", 8) == 0) {
+            socket_path = argv[arg] + 8;
+        } else if (strncmp(argv[arg], "--", 2) != 0 && benchmark_instance == NULL) {
+            benchmark_instance = argv[arg];
+        } else {
+            printf("Error: Invalid argument %s.", argv[arg]);
+            return -1;
+        }
+    }
+    if ((benchmark_instance == NULL) == (socket_path == NULL)) {
+        printf("Usage: %s <benchmark> [--kp=linear|quadratic] [--workers=<int>] [--memory=<GiB>] [--estimate] "
+               "[--resume]\n", argv[0]);
+        printf("       %s --serve=<socket> [--kp=linear|quadratic] [--memory=<GiB>]\n", argv[0]);
+        return -1;
+    }
+    if (max_workers < 0 || max_memory < 0) {
+        printf("Error: The number of workers and the memory limit must not be negative.");
+        return -1;
+    }
 
-            printf("p = %d\n", p);
-
-            printf("Optimization type = %s\n", input_opt_type);
-            opt_t opt_type;
-            if (strcmp(input_opt_type, "powell") == 0) {
-                opt_type = POWELL;
-            } else if (strcmp(input_opt_type, "nelder-mead") == 0) {
-                opt_type = NELDER_MEAD;
-            } else if (strcmp(input_opt_type, "bfgs") == 0) {
-                opt_type = BFGS;
-            } else {
-                printf("Error: Input for optimization type does not match any of the permitted values.");
-                return -1;
-            }
-
-            printf("m = %d\n", m);
-
-            switch (qaoa_type) {
-                case QTG:
-                    printf("bias = %d\n", bias);
-                case COPULA:
-                    printf("k = %.1f\n", k);
-                    printf("theta = %.1f\n", theta);
-            }
+    if (socket_path != NULL) { // Keep prepared instances warm across the jobs of any number of clients
+        char results_log[256];
+        snprintf(results_log, sizeof(results_log), "..%cbenchmark_instances%cserver_results.log", path_sep(),
+                 path_sep());
+        return serve(socket_path, kp_type, results_log, (uint64_t) (max_memory * 1073741824.0)) ? 0 : -1;
+    }
 
-            if (opt_type == BFGS) {
-                printf("Memory size for BFGS = %d\n", memory_size);
-            }
+    char path_to_benchmark[1024];
+    sprintf(path_to_benchmark, "..%cbenchmark_instances%c%s.txt", path_sep(), path_sep(), benchmark_instance);
+    job_t* jobs;
+    const int num_jobs = read_jobs(path_to_benchmark, kp_type, &jobs); // all the instances will be considered
+    if (num_jobs < 0) {
+        return -1;
+    }
+    // Every run of the benchmark appends its record to one log, which parallel workers share
+    char results_log[256];
+    snprintf(results_log, sizeof(results_log), "..%cbenchmark_instances%c%s_results.log", path_sep(), path_sep(),
+             benchmark_instance);
+    for (int job = 0; job < num_jobs; ++job) { // Runs without a checkpoint start from scratch anyway
+        jobs[job].options.resume = resume;
+        strcpy(jobs[job].options.results_log, results_log);
+    }
 
-            strcat(path_to_instance, input_qaoa_type);
-            create_dir(path_to_instance);
-            char depth_string[16];
-            sprintf(depth_string, "%cp_%d%c", path_sep(), p, path_sep());
-            strcat(path_to_instance, depth_string);
-            create_dir(path_to_instance);
-            strcat(path_to_instance, input_opt_type);
-            create_dir(path_to_instance);
+    if (estimate_only) { // Report the expected resources without running anything
+        const bool_t success = print_estimates(jobs, num_jobs, max_workers);
+        free(jobs);
+        return success ? 0 : -1;
+    }
 
-            qaoa(instance, kp, qaoa_type, p, opt_type, m, bias, k, theta, memory_size, kp_type);
-        }
+    // Workers write their output to one log file per line of the benchmark
+    char log_dir[1100];
+    sprintf(log_dir, "..%cbenchmark_instances%c%s_logs%c", path_sep(), path_sep(), benchmark_instance, path_sep());
+    if (max_workers != 1) {
+        create_dir(log_dir); // Fails harmlessly if the directory exists
     }
-    fclose(file);
 
-    return 0;
-}
+    const int num_failed = run_jobs(jobs, num_jobs, max_workers, (uint64_t) (max_memory * 1073741824.0), log_dir);
+    free(jobs);
 
+    return num_failed > 0 ? -1 : 0;
+}
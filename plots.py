@@ -1,4 +1,5 @@
 import matplotlib.pyplot as plt
+import numpy as np
 import os
 import pandas as pd
 import seaborn as sns
@@ -138,4 +139,57 @@ for impl in ["qtg", "copula"]:
 # plt.legend()
 # plt.tight_layout()
 # plt.savefig("cycle_counts.pdf")
-# plt.show()
\ No newline at end of file
+# plt.show()
+
+
+# columns of a binary raw-data file, see raw_data_header_t in qaoa.h
+def read_raw_data(path):
+    header = np.dtype([("magic", "S8"), ("version", "<u4"), ("reserved", "<u4"), ("num_states", "<u8"),
+                       ("optimal_sol_val", "<f8")])
+    head = np.fromfile(path, dtype=header, count=1)[0]
+    values = np.fromfile(path, dtype="<f8", offset=header.itemsize, count=2 * int(head["num_states"]))
+    return pd.DataFrame({"ratio": values[:head["num_states"]], "prob": values[head["num_states"]:]})
+
+# latest record per (instance, type, p, optimizer, hyperparameters) of a results log, see append_result in results.h
+def read_results(path):
+    def fnv(data):
+        h = 14695981039346656037
+        for byte in data:
+            h = ((h ^ byte) * 1099511628211) % 2 ** 64
+        return h
+
+    fields = ["num_states", "optimal", "greedy_ratio", "approx", "succ", "evaluations", "elapsed"]
+    results = {}
+    with open(path, "rb") as log:
+        for line in log:
+            # a record torn by a crash is continued by the next one on the same line
+            record = line.rstrip(b"\r\n")
+            record = record[record.rfind(b"@result\t"):]
+            body, _, checksum = record.rpartition(b"\t")
+            parts = body.split(b"\t")
+            if not record.startswith(b"@result\t") or len(parts) != 13 or checksum != b"%016x" % fnv(body + b"\t"):
+                continue
+            key = (parts[1].decode(), parts[2].decode(), int(parts[3]), parts[4].decode(), parts[5].decode())
+            results[key] = dict(zip(fields, [int(parts[6]), int(parts[7])] + [float(x) for x in parts[8:11]]
+                                    + [int(parts[11]), float(parts[12])]))
+    return results
+
+# cumulative distribution of the approximation ratio, as exported into distribution.csv by every run
+def plot_distribution(path, label=None):
+    dist = pd.read_csv(path)
+    plt.step(dist["ratio"], dist["cdf"], where="post", label=label)
+    plt.xlabel("Approximation ratio")
+    plt.ylabel("Cumulative probability")
+
+# plot of a landscape, as exported by the landscape executable with csv=<stride>
+def plot_landscape(path):
+    land = pd.read_csv(path).pivot(index="beta", columns="gamma", values="value")
+    plt.pcolormesh(land.columns, land.index, land.values, shading="nearest")
+    plt.colorbar(label="$\\left< f\\right>$")
+    plt.xlabel("$\\gamma$")
+    plt.ylabel("$\\beta$")
+
+# plot_landscape("instances/qkp4/qtg/p_1/landscape_layer_1.csv")
+# plt.tight_layout()
+# plt.savefig("landscape.pdf")
+# plt.show()
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include "knapsack.h"
+#include "qaoa.h"
+
+int main(int argc, const char **argv) {
+
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <raw_data.bin> [<text file>]\n", argv[0]);
+        return -1;
+    }
+
+    // Without an explicit target, the text goes next to the binary file, where it used to be written
+    char path_to_text[1100];
+    if (argc == 3) {
+        snprintf(path_to_text, sizeof(path_to_text), "%s", argv[2]);
+    } else {
+        snprintf(path_to_text, sizeof(path_to_text), "%s", argv[1]);
+        char *extension = strrchr(path_to_text, '.');
+        if (extension == NULL || strcmp(extension, ".bin") != 0) {
+            printf("Error: %s has no .bin extension; please name the text file explicitly.", argv[1]);
+            return -1;
+        }
+        strcpy(extension, ".txt");
+    }
+
+    FILE *out = strcmp(path_to_text, "-") == 0 ? stdout : fopen(path_to_text, "w");
+    if (out == NULL) {
+        printf("Error: Could not open %s.", path_to_text);
+        return -1;
+    }
+    const bool_t success = convert_raw_data(argv[1], out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    if (!success) {
+        printf("Error: %s is no readable raw-data file.", argv[1]);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+/*
+ * =============================================================================
+ *                            includes
+ * =============================================================================
+ */
+
+#include <math.h>
+#include <string.h>
+#include "angle_db.h"
+#include "syslinks.h"
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define ANGLE_DB_LINE           16384 // Maximal length of an entry, sufficient for depths far beyond those simulated
+#define ANGLE_DB_MIN_RECORDS    64    // Initial capacity of a bucket of the angle index
+
+
+/*
+ * =============================================================================
+ *                                  Index
+ * =============================================================================
+ */
+
+/*
+ * Struct:              angle_bucket_t
+ * ---------------------------
+ * Description:         Entries of the angle database that share their QAOA type, problem type and depth, i.e. those
+ *                      between which angles can be transferred.
+ * Contents:
+ *      qaoa:           Name of the QAOA type.
+ *      quadratic:      Whether the entries belong to quadratic knapsack instances.
+ *      depth:          Depth of the QAOA.
+ *      num_records:    Number of entries.
+ *      capacity:       Number of entries for which there is storage.
+ *      records:        Pointer to the entries.
+ */
+typedef struct angle_bucket {
+    char qaoa[16];
+    int quadratic;
+    int depth;
+    size_t num_records;
+    size_t capacity;
+    angle_record_t* records;
+} angle_bucket_t;
+
+
+/*
+ * Struct:              angle_index_t
+ * ---------------------------
+ * Description:         In-memory index of the angle database file that has been read last. As the file is only ever
+ *                      appended to, the index is kept for the lifetime of the process and extended by the entries
+ *                      appended since the previous lookup.
+ * Contents:
+ *      path:           Pointer to the path of the indexed file, or NULL if none has been indexed yet.
+ *      offset:         Number of bytes of the file that have been indexed, always at the end of a line.
+ *      num_buckets:    Number of buckets.
+ *      buckets:        Pointer to the buckets.
+ */
+typedef struct angle_index {
+    char* path;
+    int64_t offset;
+    size_t num_buckets;
+    angle_bucket_t* buckets;
+} angle_index_t;
+
+
+static angle_index_t angle_index = {NULL, 0, 0, NULL};
+
+
+static void
+clear_angle_index() {
+    for (size_t idx = 0; idx < angle_index.num_buckets; ++idx) {
+        free_angle_records(angle_index.buckets[idx].records, (int) angle_index.buckets[idx].num_records);
+        free(angle_index.buckets[idx].records);
+    }
+    free(angle_index.buckets);
+    free(angle_index.path);
+    angle_index = (angle_index_t) {NULL, 0, 0, NULL};
+}
+
+
+static angle_bucket_t*
+find_bucket(const angle_key_t* key) {
+    for (size_t idx = 0; idx < angle_index.num_buckets; ++idx) {
+        angle_bucket_t* bucket = angle_index.buckets + idx;
+        if (strcmp(bucket->qaoa, key->qaoa) == 0 && bucket->quadratic == key->quadratic
+            && bucket->depth == key->depth) {
+            return bucket;
+        }
+    }
+    return NULL;
+}
+
+
+static void
+index_angle_record(const angle_record_t* record) {
+    angle_bucket_t* bucket = find_bucket(&record->key);
+    if (bucket == NULL) {
+        angle_index.buckets = realloc(angle_index.buckets, (angle_index.num_buckets + 1) * sizeof(angle_bucket_t));
+        bucket = angle_index.buckets + angle_index.num_buckets++;
+        memset(bucket, 0, sizeof(angle_bucket_t));
+        strcpy(bucket->qaoa, record->key.qaoa);
+        bucket->quadratic = record->key.quadratic;
+        bucket->depth = record->key.depth;
+    }
+    if (bucket->num_records == bucket->capacity) {
+        bucket->capacity = bucket->capacity > 0 ? 2 * bucket->capacity : ANGLE_DB_MIN_RECORDS;
+        bucket->records = realloc(bucket->records, bucket->capacity * sizeof(angle_record_t));
+    }
+    bucket->records[bucket->num_records++] = *record;
+}
+
+
+static int
+parse_angle_record(const char* line, angle_record_t* record) {
+    int num_consumed = 0;
+    const int num_read = sscanf(
+        line, "%15s %d %d %d %lf %d %lf %lf%n",
+        record->key.qaoa, &record->key.quadratic, &record->key.depth, &record->key.size,
+        &record->key.capacity_ratio, &record->key.num_groups, &record->key.mean_profit, &record->approx_ratio,
+        &num_consumed
+    );
+    if (num_read != 8 || record->key.qaoa[0] == '#' || record->key.depth <= 0) {
+        return 0; // Malformed or a comment
+    }
+
+    record->angles = malloc(2 * record->key.depth * sizeof(double));
+    const char* pos_in_line = line + num_consumed;
+    for (int j = 0; j < 2 * record->key.depth; ++j) {
+        char* end;
+        record->angles[j] = strtod(pos_in_line, &end);
+        if (end == pos_in_line) {
+            free(record->angles);
+            return 0;
+        }
+        pos_in_line = end;
+    }
+    return 1;
+}
+
+
+/*
+ * Function:            update_angle_index
+ * --------------------
+ * Description:         Indexes the entries of the database file that have been appended since the previous call; the
+ *                      index is rebuilt if the path differs or the file has shrunk, i.e. has been replaced. A trailing
+ *                      line without line break is left for the next call, as its writer may not have finished.
+ * Parameters:
+ *      path:           Pointer to the path of the database file.
+ * Returns:             Whether the file could be read.
+ */
+static int
+update_angle_index(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    if (angle_index.path == NULL || strcmp(angle_index.path, path) != 0 || tell_file(file) < angle_index.offset) {
+        clear_angle_index();
+        angle_index.path = malloc(strlen(path) + 1);
+        strcpy(angle_index.path, path);
+    }
+    seek_file(file, (uint64_t) angle_index.offset);
+
+    char* line = malloc(ANGLE_DB_LINE);
+    while (fgets(line, ANGLE_DB_LINE, file) != NULL) {
+        if (strchr(line, '\n') == NULL) {
+            if (feof(file)) {
+                break; // Unfinished entry
+            }
+            int ch; // Overlong lines are no entries; skip their remainder
+            while ((ch = fgetc(file)) != EOF && ch != '\n') {}
+            if (ch == EOF) {
+                break;
+            }
+        } else {
+            angle_record_t record;
+            if (parse_angle_record(line, &record)) {
+                index_angle_record(&record);
+            }
+        }
+        angle_index.offset = tell_file(file);
+    }
+    free(line);
+    fclose(file);
+    return 1;
+}
+
+
+/*
+ * =============================================================================
+ *                                  Access
+ * =============================================================================
+ */
+
+double
+angle_key_distance(const angle_key_t* key1, const angle_key_t* key2) {
+    if (strcmp(key1->qaoa, key2->qaoa) != 0 || key1->quadratic != key2->quadratic || key1->depth != key2->depth) {
+        return INFINITY;
+    }
+    const double size_diff = fabs((double) (key1->size - key2->size)) / fmax(key1->size, key2->size);
+    const double group_diff = key1->num_groups == 0 || key2->num_groups == 0 ? 0 // Unknown for either key
+        : fabs((double) (key1->num_groups - key2->num_groups)) / fmax(key1->num_groups, key2->num_groups);
+    return size_diff + fabs(key1->capacity_ratio - key2->capacity_ratio) + group_diff;
+}
+
+
+int
+angle_db_append(const char* path, const angle_key_t* key, const double approx_ratio, const double* angles) {
+    char line[ANGLE_DB_LINE];
+    int len = snprintf(
+        line, sizeof(line), "%s %d %d %d %.6f %d %.6f %.6f",
+        key->qaoa, key->quadratic, key->depth, key->size, key->capacity_ratio, key->num_groups, key->mean_profit,
+        approx_ratio
+    );
+    for (int j = 0; j < 2 * key->depth && len < (int) sizeof(line); ++j) {
+        len += snprintf(line + len, sizeof(line) - len, " %.10f", angles[j]);
+    }
+    if (len + 1 >= (int) sizeof(line)) {
+        return 0;
+    }
+    line[len++] = '\n';
+    return append_file(path, line, len);
+}
+
+
+int
+angle_db_nearest(const char* path, const angle_key_t* key, const int max_records, angle_record_t* records) {
+    int num_found = 0;
+    #pragma omp critical(angle_db)
+    {
+        if (update_angle_index(path)) {
+            const angle_bucket_t* bucket = find_bucket(key);
+            double distances[max_records];
+            for (size_t idx = 0; bucket != NULL && idx < bucket->num_records; ++idx) {
+                const angle_record_t* record = bucket->records + idx;
+                const double distance = angle_key_distance(key, &record->key);
+                if (!isfinite(distance)) {
+                    continue;
+                }
+
+                // Position in the sorted list of the nearest entries so far
+                int pos = num_found;
+                while (pos > 0 && (distance < distances[pos - 1]
+                                   || (distance == distances[pos - 1]
+                                       && record->approx_ratio > records[pos - 1].approx_ratio))) {
+                    --pos;
+                }
+                if (pos == max_records) {
+                    continue;
+                }
+                if (num_found < max_records) {
+                    ++num_found;
+                }
+                for (int cur = num_found - 1; cur > pos; --cur) {
+                    records[cur] = records[cur - 1];
+                    distances[cur] = distances[cur - 1];
+                }
+                records[pos] = *record; // Angles are copied once the nearest entries are known
+                distances[pos] = distance;
+            }
+            for (int idx = 0; idx < num_found; ++idx) {
+                const size_t angles_size = 2 * records[idx].key.depth * sizeof(double);
+                double* angles = malloc(angles_size);
+                memcpy(angles, records[idx].angles, angles_size);
+                records[idx].angles = angles;
+            }
+        }
+    }
+    return num_found;
+}
+
+
+void
+free_angle_records(angle_record_t* records, const int num_records) {
+    for (int idx = 0; idx < num_records; ++idx) {
+        free(records[idx].angles);
+        records[idx].angles = NULL;
+    }
+}
@@ -0,0 +1,193 @@
+/*
+ * =============================================================================
+ *                            includes
+ * =============================================================================
+ */
+
+#include "batch.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/*
+ * =============================================================================
+ *                                  Batches
+ * =============================================================================
+ */
+
+batch_t*
+create_batch(instance_context_t** prepared, const int num_instances, const int depth) {
+    batch_t* batch = malloc(sizeof(batch_t));
+    batch->num_instances = num_instances;
+    batch->depth = depth;
+    batch->offsets = malloc((num_instances + 1) * sizeof(size_t));
+    batch->gamma_periods = malloc(num_instances * sizeof(double));
+    size_t offset = 0;
+    for (int instance = 0; instance < num_instances; ++instance) {
+        batch->offsets[instance] = offset;
+        offset += (prepared[instance]->num_states + BATCH_PAD - 1) / BATCH_PAD * BATCH_PAD;
+        batch->gamma_periods[instance] = prepared[instance]->gamma_period;
+    }
+    batch->offsets[num_instances] = offset;
+    batch->num_amplitudes = offset;
+
+    // The padding has amplitude and profit 0, so that the kernels need neither remainder loops nor masks
+    batch->init = calloc(offset, sizeof(double));
+    batch->profits = calloc(offset, sizeof(double));
+    batch->re = calloc(offset, sizeof(double));
+    batch->im = calloc(offset, sizeof(double));
+    for (int instance = 0; instance < num_instances; ++instance) {
+        const instance_context_t* instance_prepared = prepared[instance];
+        double* init = batch->init + batch->offsets[instance];
+        double* profits = batch->profits + batch->offsets[instance];
+        for (size_t idx = 0; idx < instance_prepared->num_states; ++idx) {
+            init[idx] = sqrt(instance_prepared->qtg_nodes[idx].prob);
+            profits[idx] = (double) get_profit(&instance_prepared->sol_profits, idx);
+        }
+    }
+    return batch;
+}
+
+
+void
+free_batch(batch_t* batch) {
+    free(batch->offsets);
+    free(batch->gamma_periods);
+    free(batch->init);
+    free(batch->profits);
+    free(batch->re);
+    free(batch->im);
+    free(batch);
+}
+
+
+/*
+ * =============================================================================
+ *                                 Evaluation
+ * =============================================================================
+ */
+
+static double
+evaluate_segment(batch_t* batch, const int instance, const double* angles, const int num_layers) {
+    const size_t start = batch->offsets[instance];
+    const size_t size = batch->offsets[instance + 1] - start;
+    const double* restrict init = batch->init + start;
+    const double* restrict profits = batch->profits + start;
+    double* restrict re = batch->re + start;
+    double* restrict im = batch->im + start;
+
+    // Factor of the initial state that the pending Grover mixer adds, see qtg_grover_mixer
+    double factor_re = 0;
+    double factor_im = 0;
+    for (int j = 0; j < num_layers; ++j) {
+        const double gamma = angles[2 * j];
+        double overlap_re = 0;
+        double overlap_im = 0;
+        if (j == 0) { // The first layer starts from the initial state instead of restoring it
+            #pragma omp simd reduction(+:overlap_re, overlap_im)
+            for (size_t idx = 0; idx < size; ++idx) {
+                const double phase = gamma * profits[idx];
+                re[idx] = init[idx] * cos(phase);
+                im[idx] = -init[idx] * sin(phase);
+                overlap_re += init[idx] * re[idx];
+                overlap_im += init[idx] * im[idx];
+            }
+        } else {
+            #pragma omp simd reduction(+:overlap_re, overlap_im)
+            for (size_t idx = 0; idx < size; ++idx) {
+                const double mixed_re = re[idx] + factor_re * init[idx];
+                const double mixed_im = im[idx] + factor_im * init[idx];
+                const double phase = gamma * profits[idx];
+                const double cos_phase = cos(phase);
+                const double sin_phase = sin(phase);
+                re[idx] = mixed_re * cos_phase + mixed_im * sin_phase;
+                im[idx] = mixed_im * cos_phase - mixed_re * sin_phase;
+                overlap_re += init[idx] * re[idx];
+                overlap_im += init[idx] * im[idx];
+            }
+        }
+        // (e^(-i beta) - 1) times the scalar product
+        const double beta = angles[2 * j + 1];
+        const double phase_re = cos(beta) - 1;
+        const double phase_im = -sin(beta);
+        factor_re = phase_re * overlap_re - phase_im * overlap_im;
+        factor_im = phase_re * overlap_im + phase_im * overlap_re;
+    }
+
+    // All QTG states are feasible, and the padding has profit 0
+    double exp_val = 0;
+    #pragma omp simd reduction(+:exp_val)
+    for (size_t idx = 0; idx < size; ++idx) {
+        const double mixed_re = re[idx] + factor_re * init[idx];
+        const double mixed_im = im[idx] + factor_im * init[idx];
+        exp_val += (mixed_re * mixed_re + mixed_im * mixed_im) * profits[idx];
+    }
+    return exp_val;
+}
+
+
+void
+evaluate_batch(batch_t* batch, const double* angles, const int num_layers, double* values) {
+    #pragma omp parallel for schedule(dynamic)
+    for (int instance = 0; instance < batch->num_instances; ++instance) {
+        values[instance] = evaluate_segment(batch, instance, angles + instance * 2 * batch->depth, num_layers);
+    }
+}
+
+
+size_t
+batch_grid_search(batch_t* batch, const int m, double* best_angles, double* best_values) {
+    const double beta_step = 2 * M_PI / m;
+    const size_t angle_size = 2 * batch->depth;
+    double* angles = malloc(batch->num_instances * angle_size * sizeof(double));
+    double* values = malloc(batch->num_instances * sizeof(double));
+    size_t* best_points = malloc(batch->num_instances * sizeof(size_t));
+    size_t num_evals = 0;
+
+    // All angles are 0 initially to prepare layer-wise fine-grid search
+    memset(best_angles, 0, batch->num_instances * angle_size * sizeof(double));
+    for (int instance = 0; instance < batch->num_instances; ++instance) {
+        best_values[instance] = -INFINITY;
+    }
+
+    for (int j = 0; j < batch->depth; j++) { // Iterate over pairs of angles
+        // The first gamma only ranges over half a period, see canonicalize_angles
+        const size_t num_points = (size_t) (j == 0 ? m / 2 + 1 : m) * m;
+
+        // Best angles of the previous layers
+        memcpy(angles, best_angles, batch->num_instances * angle_size * sizeof(double));
+        for (int instance = 0; instance < batch->num_instances; ++instance) {
+            best_points[instance] = num_points;
+        }
+
+        // Every grid point is evaluated for all instances at once, each scaled by its own period of gamma
+        for (size_t point = 0; point < num_points; ++point) {
+            for (int instance = 0; instance < batch->num_instances; ++instance) {
+                angles[instance * angle_size + 2*j] = (double) (point / m) * (batch->gamma_periods[instance] / m);
+                angles[instance * angle_size + 2*j+1] = (double) (point % m) * beta_step; // m choices for beta
+            }
+            // The layers after j are still 0, i.e. the identity, and need not be evolved
+            evaluate_batch(batch, angles, j + 1, values);
+            for (int instance = 0; instance < batch->num_instances; ++instance) {
+                if (values[instance] > best_values[instance]) { // Strict in grid order, as in fine_grid_search
+                    best_values[instance] = values[instance];
+                    best_points[instance] = point;
+                }
+            }
+        }
+
+        for (int instance = 0; instance < batch->num_instances; ++instance) { // Keep best angles of this layer
+            if (best_points[instance] < num_points) {
+                best_angles[instance * angle_size + 2*j] =
+                    (double) (best_points[instance] / m) * (batch->gamma_periods[instance] / m);
+                best_angles[instance * angle_size + 2*j+1] = (double) (best_points[instance] % m) * beta_step;
+            }
+        }
+        num_evals += num_points;
+    }
+    free(angles);
+    free(values);
+    free(best_points);
+    return num_evals;
+}
@@ -0,0 +1,595 @@
+/*
+ * =============================================================================
+ *                            includes
+ * =============================================================================
+ */
+
+#include "mps.h"
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define SVD_TOLERANCE       1e-15   // Relative accuracy up to which columns count as orthogonal
+#define SVD_MAX_SWEEPS      64      // Jacobi sweeps after which the decomposition is accepted as is
+#define SVD_CUTOFF          1e-12   // Singular values below this fraction of the largest one are discarded
+
+#define SWAP_GATE_INDEX(X)  (((X) & 1) << 1 | ((X) >> 1)) // Exchanges the two bits of a two-qubit basis index
+
+typedef double complex      cmplx;
+
+
+/*
+ * =============================================================================
+ *                              Linear algebra
+ * =============================================================================
+ */
+
+/*
+ * Function:            jacobi_columns
+ * --------------------
+ * Description:         Orthogonalizes the columns of a column-major matrix W by complex Jacobi rotations, which are
+ *                      accumulated in V. Afterwards W = U S holds with orthogonal columns.
+ */
+static void
+jacobi_columns(cmplx* w, const int rows, const int cols, cmplx* v) {
+    for (int sweep = 0; sweep < SVD_MAX_SWEEPS; ++sweep) {
+        bool_t rotated = FALSE;
+        for (int j = 0; j < cols - 1; ++j) {
+            for (int l = j + 1; l < cols; ++l) {
+                cmplx* wj = w + (size_t) j * rows;
+                cmplx* wl = w + (size_t) l * rows;
+                double alpha = 0, beta = 0;
+                cmplx g = 0;
+                for (int r = 0; r < rows; ++r) {
+                    alpha += creal(wj[r] * conj(wj[r]));
+                    beta += creal(wl[r] * conj(wl[r]));
+                    g += conj(wj[r]) * wl[r];
+                }
+                if (cabs(g) <= SVD_TOLERANCE * sqrt(alpha * beta) || cabs(g) == 0) {
+                    continue;
+                }
+                rotated = TRUE;
+
+                // Rotation [[c, s e^(i phi)], [-s e^(-i phi), c]] annihilating the scalar product g = |g| e^(i phi)
+                const double zeta = (beta - alpha) / (2 * cabs(g));
+                const double t = (zeta >= 0 ? 1. : -1.) / (fabs(zeta) + sqrt(1 + zeta * zeta));
+                const double c = 1 / sqrt(1 + t * t);
+                const double s = c * t;
+                const cmplx phase = g / cabs(g);
+
+                for (int r = 0; r < rows; ++r) {
+                    const cmplx tmp = wj[r];
+                    wj[r] = c * tmp - s * conj(phase) * wl[r];
+                    wl[r] = s * phase * tmp + c * wl[r];
+                }
+                cmplx* vj = v + (size_t) j * cols;
+                cmplx* vl = v + (size_t) l * cols;
+                for (int r = 0; r < cols; ++r) {
+                    const cmplx tmp = vj[r];
+                    vj[r] = c * tmp - s * conj(phase) * vl[r];
+                    vl[r] = s * phase * tmp + c * vl[r];
+                }
+            }
+        }
+        if (!rotated) {
+            break;
+        }
+    }
+}
+
+
+int
+svd(const cmplx* mat, const int rows, const int cols, cmplx* u, double* s, cmplx* v) {
+    // Jacobi rotations act on the columns of W, which must not outnumber its rows; otherwise decompose M^H
+    const bool_t transposed = rows < cols;
+    const int w_rows = transposed ? cols : rows;
+    const int w_cols = transposed ? rows : cols;
+
+    cmplx* w = malloc((size_t) w_rows * w_cols * sizeof(cmplx)); // column-major
+    cmplx* w_v = calloc((size_t) w_cols * w_cols, sizeof(cmplx)); // column-major
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            if (transposed) {
+                w[(size_t) r * cols + c] = conj(mat[(size_t) r * cols + c]);
+            } else {
+                w[(size_t) c * rows + r] = mat[(size_t) r * cols + c];
+            }
+        }
+    }
+    for (int c = 0; c < w_cols; ++c) {
+        w_v[(size_t) c * w_cols + c] = 1;
+    }
+
+    jacobi_columns(w, w_rows, w_cols, w_v);
+
+    // Sort the singular values, i.e. the column norms, in descending order
+    double* norms = malloc(w_cols * sizeof(double));
+    int* order = malloc(w_cols * sizeof(int));
+    for (int c = 0; c < w_cols; ++c) {
+        norms[c] = 0;
+        for (int r = 0; r < w_rows; ++r) {
+            norms[c] += creal(w[(size_t) c * w_rows + r] * conj(w[(size_t) c * w_rows + r]));
+        }
+        norms[c] = sqrt(norms[c]);
+        order[c] = c;
+    }
+    for (int c = 1; c < w_cols; ++c) {
+        for (int d = c; d > 0 && norms[order[d]] > norms[order[d - 1]]; --d) {
+            SWAP(order + d, order + d - 1, int);
+        }
+    }
+
+    // W = U' S and V' hold the decomposition of the transposed matrix in case of M^H = U' S V'^H, i.e. M = V' S U'^H
+    cmplx* left = transposed ? v : u;
+    cmplx* right = transposed ? u : v;
+    for (int k = 0; k < w_cols; ++k) {
+        const int c = order[k];
+        s[k] = norms[c];
+        for (int r = 0; r < w_rows; ++r) {
+            left[(size_t) r * w_cols + k] = norms[c] > 0 ? w[(size_t) c * w_rows + r] / norms[c] : 0;
+        }
+        for (int r = 0; r < w_cols; ++r) {
+            right[(size_t) r * w_cols + k] = w_v[(size_t) c * w_cols + r];
+        }
+    }
+
+    free(w);
+    free(w_v);
+    free(norms);
+    free(order);
+    return w_cols;
+}
+
+
+/*
+ * Function:            kept_singular_values
+ * --------------------
+ * Description:         Number of singular values that survive the relative cutoff and the maximal bond dimension.
+ */
+static int
+kept_singular_values(const double* s, const int num_values, const int max_bond) {
+    int kept = 0;
+    while (kept < num_values && kept < max_bond && s[kept] > SVD_CUTOFF * s[0]) {
+        ++kept;
+    }
+    return kept > 0 ? kept : 1;
+}
+
+
+/*
+ * =============================================================================
+ *                              MPS manipulation
+ * =============================================================================
+ */
+
+mps_t*
+create_product_mps(const bit_t size, const double* probs, const int max_bond) {
+    mps_t* mps = malloc(sizeof(mps_t));
+    mps->size = size;
+    mps->max_bond = max_bond;
+    mps->center = 0;
+    mps->trunc_weight = 0;
+    mps->bonds = malloc((size + 1) * sizeof(int));
+    mps->tensors = malloc(size * sizeof(cmplx*));
+
+    for (bit_t site = 0; site <= size; ++site) {
+        mps->bonds[site] = 1;
+    }
+    for (bit_t site = 0; site < size; ++site) {
+        mps->tensors[site] = malloc(2 * sizeof(cmplx));
+        mps->tensors[site][0] = sqrt(1 - probs[site]);
+        mps->tensors[site][1] = sqrt(probs[site]);
+    }
+    return mps;
+}
+
+
+void
+free_mps(mps_t* mps) {
+    for (bit_t site = 0; site < mps->size; ++site) {
+        free(mps->tensors[site]);
+    }
+    free(mps->tensors);
+    free(mps->bonds);
+    free(mps);
+}
+
+
+/*
+ * Function:            shift_center_right
+ * --------------------
+ * Description:         Makes the center site left-orthonormal via A = U (S V^H) and absorbs S V^H into its right
+ *                      neighbour.
+ */
+static void
+shift_center_right(mps_t* mps) {
+    const bit_t site = mps->center;
+    const int left = mps->bonds[site], mid = mps->bonds[site + 1], right = mps->bonds[site + 2];
+    const int num_values = MIN(2 * left, mid);
+    cmplx* u = malloc((size_t) 2 * left * num_values * sizeof(cmplx));
+    cmplx* v = malloc((size_t) mid * num_values * sizeof(cmplx));
+    double* s = malloc(num_values * sizeof(double));
+
+    svd(mps->tensors[site], 2 * left, mid, u, s, v);
+    const int kept = kept_singular_values(s, num_values, num_values);
+
+    cmplx* a = malloc((size_t) 2 * left * kept * sizeof(cmplx));
+    for (int row = 0; row < 2 * left; ++row) {
+        for (int k = 0; k < kept; ++k) {
+            a[(size_t) row * kept + k] = u[(size_t) row * num_values + k];
+        }
+    }
+    cmplx* b = calloc((size_t) kept * 2 * right, sizeof(cmplx));
+    const cmplx* old_b = mps->tensors[site + 1];
+    for (int k = 0; k < kept; ++k) {
+        for (int m = 0; m < mid; ++m) {
+            const cmplx factor = s[k] * conj(v[(size_t) m * num_values + k]);
+            for (int col = 0; col < 2 * right; ++col) {
+                b[(size_t) k * 2 * right + col] += factor * old_b[(size_t) m * 2 * right + col];
+            }
+        }
+    }
+
+    free(mps->tensors[site]);
+    free(mps->tensors[site + 1]);
+    mps->tensors[site] = a;
+    mps->tensors[site + 1] = b;
+    mps->bonds[site + 1] = kept;
+    mps->center = site + 1;
+    free(u);
+    free(v);
+    free(s);
+}
+
+
+/*
+ * Function:            shift_center_left
+ * --------------------
+ * Description:         Makes the center site right-orthonormal via A = (U S) V^H and absorbs U S into its left
+ *                      neighbour.
+ */
+static void
+shift_center_left(mps_t* mps) {
+    const bit_t site = mps->center;
+    const int left = mps->bonds[site - 1], mid = mps->bonds[site], right = mps->bonds[site + 1];
+    const int num_values = MIN(mid, 2 * right);
+    cmplx* u = malloc((size_t) mid * num_values * sizeof(cmplx));
+    cmplx* v = malloc((size_t) 2 * right * num_values * sizeof(cmplx));
+    double* s = malloc(num_values * sizeof(double));
+
+    svd(mps->tensors[site], mid, 2 * right, u, s, v);
+    const int kept = kept_singular_values(s, num_values, num_values);
+
+    cmplx* b = malloc((size_t) kept * 2 * right * sizeof(cmplx));
+    for (int k = 0; k < kept; ++k) {
+        for (int col = 0; col < 2 * right; ++col) {
+            b[(size_t) k * 2 * right + col] = conj(v[(size_t) col * num_values + k]);
+        }
+    }
+    cmplx* a = calloc((size_t) 2 * left * kept, sizeof(cmplx));
+    const cmplx* old_a = mps->tensors[site - 1];
+    for (int row = 0; row < 2 * left; ++row) {
+        for (int m = 0; m < mid; ++m) {
+            const cmplx entry = old_a[(size_t) row * mid + m];
+            for (int k = 0; k < kept; ++k) {
+                a[(size_t) row * kept + k] += entry * u[(size_t) m * num_values + k] * s[k];
+            }
+        }
+    }
+
+    free(mps->tensors[site - 1]);
+    free(mps->tensors[site]);
+    mps->tensors[site - 1] = a;
+    mps->tensors[site] = b;
+    mps->bonds[site] = kept;
+    mps->center = site - 1;
+    free(u);
+    free(v);
+    free(s);
+}
+
+
+void
+mps_move_center(mps_t* mps, const bit_t site) {
+    while (mps->center < site) {
+        shift_center_right(mps);
+    }
+    while (mps->center > site) {
+        shift_center_left(mps);
+    }
+}
+
+
+void
+mps_apply_phase(mps_t* mps, const bit_t qubit, const cmplx phase) {
+    const int left = mps->bonds[qubit], right = mps->bonds[qubit + 1];
+    for (int l = 0; l < left; ++l) {
+        for (int r = 0; r < right; ++r) {
+            mps->tensors[qubit][((size_t) l * 2 + 1) * right + r] *= phase;
+        }
+    }
+}
+
+
+/*
+ * Function:            apply_adjacent
+ * --------------------
+ * Description:         Applies a gate given in the basis |s_site + 2 s_(site + 1)> to the sites site and site + 1,
+ *                      splits the result by an SVD and truncates the shared bond. The orthogonality center ends up on
+ *                      site + 1.
+ */
+static void
+apply_adjacent(mps_t* mps, const bit_t site, const cmplx gate[16]) {
+    mps_move_center(mps, site);
+    const int left = mps->bonds[site], mid = mps->bonds[site + 1], right = mps->bonds[site + 2];
+    const cmplx* a = mps->tensors[site];
+    const cmplx* b = mps->tensors[site + 1];
+
+    // Contract both sites, theta[l][s1][s2][r], and apply the gate on the physical indices
+    cmplx* theta = calloc((size_t) left * 4 * right, sizeof(cmplx));
+    for (int l = 0; l < left; ++l) {
+        for (int s1 = 0; s1 < 2; ++s1) {
+            for (int m = 0; m < mid; ++m) {
+                const cmplx entry = a[((size_t) l * 2 + s1) * mid + m];
+                for (int s2 = 0; s2 < 2; ++s2) {
+                    for (int r = 0; r < right; ++r) {
+                        theta[(((size_t) l * 2 + s1) * 2 + s2) * right + r] += entry * b[((size_t) m * 2 + s2) * right + r];
+                    }
+                }
+            }
+        }
+    }
+    cmplx* mat = malloc((size_t) left * 4 * right * sizeof(cmplx));
+    for (int l = 0; l < left; ++l) {
+        for (int r = 0; r < right; ++r) {
+            for (int out = 0; out < 4; ++out) {
+                cmplx sum = 0;
+                for (int in = 0; in < 4; ++in) {
+                    sum += gate[out * 4 + in] * theta[(((size_t) l * 2 + (in & 1)) * 2 + (in >> 1)) * right + r];
+                }
+                mat[(((size_t) l * 2 + (out & 1)) * 2 + (out >> 1)) * right + r] = sum;
+            }
+        }
+    }
+
+    // Split again along rows (l, s1) and columns (s2, r)
+    const int num_values = MIN(2 * left, 2 * right);
+    cmplx* u = malloc((size_t) 2 * left * num_values * sizeof(cmplx));
+    cmplx* v = malloc((size_t) 2 * right * num_values * sizeof(cmplx));
+    double* s = malloc(num_values * sizeof(double));
+    svd(mat, 2 * left, 2 * right, u, s, v);
+    const int kept = kept_singular_values(s, num_values, mps->max_bond);
+    for (int k = kept; k < num_values; ++k) {
+        mps->trunc_weight += s[k] * s[k];
+    }
+
+    cmplx* new_a = malloc((size_t) 2 * left * kept * sizeof(cmplx));
+    for (int row = 0; row < 2 * left; ++row) {
+        for (int k = 0; k < kept; ++k) {
+            new_a[(size_t) row * kept + k] = u[(size_t) row * num_values + k];
+        }
+    }
+    cmplx* new_b = malloc((size_t) kept * 2 * right * sizeof(cmplx));
+    for (int k = 0; k < kept; ++k) {
+        for (int col = 0; col < 2 * right; ++col) {
+            new_b[(size_t) k * 2 * right + col] = s[k] * conj(v[(size_t) col * num_values + k]);
+        }
+    }
+
+    free(mps->tensors[site]);
+    free(mps->tensors[site + 1]);
+    mps->tensors[site] = new_a;
+    mps->tensors[site + 1] = new_b;
+    mps->bonds[site + 1] = kept;
+    mps->center = site + 1;
+    free(theta);
+    free(mat);
+    free(u);
+    free(v);
+    free(s);
+}
+
+
+void
+mps_apply_two_qubit(mps_t* mps, const bit_t qubit1, const bit_t qubit2, const cmplx gate[16]) {
+    const bit_t low = MIN(qubit1, qubit2);
+    const bit_t high = MAX(qubit1, qubit2);
+
+    // Gate in the basis |s_low + 2 s_high>
+    cmplx site_gate[16];
+    for (int out = 0; out < 4; ++out) {
+        for (int in = 0; in < 4; ++in) {
+            site_gate[out * 4 + in] = qubit1 < qubit2 ? gate[out * 4 + in]
+                                                      : gate[SWAP_GATE_INDEX(out) * 4 + SWAP_GATE_INDEX(in)];
+        }
+    }
+
+    cmplx swap_gate[16] = {0};
+    for (int x = 0; x < 4; ++x) {
+        swap_gate[SWAP_GATE_INDEX(x) * 4 + x] = 1;
+    }
+
+    // Carry the lower qubit rightwards until it neighbours the higher one, then bring it back
+    for (bit_t site = low; site < high - 1; ++site) {
+        apply_adjacent(mps, site, swap_gate);
+    }
+    apply_adjacent(mps, high - 1, site_gate);
+    for (bit_t site = high - 1; site > low; --site) {
+        apply_adjacent(mps, site - 1, swap_gate);
+    }
+}
+
+
+/*
+ * =============================================================================
+ *                                 Evaluation
+ * =============================================================================
+ */
+
+/*
+ * Function:            transfer
+ * --------------------
+ * Description:         Adds A_s^T env conj(A_s) for one physical index s to the environment on the next bond, i.e.
+ *                      next[r][r'] += sum_(l,l') A[l][s][r] env[l][l'] conj(A[l'][s][r']).
+ */
+static void
+transfer(const cmplx* tensor, const int left, const int right, const int s, const cmplx* env, cmplx* next,
+         cmplx* scratch) {
+    // scratch[l'][r] = sum_l env[l][l'] A[l][s][r]
+    memset(scratch, 0, (size_t) left * right * sizeof(cmplx));
+    for (int l = 0; l < left; ++l) {
+        for (int lp = 0; lp < left; ++lp) {
+            const cmplx entry = env[(size_t) l * left + lp];
+            if (entry == 0) {
+                continue;
+            }
+            for (int r = 0; r < right; ++r) {
+                scratch[(size_t) lp * right + r] += entry * tensor[((size_t) l * 2 + s) * right + r];
+            }
+        }
+    }
+    for (int lp = 0; lp < left; ++lp) {
+        for (int r = 0; r < right; ++r) {
+            const cmplx entry = scratch[(size_t) lp * right + r];
+            for (int rp = 0; rp < right; ++rp) {
+                next[(size_t) r * right + rp] += entry * conj(tensor[((size_t) lp * 2 + s) * right + rp]);
+            }
+        }
+    }
+}
+
+
+double
+mps_norm(const mps_t* mps) {
+    const cmplx* center = mps->tensors[mps->center];
+    const size_t num_entries = (size_t) mps->bonds[mps->center] * 2 * mps->bonds[mps->center + 1];
+    double norm = 0;
+    for (size_t idx = 0; idx < num_entries; ++idx) {
+        norm += creal(center[idx] * conj(center[idx]));
+    }
+    return norm;
+}
+
+
+double
+mps_feasible_expectation(const mps_t* mps, const knapsack_t* kp) {
+    const size_t num_costs = kp->capacity + 1;
+
+    // Environments of the norm (weights) and of the profit, one per reachable cumulative cost
+    cmplx** weights = calloc(num_costs, sizeof(cmplx*));
+    cmplx** profits = calloc(num_costs, sizeof(cmplx*));
+    weights[0] = malloc(sizeof(cmplx));
+    profits[0] = malloc(sizeof(cmplx));
+    weights[0][0] = 1;
+    profits[0][0] = 0;
+
+    for (bit_t site = 0; site < mps->size; ++site) {
+        const int left = mps->bonds[site], right = mps->bonds[site + 1];
+        const cmplx* tensor = mps->tensors[site];
+        cmplx** next_weights = calloc(num_costs, sizeof(cmplx*));
+        cmplx** next_profits = calloc(num_costs, sizeof(cmplx*));
+        cmplx* scratch = malloc((size_t) left * right * sizeof(cmplx));
+        cmplx* shifted = malloc((size_t) left * left * sizeof(cmplx));
+
+        for (size_t cost = 0; cost < num_costs; ++cost) {
+            if (weights[cost] == NULL) {
+                continue;
+            }
+            for (int s = 0; s < 2; ++s) {
+                const size_t next_cost = cost + s * kp->items[site].cost;
+                if (next_cost >= num_costs) {
+                    continue; // Infeasible from here on, contributes 0 to the modified objective function
+                }
+                if (next_weights[next_cost] == NULL) {
+                    next_weights[next_cost] = calloc((size_t) right * right, sizeof(cmplx));
+                    next_profits[next_cost] = calloc((size_t) right * right, sizeof(cmplx));
+                }
+                transfer(tensor, left, right, s, weights[cost], next_weights[next_cost], scratch);
+                for (size_t idx = 0; idx < (size_t) left * left; ++idx) {
+                    shifted[idx] = profits[cost][idx] + s * kp->items[site].profit * weights[cost][idx];
+                }
+                transfer(tensor, left, right, s, shifted, next_profits[next_cost], scratch);
+            }
+            free(weights[cost]);
+            free(profits[cost]);
+        }
+
+        free(weights);
+        free(profits);
+        free(scratch);
+        free(shifted);
+        weights = next_weights;
+        profits = next_profits;
+    }
+
+    double exp_val = 0;
+    for (size_t cost = 0; cost < num_costs; ++cost) {
+        if (weights[cost] != NULL) {
+            exp_val += creal(profits[cost][0]);
+            free(weights[cost]);
+            free(profits[cost]);
+        }
+    }
+    free(weights);
+    free(profits);
+
+    return exp_val / mps_norm(mps);
+}
+
+
+double
+mps_prob_beating_greedy(mps_t* mps, const knapsack_t* kp, const num_t int_greedy_sol_val, const size_t num_samples) {
+    // With all sites right-orthonormal, the marginal of every prefix is the squared norm of its partial contraction
+    mps_move_center(mps, 0);
+    int max_bond = 1;
+    for (bit_t site = 0; site <= mps->size; ++site) {
+        max_bond = MAX(max_bond, mps->bonds[site]);
+    }
+    cmplx* vec = malloc(max_bond * sizeof(cmplx));
+    cmplx* next[2] = {malloc(max_bond * sizeof(cmplx)), malloc(max_bond * sizeof(cmplx))};
+    uint64_t rng = 0x9E3779B97F4A7C15ULL; // Fixed seed so that results are reproducible
+
+    size_t hits = 0;
+    for (size_t sample = 0; sample < num_samples; ++sample) {
+        vec[0] = 1;
+        num_t cost = 0, profit = 0;
+        for (bit_t site = 0; site < mps->size; ++site) {
+            const int left = mps->bonds[site], right = mps->bonds[site + 1];
+            double probs[2] = {0, 0};
+            for (int s = 0; s < 2; ++s) {
+                for (int r = 0; r < right; ++r) {
+                    cmplx sum = 0;
+                    for (int l = 0; l < left; ++l) {
+                        sum += vec[l] * mps->tensors[site][((size_t) l * 2 + s) * right + r];
+                    }
+                    next[s][r] = sum;
+                    probs[s] += creal(sum * conj(sum));
+                }
+            }
+
+            // xorshift64* as uniform random number in [0, 1)
+            rng ^= rng >> 12;
+            rng ^= rng << 25;
+            rng ^= rng >> 27;
+            const double uniform = (double) ((rng * 0x2545F4914F6CDD1DULL) >> 11) / (double) (1ULL << 53);
+            const int s = uniform * (probs[0] + probs[1]) < probs[0] ? 0 : 1;
+            for (int r = 0; r < right; ++r) {
+                vec[r] = next[s][r] / sqrt(probs[s]);
+            }
+            cost += s * kp->items[site].cost;
+            profit += s * kp->items[site].profit;
+        }
+        if (cost <= kp->capacity && profit > int_greedy_sol_val) {
+            ++hits;
+        }
+    }
+
+    free(vec);
+    free(next[0]);
+    free(next[1]);
+    return (double) hits / num_samples;
+}
@@ -5,6 +5,9 @@
  */
 
 #include "qaoa.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 /*
@@ -16,32 +19,62 @@
 #define TRUE        1
 #define FALSE       0
 
-#define POW2(X) (1 << (X))
+#define POW2(X) ((size_t) 1 << (X))
 
+#define MPS_NUM_SAMPLES     16384 // Samples drawn from the final MPS to estimate the probability of beating Greedy
 
-/*
- * =============================================================================
- *                              Global variables
- * =============================================================================
- */
+#define COPY_CHUNK          (1 << 16) // Amplitudes per chunk when restoring the initial state in parallel
+
+#define WORKSPACE_MEMORY_SHARE  0.5 // Share of the memory of a run that the workspaces of a batch evaluation may take
+#define KERNEL_MIN_STATES   (1 << 16) // Amplitudes from which a kernel shares the processors a batch leaves idle
+
+#define TRANSFER_ACCEPT     0.98 // Share of the recorded approximation ratio a transferred start needs to skip the grid
+
+#define ADAPTIVE_REFINE_CELLS       4 // Best points of the adaptive grid search around which each level refines
+#define ADAPTIVE_MIN_LAYER_EVALS    32 // Smallest number of evaluations of a layer of the adaptive grid search
+#define ADAPTIVE_MAX_ZOOM           8 // Finest step of the adaptive grid search as fraction of the uniform one
+#define ADAPTIVE_SAME_ANGLE         1e-12 // Angles closer than this count as the same point
+#define ADAPTIVE_DEFAULT_SHARE      4 // Default budget of the adaptive grid search as fraction of the uniform one
+
+#define FOURIER_MAX_ORDER           64 // Highest frequency in beta of the Fourier surrogate
+#define FOURIER_RESOLUTION          16 // Dense points of the Fourier surrogate between two samples of beta
+#define FOURIER_VERIFY_POINTS       4 // Maxima of the best lines of the Fourier surrogate that are evaluated exactly
+#define FOURIER_REFINE_EVALS        20 // Evaluations per angle of each local refinement after the surrogate search
 
-// Variables to be set from the outset
-knapsack_t* kp;
-qaoa_type_t qaoa_type;
-size_t bias;
-int depth;
-opt_t opt_type;
-int m;
-double k;
-double theta;
-int memory_size;
-
-// Variables that are initialized later
-size_t num_states;
-node_t* qtg_nodes;
-num_t* sol_profits;
-double* prob_dist_vals;
-bool_t* sol_feasibilities;
+#define MEMO_CACHE_BYTES    ((size_t) 1 << 24) // Bytes of the cache of evaluated angles of a run
+#define MEMO_CACHE_PROBES   8 // Slots searched for a key before the one it hashes to is replaced
+
+#define LANDSCAPE_CHUNK_POINTS  (1 << 14) // Grid points per parallel batch of a landscape scan
+#define LANDSCAPE_VERSION       1 // Version of the binary landscape format
+
+#define RAW_DATA_CHUNK          (1 << 16) // States per chunk of a raw-data column
+#define RAW_DATA_VERSION        1 // Version of the binary raw-data format
+#define DISTRIBUTION_MIN_SLOTS  1024 // Initial slots of the hash table of distinct profits
+
+#define CHECKPOINT_INTERVAL     60 // Seconds between two checkpoints written during the evaluations
+#define CHECKPOINT_VERSION      1 // Version of the binary checkpoint format
+
+#define FIRST_GAMMA_MARGIN  0.05 // Share of the gamma period the optimizer may exceed the reduced domain by
+
+#define PHASE_BLOCK_BITS    8 // Number of qubits whose profits are combined into one phase table
+
+#define ESTIMATE_MAX_CAPACITIES     ((size_t) 1 << 24) // Capacities the QTG state count tells apart before coarsening
+#define ESTIMATE_LOCAL_EVALS        50 // Assumed evaluations of the local optimizer per angle and start
+#define ESTIMATE_CALIBRATION_SIZE   (1 << 12) // Amplitudes of the state on which the floating-point rate is measured
+#define ESTIMATE_CALIBRATION_TIME   0.02 // Seconds spent on measuring the floating-point rate
+#define ESTIMATE_MALLOC_OVERHEAD    16 // Bytes the allocator adds to every bit string of a QTG node
+#define ESTIMATE_MPS_COPIES         4 // Copies of the MPS tensors alive during a two-qubit gate and its SVD
+#define CMUL_FLOPS                  6 // Floating-point operations of a complex multiplication
+#define CEXP_FLOPS                  20 // Assumed floating-point operations of a complex exponential
+#define GROVER_FLOPS                16 // Per state: scalar product with and update by the initial state
+#define COPULA_PAIR_FLOPS           36 // Per state and pair: six passes of rotations of amplitude pairs
+#define EXPECTATION_FLOPS           5 // Per state: probability times profit, accumulated
+
+#define PROFIT_PHASE_LOOP(T) do { const T* profits = ctx->sol_profits.data; \
+                                  _Pragma("omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)") \
+                                  for (size_t idx = 0; idx < ctx->num_states; ++idx) { \
+                                      angle_state[idx] *= cexp(-I * gamma * profits[idx]); \
+                                  } } while(0)
 
 
 /*
@@ -62,41 +95,175 @@ random_value_on_windows_or_linux() {
 }
 
 void
-free_global_variables() {
-    if (qtg_nodes != NULL) {
-        free_nodes(qtg_nodes, num_states); // To be freed in case of QTG QAOA
-        qtg_nodes = NULL;
+free_run_variables(qaoa_context_t* ctx) {
+    if (ctx->prob_dist_vals != NULL) {
+        free(ctx->prob_dist_vals); // To be freed in case of Copula QAOA
+        ctx->prob_dist_vals = NULL;
+    }
+    if (ctx->initial_state != NULL) {
+        free(ctx->initial_state);
+        ctx->initial_state = NULL;
+    }
+    if (ctx->eval_workspace != NULL) {
+        free_workspace(ctx->eval_workspace);
+        ctx->eval_workspace = NULL;
+    }
+    if (ctx->eval_trace.records != NULL) {
+        free(ctx->eval_trace.records);
+        ctx->eval_trace.records = NULL;
+    }
+    free_eval_cache(ctx);
+}
+
+
+void
+free_context(qaoa_context_t* ctx) {
+    free_run_variables(ctx);
+    if (ctx->shared != NULL) { // The tables are borrowed
+        release_instance_context(ctx->shared);
+        free(ctx);
+        return;
+    }
+    if (ctx->qtg_nodes != NULL) {
+        free_nodes(ctx->qtg_nodes, ctx->num_states); // To be freed in case of QTG QAOA
+    }
+    free(ctx->sol_profits.data); // To be freed in case of QTG or quadratic Copula QAOA
+    free(ctx->sol_feasibilities); // To be freed in case of Copula QAOA
+    free(ctx->block_profits); // To be freed in case of linear Copula QAOA
+    free(ctx);
+}
+
+
+profit_width_t
+narrowest_profit_width(const num_t max_profit) {
+    if (max_profit <= UINT8_MAX) {
+        return PROFIT_8;
+    }
+    if (max_profit <= UINT16_MAX) {
+        return PROFIT_16;
+    }
+    if (max_profit <= UINT32_MAX) {
+        return PROFIT_32;
+    }
+    return PROFIT_64;
+}
+
+
+void
+create_profit_table(profit_table_t* table, const size_t size, const num_t max_profit) {
+    table->width = narrowest_profit_width(max_profit);
+    switch (table->width) {
+        case PROFIT_8:
+            table->data = malloc(size * sizeof(uint8_t));
+            break;
+        case PROFIT_16:
+            table->data = malloc(size * sizeof(uint16_t));
+            break;
+        case PROFIT_32:
+            table->data = malloc(size * sizeof(uint32_t));
+            break;
+        case PROFIT_64:
+            table->data = malloc(size * sizeof(num_t));
+            break;
+    }
+}
+
+
+void
+set_profit(profit_table_t* table, const size_t idx, const num_t profit) {
+    switch (table->width) {
+        case PROFIT_8:
+            ((uint8_t*) table->data)[idx] = profit;
+            break;
+        case PROFIT_16:
+            ((uint16_t*) table->data)[idx] = profit;
+            break;
+        case PROFIT_32:
+            ((uint32_t*) table->data)[idx] = profit;
+            break;
+        case PROFIT_64:
+            ((num_t*) table->data)[idx] = profit;
+            break;
     }
-    if (prob_dist_vals != NULL) {
-        free(prob_dist_vals); // To be freed in case of Copula QAOA
-        prob_dist_vals = NULL;
+}
+
+
+num_t
+get_profit(const profit_table_t* table, const size_t idx) {
+    switch (table->width) {
+        case PROFIT_8:
+            return ((const uint8_t*) table->data)[idx];
+        case PROFIT_16:
+            return ((const uint16_t*) table->data)[idx];
+        case PROFIT_32:
+            return ((const uint32_t*) table->data)[idx];
+        default:
+            return ((const num_t*) table->data)[idx];
+    }
+}
+
+
+num_t
+state_profit(qaoa_context_t* ctx, const size_t idx) {
+    if (ctx->block_profits != NULL) {
+        return factorised_profit(ctx, idx);
     }
-    if (sol_profits != NULL) {
-        free(sol_profits); // To be freed in case of Copula QAOA
-        sol_profits = NULL;
+    return get_profit(&ctx->sol_profits, idx);
+}
+
+
+num_t
+gcd(num_t a, num_t b) {
+    while (b != 0) {
+        const num_t rem = a % b;
+        a = b;
+        b = rem;
     }
-    if (sol_feasibilities != NULL) {
-        free(sol_feasibilities); // To be freed in case of Copula QAOA
-        sol_feasibilities = NULL;
+    return a;
+}
+
+
+int
+kernel_threads(qaoa_context_t* ctx) {
+#ifdef _OPENMP
+    // Processors that the team of the caller leaves idle, e.g. a batch evaluation limited by the workspace budget
+    if (ctx->num_states >= KERNEL_MIN_STATES) {
+        return MAX(omp_get_max_threads() / omp_get_num_threads(), 1);
     }
+#endif
+    return 1;
+}
+
+
+uint64_t
+feasibility_word(qaoa_context_t* ctx, const size_t word) {
+    return ctx->sol_feasibilities != NULL ? ctx->sol_feasibilities[word] : ~(uint64_t) 0; // QTG states are all feasible
 }
 
+
 double
-prob_for_amplitude(const cbs_t* angle_state, const size_t idx) {
-    return cabs(angle_state[idx].amplitude) * cabs(angle_state[idx].amplitude);
+prob_for_amplitude(const cmplx* angle_state, const size_t idx) {
+    return creal(angle_state[idx]) * creal(angle_state[idx]) + cimag(angle_state[idx]) * cimag(angle_state[idx]);
 }
 
 
 double
-prob_beating_greedy(const cbs_t* angle_state, const num_t int_greedy_sol_val) {
+prob_beating_greedy(qaoa_context_t* ctx, const cmplx* angle_state, const num_t int_greedy_sol_val) {
     double prob = 0;
+    const int num_threads = kernel_threads(ctx);
 
-    for (size_t idx = 0; idx < num_states; ++idx) {
-        if (angle_state[idx].profit > int_greedy_sol_val) {
-            if (qaoa_type == COPULA && !sol_feasibilities[idx]) {
-                continue;
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1) reduction(+:prob)
+    for (size_t word = 0; word < (ctx->num_states + 63) / 64; ++word) {
+        const uint64_t mask = feasibility_word(ctx, word);
+        if (mask == 0) {
+            continue; // Skip 64 infeasible solutions at once
+        }
+        const size_t stop = MIN(64, ctx->num_states - word * 64);
+        for (size_t bit = 0; bit < stop; ++bit) {
+            const size_t idx = word * 64 + bit;
+            if ((mask >> bit & 1) && state_profit(ctx, idx) > int_greedy_sol_val) {
+                prob += prob_for_amplitude(angle_state, idx);
             }
-            prob += prob_for_amplitude(angle_state, idx);
         }
     }
 
@@ -104,89 +271,245 @@ prob_beating_greedy(const cbs_t* angle_state, const num_t int_greedy_sol_val) {
 }
 
 
+/*
+ * =============================================================================
+ *                                 Run options
+ * =============================================================================
+ */
+
+run_options_t
+default_run_options() {
+    run_options_t defaults;
+    defaults.backend = STATEVECTOR;
+    defaults.max_bond_dim = 64;
+    defaults.num_workers = 0;
+    defaults.num_starts = 1;
+    defaults.init = INIT_GRID;
+    defaults.grid = GRID_UNIFORM;
+    defaults.grid_budget = 0;
+    defaults.fourier_order = 0;
+    defaults.max_evals = 0;
+    defaults.max_time = 0;
+    defaults.raw_data = RAW_SUMMARY;
+    const double quantiles[] = {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+    defaults.num_quantiles = sizeof(quantiles) / sizeof(double);
+    memcpy(defaults.quantiles, quantiles, sizeof(quantiles));
+    defaults.resume = FALSE;
+    defaults.results_log[0] = '\0';
+    defaults.max_memory = 0;
+    return defaults;
+}
+
+
+bool_t
+parse_run_option(run_options_t* run_options, const char* token) {
+    char key[64], value[256];
+    if (sscanf(token, "%63[^=]=%255s", key, value) != 2) {
+        return FALSE;
+    }
+
+    if (strcmp(key, "backend") == 0) {
+        if (strcmp(value, "statevector") == 0) {
+            run_options->backend = STATEVECTOR;
+        } else if (strcmp(value, "mps") == 0) {
+            run_options->backend = MPS;
+        } else {
+            return FALSE;
+        }
+    } else if (strcmp(key, "bond") == 0) {
+        run_options->max_bond_dim = atoi(value);
+        return run_options->max_bond_dim > 0;
+    } else if (strcmp(key, "init") == 0) {
+        if (strcmp(value, "grid") == 0) {
+            run_options->init = INIT_GRID;
+        } else if (strcmp(value, "transfer") == 0) {
+            run_options->init = INIT_TRANSFER;
+        } else {
+            return FALSE;
+        }
+        return TRUE;
+    } else if (strcmp(key, "grid") == 0) {
+        if (strcmp(value, "uniform") == 0) {
+            run_options->grid = GRID_UNIFORM;
+        } else if (strcmp(value, "adaptive") == 0) {
+            run_options->grid = GRID_ADAPTIVE;
+        } else if (strcmp(value, "fourier") == 0) {
+            run_options->grid = GRID_FOURIER;
+        } else {
+            return FALSE;
+        }
+        return TRUE;
+    } else if (strcmp(key, "grid_evals") == 0) {
+        run_options->grid_budget = atoi(value);
+        return run_options->grid_budget > 0;
+    } else if (strcmp(key, "fourier_order") == 0) {
+        run_options->fourier_order = atoi(value);
+        return run_options->fourier_order > 0 && run_options->fourier_order <= FOURIER_MAX_ORDER;
+    } else if (strcmp(key, "max_evals") == 0) {
+        run_options->max_evals = atoi(value);
+        return run_options->max_evals > 0;
+    } else if (strcmp(key, "max_time") == 0) {
+        run_options->max_time = atof(value);
+        return run_options->max_time > 0;
+    } else if (strcmp(key, "starts") == 0) {
+        run_options->num_starts = atoi(value);
+        return run_options->num_starts > 0;
+    } else if (strcmp(key, "raw_data") == 0) {
+        if (strcmp(value, "summary") == 0) {
+            run_options->raw_data = RAW_SUMMARY;
+        } else if (strcmp(value, "states") == 0) {
+            run_options->raw_data = RAW_STATES;
+        } else {
+            return FALSE;
+        }
+        return TRUE;
+    } else if (strcmp(key, "quantiles") == 0) {
+        run_options->num_quantiles = parse_value_list(value, run_options->quantiles, MAX_QUANTILES);
+        for (int idx = 0; idx < run_options->num_quantiles; ++idx) {
+            if (run_options->quantiles[idx] < 0 || run_options->quantiles[idx] > 1) {
+                return FALSE;
+            }
+        }
+        return run_options->num_quantiles > 0;
+    } else if (strcmp(key, "workers") == 0) {
+        run_options->num_workers = atoi(value);
+        return run_options->num_workers > 0;
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+int
+parse_value_list(const char* token, double* values, const int max_values) {
+    int num_values = 0;
+    const char* pos = token;
+    while (num_values < max_values) {
+        char* end;
+        values[num_values] = strtod(pos, &end);
+        if (end == pos) {
+            return 0; // Not a number
+        }
+        ++num_values;
+        if (*end != ',') {
+            return *end == '\0' ? num_values : 0;
+        }
+        pos = end + 1;
+    }
+    return 0; // Too many values
+}
+
+
 /*
  * =============================================================================
  *                              Gate application
  * =============================================================================
  */
 
+/*
+ * Function:            pair_index
+ * --------------------
+ * Description:         Index of the amplitude whose bit qubit is 0 in the pair-th pair of amplitudes that differ
+ *                      only in this bit, so that the gates can distribute the pairs among threads evenly.
+ */
+static inline size_t
+pair_index(const size_t pair, const int qubit) {
+    return (pair >> qubit << (qubit + 1)) | (pair & (POW2(qubit) - 1));
+}
+
+
 void
-apply_ry(cbs_t* angle_state, const int qubit, const double prob) {
-    const size_t blockDistance = POW2(qubit + 1);
+apply_ry(qaoa_context_t* ctx, cmplx* angle_state, const int qubit, const double prob) {
     const size_t flipDistance = POW2(qubit);
-    for (size_t i = 0; i < num_states; i += blockDistance) {
-        for (size_t j = i; j < i + flipDistance; ++j) {
-            const cmplx tmp = (angle_state + j)->amplitude;
-            (angle_state + j)->amplitude = sqrt(1 - prob) * tmp \
-                                            - sqrt(prob) * (angle_state + j + flipDistance)->amplitude;
-            (angle_state + j + flipDistance)->amplitude = sqrt(prob) * tmp + sqrt(1 - prob) \
-                                                           * (angle_state + j + flipDistance)->amplitude;
-        }
+    const int num_threads = kernel_threads(ctx);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t pair = 0; pair < ctx->num_states / 2; ++pair) {
+        const size_t j = pair_index(pair, qubit);
+        const cmplx tmp = angle_state[j];
+        angle_state[j] = sqrt(1 - prob) * tmp \
+                                        - sqrt(prob) * angle_state[j + flipDistance];
+        angle_state[j + flipDistance] = sqrt(prob) * tmp + sqrt(1 - prob) \
+                                                       * angle_state[j + flipDistance];
     }
 }
 
 
 void
-apply_ry_inv(cbs_t* angle_state, const int qubit, const double prob) {
-    const size_t blockDistance = POW2(qubit + 1);
+apply_ry_inv(qaoa_context_t* ctx, cmplx* angle_state, const int qubit, const double prob) {
     const size_t flipDistance = POW2(qubit);
-    for (size_t i = 0; i < num_states; i += blockDistance) {
-        for (size_t j = i; j < i + flipDistance; ++j) {
-            const cmplx tmp = (angle_state + j)->amplitude;
-            (angle_state + j)->amplitude = sqrt(1 - prob) * tmp \
-                                            + sqrt(prob) * (angle_state + j + flipDistance)->amplitude;
-            (angle_state + j + flipDistance)->amplitude = - sqrt(prob) * tmp + sqrt(1 - prob) \
-                                                           * (angle_state + j + flipDistance)->amplitude;
-        }
+    const int num_threads = kernel_threads(ctx);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t pair = 0; pair < ctx->num_states / 2; ++pair) {
+        const size_t j = pair_index(pair, qubit);
+        const cmplx tmp = angle_state[j];
+        angle_state[j] = sqrt(1 - prob) * tmp \
+                                        + sqrt(prob) * angle_state[j + flipDistance];
+        angle_state[j + flipDistance] = - sqrt(prob) * tmp + sqrt(1 - prob) \
+                                                       * angle_state[j + flipDistance];
     }
 }
 
 
 void
-apply_cry(cbs_t* angle_state, const int control, const int target, const bool_t condition, const double prob) {
-    const size_t blockDistance = POW2(target + 1);
+apply_cry(
+    qaoa_context_t* ctx,
+    cmplx* angle_state,
+    const int control,
+    const int target,
+    const bool_t condition,
+    const double prob
+) {
     const size_t flipDistance = POW2(target);
-    for (size_t i = 0; i < num_states; i += blockDistance) {
-        for (size_t j = i; j < i + flipDistance; ++j) {
-            if ((condition && (j & POW2(control))) || (!condition && !(j & POW2(control)))) {
-                const cmplx tmp = (angle_state + j)->amplitude;
-                (angle_state + j)->amplitude = sqrt(1 - prob) * tmp \
-                                        - sqrt(prob) * (angle_state + j + flipDistance)->amplitude;
-                (angle_state + j + flipDistance)->amplitude = sqrt(prob) * tmp + sqrt(1 - prob) \
-                                                       * (angle_state + j + flipDistance)->amplitude;
-            }
+    const int num_threads = kernel_threads(ctx);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t pair = 0; pair < ctx->num_states / 2; ++pair) {
+        const size_t j = pair_index(pair, target);
+        if ((condition && (j & POW2(control))) || (!condition && !(j & POW2(control)))) {
+            const cmplx tmp = angle_state[j];
+            angle_state[j] = sqrt(1 - prob) * tmp \
+                                    - sqrt(prob) * angle_state[j + flipDistance];
+            angle_state[j + flipDistance] = sqrt(prob) * tmp + sqrt(1 - prob) \
+                                                   * angle_state[j + flipDistance];
         }
     }
 }
 
 
 void
-apply_cry_inv(cbs_t* angle_state, const int control, const int target, const bool_t condition, const double prob) {
-    const size_t blockDistance = POW2(target + 1);
+apply_cry_inv(
+    qaoa_context_t* ctx,
+    cmplx* angle_state,
+    const int control,
+    const int target,
+    const bool_t condition,
+    const double prob
+) {
     const size_t flipDistance = POW2(target);
-    for (size_t i = 0; i < num_states; i += blockDistance) {
-        for (size_t j = i; j < i + flipDistance; ++j) {
-            if ((condition && (j & POW2(control))) || (!condition && !(j & POW2(control)))) {
-                const cmplx tmp = (angle_state + j)->amplitude;
-                (angle_state + j)->amplitude = sqrt(1 - prob) * tmp \
-                                        + sqrt(prob) * (angle_state + j + flipDistance)->amplitude;
-                (angle_state + j + flipDistance)->amplitude = - sqrt(prob) * tmp + sqrt(1 - prob) \
-                                                       * (angle_state + j + flipDistance)->amplitude;
-            }
+    const int num_threads = kernel_threads(ctx);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t pair = 0; pair < ctx->num_states / 2; ++pair) {
+        const size_t j = pair_index(pair, target);
+        if ((condition && (j & POW2(control))) || (!condition && !(j & POW2(control)))) {
+            const cmplx tmp = angle_state[j];
+            angle_state[j] = sqrt(1 - prob) * tmp \
+                                    + sqrt(prob) * angle_state[j + flipDistance];
+            angle_state[j + flipDistance] = - sqrt(prob) * tmp + sqrt(1 - prob) \
+                                                   * angle_state[j + flipDistance];
         }
     }
 }
 
 
 void
-apply_rz(cbs_t* angle_state, const int qubit, const double angle) {
-    const size_t blockDistance = POW2(qubit + 1);
+apply_rz(qaoa_context_t* ctx, cmplx* angle_state, const int qubit, const double angle) {
     const size_t flipDistance = POW2(qubit);
-    for (size_t i = 0; i < num_states; i += blockDistance) {
-        for (size_t j = i; j < i + flipDistance; ++j) {
-            (angle_state + j)->amplitude *= cos(angle) - I * sin(angle);
-            (angle_state + j + flipDistance)->amplitude *= cos(angle) + I * sin(angle);
-        }
+    const int num_threads = kernel_threads(ctx);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t pair = 0; pair < ctx->num_states / 2; ++pair) {
+        const size_t j = pair_index(pair, qubit);
+        angle_state[j] *= cos(angle) - I * sin(angle);
+        angle_state[j + flipDistance] *= cos(angle) + I * sin(angle);
     }
 }
 
@@ -198,23 +521,52 @@ apply_rz(cbs_t* angle_state, const int qubit, const double angle) {
  */
 
 void
-qtg_initial_state_prep(cbs_t* angle_state) {
-    for (size_t idx = 0; idx < num_states; ++idx) {
-        angle_state[idx].profit = qtg_nodes[idx].path.tot_profit;
-        angle_state[idx].amplitude = sqrt(qtg_nodes[idx].prob);
+qtg_initial_state_prep(qaoa_context_t* ctx, cmplx* angle_state) {
+    for (size_t idx = 0; idx < ctx->num_states; ++idx) {
+        angle_state[idx] = sqrt(ctx->qtg_nodes[idx].prob);
+    }
+}
+
+
+void
+build_profit_table(qaoa_context_t* ctx) {
+    switch (ctx->qaoa_type) {
+        case QTG: {
+            const num_t max_profit = ctx->kp_type == LINEAR ? profit_sum(ctx->kp) : quad_profit_sum(ctx->kp);
+            create_profit_table(&ctx->sol_profits, ctx->num_states, max_profit);
+            for (size_t idx = 0; idx < ctx->num_states; ++idx) {
+                set_profit(&ctx->sol_profits, idx, ctx->qtg_nodes[idx].path.tot_profit);
+            }
+            break;
+        }
+        case COPULA: {
+            create_profit_table(&ctx->sol_profits, ctx->num_states, quad_profit_sum(ctx->kp));
+            for (size_t idx = 0; idx < ctx->num_states; ++idx) {
+                set_profit(&ctx->sol_profits, idx, quad_objective_func(ctx->kp, idx));
+            }
+            break;
+        }
     }
 }
 
 
 void
-qtg_grover_mixer(cbs_t *angle_state, double beta) {
-    cmplx scalar_product = 0.0;
-    for (size_t idx = 0; idx < num_states; ++idx) {
-        scalar_product += sqrt(qtg_nodes[idx].prob) * angle_state[idx].amplitude;
+qtg_grover_mixer(qaoa_context_t* ctx, cmplx *angle_state, double beta) {
+    double product_re = 0;
+    double product_im = 0;
+    const int num_threads = kernel_threads(ctx);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1) \
+                             reduction(+:product_re, product_im)
+    for (size_t idx = 0; idx < ctx->num_states; ++idx) {
+        const double initial = creal(ctx->initial_state[idx]); // Initial amplitudes are real
+        product_re += initial * creal(angle_state[idx]);
+        product_im += initial * cimag(angle_state[idx]);
     }
 
-    for (int idx = 0; idx < num_states; ++idx) {
-        angle_state[idx].amplitude += (cexp(-I * beta) - 1.0) * scalar_product * sqrt(qtg_nodes[idx].prob);
+    const cmplx factor = (cexp(-I * beta) - 1.0) * (product_re + I * product_im);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t idx = 0; idx < ctx->num_states; ++idx) {
+        angle_state[idx] += factor * ctx->initial_state[idx];
     }
 }
 
@@ -225,96 +577,234 @@ qtg_grover_mixer(cbs_t *angle_state, double beta) {
  * =============================================================================
  */
 
-double
-prob_dist(const bit_t index) {
-    const double c = (double)cost_sum(kp) / kp->capacity - 1;
-    const bit_t stop_item = break_item(kp);
-    const double r_st = (double)kp->items[stop_item].profit / kp->items[stop_item].cost;
-    const double r = (double)kp->items[index].profit / kp->items[index].cost;
-    return 1 / (1 + c * exp(-k * (r - r_st)));
+void
+build_prob_dist_vals(qaoa_context_t* ctx) {
+    // Instance-dependent constants of the distribution, computed once for all qubits
+    const double c = (double)cost_sum(ctx->kp) / ctx->kp->capacity - 1;
+    const bit_t stop_item = break_item(ctx->kp);
+    const double r_st = (double)ctx->kp->items[stop_item].profit / ctx->kp->items[stop_item].cost;
+
+    ctx->prob_dist_vals = malloc(ctx->kp->size * sizeof(double));
+    for (bit_t index = 0; index < ctx->kp->size; ++index) {
+        const double r = (double)ctx->kp->items[index].profit / ctx->kp->items[index].cost;
+        ctx->prob_dist_vals[index] = 1 / (1 + c * exp(-ctx->k * (r - r_st)));
+    }
 }
 
 
 void
-copula_initial_state_prep(cbs_t* angle_state) {
-    for (size_t idx = 0; idx < num_states; idx++) {
-        angle_state[idx].profit = sol_profits[idx];
-        angle_state[idx].amplitude = 1;
-
-        for (bit_t bit = 0; bit < kp->size; bit++) {
-            const double prob_dist_val = prob_dist_vals[bit];
-            if ((idx & (1 << bit)) != 0) {
-                angle_state[idx].amplitude *= sqrt(prob_dist_val);
-            } else {
-                angle_state[idx].amplitude *= sqrt(1 - prob_dist_val);
+build_phase_blocks(qaoa_context_t* ctx) {
+    ctx->num_phase_blocks = (ctx->kp->size + PHASE_BLOCK_BITS - 1) / PHASE_BLOCK_BITS;
+    ctx->block_profits = calloc(ctx->num_phase_blocks * POW2(PHASE_BLOCK_BITS), sizeof(num_t));
+
+    for (int block = 0; block < ctx->num_phase_blocks; ++block) {
+        num_t* profits = ctx->block_profits + block * POW2(PHASE_BLOCK_BITS);
+        for (bit_t bit = 0; bit < PHASE_BLOCK_BITS; ++bit) {
+            // Values with highest set bit 'bit' extend the already known values below POW2(bit) by one item
+            const bit_t item = block * PHASE_BLOCK_BITS + bit;
+            const num_t item_profit = item < ctx->kp->size ? ctx->kp->items[item].profit : 0;
+            for (size_t val = POW2(bit); val < POW2(bit + 1); ++val) {
+                profits[val] = profits[val - POW2(bit)] + item_profit;
             }
         }
     }
 }
 
 
+num_t
+factorised_profit(qaoa_context_t* ctx, const size_t idx) {
+    num_t profit = 0;
+    for (int block = 0; block < ctx->num_phase_blocks; ++block) {
+        const size_t val = (idx >> (block * PHASE_BLOCK_BITS)) & (POW2(PHASE_BLOCK_BITS) - 1);
+        profit += ctx->block_profits[block * POW2(PHASE_BLOCK_BITS) + val];
+    }
+    return profit;
+}
+
+
+void
+copula_initial_state_prep(qaoa_context_t* ctx, cmplx* angle_state) {
+    angle_state[0] = 1;
+
+    // Product state built qubit by qubit: the first 2^bit amplitudes are split according to the bit's distribution
+    for (bit_t bit = 0; bit < ctx->kp->size; bit++) {
+        const double amp_one = sqrt(ctx->prob_dist_vals[bit]);
+        const double amp_zero = sqrt(1 - ctx->prob_dist_vals[bit]);
+        for (size_t idx = 0; idx < POW2(bit); ++idx) {
+            angle_state[idx + POW2(bit)] = angle_state[idx] * amp_one;
+            angle_state[idx] *= amp_zero;
+        }
+    }
+}
+
+
 void
 apply_r_dist(
-    cbs_t* angle_state,
+    qaoa_context_t* ctx,
+    cmplx* angle_state,
     const num_t qubit1,
     const num_t qubit2,
     const double d1,
     const double d2given1,
     const double d2givennot1
 ) {
-    apply_ry(angle_state, qubit1, d1);
-    apply_cry(angle_state, qubit1, qubit2, 1, d2given1);
-    apply_cry(angle_state, qubit1, qubit2, 0, d2givennot1);
+    apply_ry(ctx, angle_state, qubit1, d1);
+    apply_cry(ctx, angle_state, qubit1, qubit2, 1, d2given1);
+    apply_cry(ctx, angle_state, qubit1, qubit2, 0, d2givennot1);
 }
 
 
 void
 apply_r_dist_inv(
-    cbs_t* angle_state,
+    qaoa_context_t* ctx,
+    cmplx* angle_state,
     const num_t qubit1,
     const num_t qubit2,
     const double d1,
     const double d2given1,
     const double d2givennot1
 ) {
-    apply_cry_inv(angle_state, qubit1, qubit2, 0, d2givennot1);
-    apply_cry_inv(angle_state, qubit1, qubit2, 1, d2given1);
-    apply_ry_inv(angle_state, qubit1, d1);
+    apply_cry_inv(ctx, angle_state, qubit1, qubit2, 0, d2givennot1);
+    apply_cry_inv(ctx, angle_state, qubit1, qubit2, 1, d2given1);
+    apply_ry_inv(ctx, angle_state, qubit1, d1);
 }
 
 
 void
-apply_two_copula(cbs_t* angle_state, const int qubit1, const int qubit2, const double beta) {
-    const double d1 = prob_dist_vals[qubit1];
-    const double d2 = prob_dist_vals[qubit2];
+apply_two_copula(qaoa_context_t* ctx, cmplx* angle_state, const int qubit1, const int qubit2, const double beta) {
+    const double d1 = ctx->prob_dist_vals[qubit1];
+    const double d2 = ctx->prob_dist_vals[qubit2];
+
+    const double d2given1 = d2 + ctx->theta * d2 * (1 - d1) * (1 - d2);
+    const double d2givennot1 = d2 - ctx->theta * d1 * d2 * (1 - d2);
+
+    apply_r_dist_inv(ctx, angle_state, qubit1, qubit2, d1, d2given1, d2givennot1);
+    apply_rz(ctx, angle_state, qubit1, 2 * beta);
+    apply_rz(ctx, angle_state, qubit2, 2 * beta);
+    apply_r_dist(ctx, angle_state, qubit1, qubit2, d1, d2given1, d2givennot1);
+}
 
-    const double d2given1 = d2 + theta * d2 * (1 - d1) * (1 - d2);
-    const double d2givennot1 = d2 - theta * d1 * d2 * (1 - d2);
 
-    apply_r_dist_inv(angle_state, qubit1, qubit2, d1, d2given1, d2givennot1);
-    apply_rz(angle_state, qubit1, 2 * beta);
-    apply_rz(angle_state, qubit2, 2 * beta);
-    apply_r_dist(angle_state, qubit1, qubit2, d1, d2given1, d2givennot1);
+int
+copula_mixer_pairs(const bit_t size, int pairs[][2]) {
+    const bool_t size_even = size % 2 == 0;
+    int num_pairs = 0;
+
+    // First layer couples (1, 2), (3, 4), ..., second layer (0, 1), (2, 3), ...; the ring is closed by (size - 1, 0)
+    for (bit_t qubit = 1; qubit <= size - (size_even ? 3 : 2); qubit += 2) {
+        pairs[num_pairs][0] = qubit;
+        pairs[num_pairs++][1] = qubit + 1;
+    }
+    if (size_even) {
+        pairs[num_pairs][0] = size - 1;
+        pairs[num_pairs++][1] = 0;
+    }
+
+    for (bit_t qubit = 0; qubit <= size - (size_even ? 2 : 3); qubit += 2) {
+        pairs[num_pairs][0] = qubit;
+        pairs[num_pairs++][1] = qubit + 1;
+    }
+    if (!size_even) {
+        pairs[num_pairs][0] = size - 1;
+        pairs[num_pairs++][1] = 0;
+    }
+    return num_pairs;
 }
 
 
 void
-copula_mixer(cbs_t* angle_state, const double beta) {
-    const bool_t kp_size_even = {kp->size % 2 == 0};
+copula_mixer(qaoa_context_t* ctx, cmplx* angle_state, const double beta) {
+    int pairs[ctx->kp->size][2];
+    const int num_pairs = copula_mixer_pairs(ctx->kp->size, pairs);
+
+    for (int pair = 0; pair < num_pairs; ++pair) {
+        apply_two_copula(ctx, angle_state, pairs[pair][0], pairs[pair][1], beta);
+    }
+}
+
+
+/*
+ * Function:            mult_gate
+ * --------------------
+ * Description:         Left-multiplies a 4x4 matrix onto another one, i.e. applies a gate after the product so far.
+ */
+static void
+mult_gate(const cmplx gate[16], cmplx product[16]) {
+    cmplx result[16];
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            result[row * 4 + col] = 0;
+            for (int idx = 0; idx < 4; ++idx) {
+                result[row * 4 + col] += gate[row * 4 + idx] * product[idx * 4 + col];
+            }
+        }
+    }
+    memcpy(product, result, sizeof(result));
+}
+
 
-    for (bit_t qubit = 1; qubit <= (kp->size - kp_size_even ? 3 : 2); qubit += 2) {
-        apply_two_copula(angle_state, qubit, qubit + 1, beta);
+/*
+ * Function:            ry_gate
+ * --------------------
+ * Description:         4x4 matrix of a (possibly controlled, possibly inverse) y-rotation on |s_1 + 2 s_2>; control < 0
+ *                      rotates qubit 1 unconditionally, otherwise qubit 2 is rotated if qubit 1 equals control.
+ */
+static void
+ry_gate(const int control, const double prob, const bool_t inverse, cmplx gate[16]) {
+    const double sign = inverse ? -1. : 1.;
+    memset(gate, 0, 16 * sizeof(cmplx));
+    for (int x = 0; x < 4; ++x) {
+        gate[x * 4 + x] = 1;
     }
-    if (kp_size_even) {
-        apply_two_copula(angle_state, kp->size - 1, 0, beta);
+    for (int other = 0; other < 2; ++other) {
+        if (control >= 0 && other != control) {
+            continue;
+        }
+        const int x0 = control < 0 ? 2 * other : other;
+        const int x1 = control < 0 ? 2 * other + 1 : other + 2;
+        gate[x0 * 4 + x0] = sqrt(1 - prob);
+        gate[x0 * 4 + x1] = - sign * sqrt(prob);
+        gate[x1 * 4 + x0] = sign * sqrt(prob);
+        gate[x1 * 4 + x1] = sqrt(1 - prob);
     }
+}
+
+
+void
+copula_gate_matrix(qaoa_context_t* ctx, const int qubit1, const int qubit2, const double beta, cmplx gate[16]) {
+    const double d1 = ctx->prob_dist_vals[qubit1];
+    const double d2 = ctx->prob_dist_vals[qubit2];
+
+    const double d2given1 = d2 + ctx->theta * d2 * (1 - d1) * (1 - d2);
+    const double d2givennot1 = d2 - ctx->theta * d1 * d2 * (1 - d2);
 
-    for (bit_t qubit = 0; qubit <= (kp->size - kp_size_even ? 2 : 3); qubit += 2) {
-        apply_two_copula(angle_state, qubit, qubit + 1, beta);
+    cmplx factor[16];
+    memset(gate, 0, 16 * sizeof(cmplx));
+    for (int x = 0; x < 4; ++x) {
+        gate[x * 4 + x] = 1;
     }
-    if (!kp_size_even) {
-        apply_two_copula(angle_state, kp->size - 1, 0, beta);
+
+    // Same sequence as apply_two_copula
+    ry_gate(0, d2givennot1, TRUE, factor);
+    mult_gate(factor, gate);
+    ry_gate(1, d2given1, TRUE, factor);
+    mult_gate(factor, gate);
+    ry_gate(-1, d1, TRUE, factor);
+    mult_gate(factor, gate);
+
+    memset(factor, 0, sizeof(factor));
+    for (int x = 0; x < 4; ++x) {
+        const int ones = (x & 1) + (x >> 1);
+        factor[x * 4 + x] = cexp(I * 2 * beta * (2 * ones - 2)); // One rz(2 beta) on each qubit
     }
+    mult_gate(factor, gate);
+
+    ry_gate(-1, d1, FALSE, factor);
+    mult_gate(factor, gate);
+    ry_gate(1, d2given1, FALSE, factor);
+    mult_gate(factor, gate);
+    ry_gate(0, d2givennot1, FALSE, factor);
+    mult_gate(factor, gate);
 }
 
 
@@ -325,42 +815,124 @@ copula_mixer(cbs_t* angle_state, const double beta) {
  */
 
 void
-phase_separation_unitary(cbs_t *angle_state, double gamma) {
-    for (size_t idx = 0; idx < num_states; ++idx) {
-        angle_state[idx].amplitude *= cexp(-I * gamma * angle_state[idx].profit);
+phase_separation_unitary(qaoa_context_t* ctx, cmplx *angle_state, double gamma) {
+    if (ctx->block_profits != NULL) {
+        factorised_phase_separation(ctx, angle_state, gamma);
+        return;
+    }
+    const int num_threads = kernel_threads(ctx);
+    switch (ctx->sol_profits.width) { // Specialised per width so that the profits are streamed without conversion calls
+        case PROFIT_8:
+            PROFIT_PHASE_LOOP(uint8_t);
+            break;
+        case PROFIT_16:
+            PROFIT_PHASE_LOOP(uint16_t);
+            break;
+        case PROFIT_32:
+            PROFIT_PHASE_LOOP(uint32_t);
+            break;
+        case PROFIT_64:
+            PROFIT_PHASE_LOOP(num_t);
+            break;
+    }
+}
+
+
+void
+factorised_phase_separation(qaoa_context_t* ctx, cmplx *angle_state, double gamma) {
+    const size_t block_size = MIN(POW2(PHASE_BLOCK_BITS), ctx->num_states);
+    cmplx phase_tables[ctx->num_phase_blocks][POW2(PHASE_BLOCK_BITS)];
+
+    // Only num_phase_blocks * 2^PHASE_BLOCK_BITS complex exponentials instead of one per amplitude
+    for (int block = 0; block < ctx->num_phase_blocks; ++block) {
+        for (size_t val = 0; val < block_size; ++val) {
+            phase_tables[block][val] = cexp(-I * gamma * ctx->block_profits[block * POW2(PHASE_BLOCK_BITS) + val]);
+        }
+    }
+
+    const int num_threads = kernel_threads(ctx);
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t high = 0; high < ctx->num_states; high += block_size) {
+        // Phase contributed by all but the lowest block is constant along the inner loop
+        cmplx high_phase = 1;
+        for (int block = 1; block < ctx->num_phase_blocks; ++block) {
+            high_phase *= phase_tables[block][(high >> (block * PHASE_BLOCK_BITS)) & (POW2(PHASE_BLOCK_BITS) - 1)];
+        }
+        cmplx* row = angle_state + high;
+        for (size_t low = 0; low < block_size; ++low) {
+            row[low] *= high_phase * phase_tables[0][low];
+        }
     }
 }
 
 
-cbs_t *
-quasiadiabatic_evolution(const double *angles) {
-    void (*initial_state_prep)(cbs_t*);
-    void (*mixing_unitary)(cbs_t*, double);
-    switch (qaoa_type) {
+void
+prepare_initial_state(qaoa_context_t* ctx) {
+    ctx->initial_state = malloc(ctx->num_states * sizeof(cmplx));
+    switch (ctx->qaoa_type) {
         case QTG:
-            initial_state_prep = qtg_initial_state_prep;
-            mixing_unitary = qtg_grover_mixer;
+            qtg_initial_state_prep(ctx, ctx->initial_state);
             break;
         case COPULA:
-            initial_state_prep = copula_initial_state_prep;
-            mixing_unitary = copula_mixer;
+            copula_initial_state_prep(ctx, ctx->initial_state);
             break;
     }
+}
+
+
+void
+restore_initial_state(qaoa_context_t* ctx, cmplx* angle_state) {
+    const size_t num_chunks = (ctx->num_states + COPY_CHUNK - 1) / COPY_CHUNK;
+    const int num_threads = kernel_threads(ctx);
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+        const size_t start = chunk * COPY_CHUNK;
+        const size_t stop = MIN(COPY_CHUNK, ctx->num_states - start);
+        memcpy(angle_state + start, ctx->initial_state + start, stop * sizeof(cmplx));
+    }
+}
+
+
+void
+evolve_state(qaoa_context_t* ctx, cmplx* angle_state, const double* angles) {
+    void (*mixing_unitary)(qaoa_context_t*, cmplx*, double) = ctx->qaoa_type == QTG ? qtg_grover_mixer : copula_mixer;
 
-    cbs_t* angle_state = malloc(num_states * sizeof(cbs_t));
-    initial_state_prep(angle_state);
+    restore_initial_state(ctx, angle_state);
 
-    for (int j = 0; j < depth; ++j) {
+    for (int j = 0; j < ctx->depth; ++j) {
         // gamma values are even positions in angles since starting at index 0
-        phase_separation_unitary(angle_state, angles[2 * j]);
+        phase_separation_unitary(ctx, angle_state, angles[2 * j]);
         // beta values are odd positions in angles since starting at index 0
-        mixing_unitary(angle_state, angles[2 * j + 1]);
-
+        mixing_unitary(ctx, angle_state, angles[2 * j + 1]);
     }
+}
+
+
+cmplx *
+quasiadiabatic_evolution(qaoa_context_t* ctx, const double *angles) {
+    cmplx* angle_state = malloc(ctx->num_states * sizeof(cmplx));
+    evolve_state(ctx, angle_state, angles);
     return angle_state;
 }
 
 
+workspace_t*
+create_workspace(qaoa_context_t* ctx) {
+    workspace_t* workspace = malloc(sizeof(workspace_t));
+    workspace->ctx = ctx;
+    workspace->angle_state = ctx->options.backend == MPS ? NULL : malloc(ctx->num_states * sizeof(cmplx));
+    return workspace;
+}
+
+
+void
+free_workspace(workspace_t* workspace) {
+    free(workspace->angle_state);
+    free(workspace);
+}
+
+
 /*
  * =============================================================================
  *                                  Evaluation
@@ -368,263 +940,1693 @@ quasiadiabatic_evolution(const double *angles) {
  */
 
 double
-expectation_value(const cbs_t* angle_state) {
+expectation_value(qaoa_context_t* ctx, const cmplx* angle_state) {
     double exp_val = 0;
+    const int num_threads = kernel_threads(ctx);
 
-    for (size_t idx = 0; idx < num_states; ++idx) {
-        if (qaoa_type == COPULA) {
-            if (!sol_feasibilities[idx])
-                continue; // Add 0 in case that solution is infeasible (modified objective function)
+    #pragma omp parallel for schedule(static) num_threads(num_threads) if(num_threads > 1) reduction(+:exp_val)
+    for (size_t word = 0; word < (ctx->num_states + 63) / 64; ++word) {
+        const uint64_t mask = feasibility_word(ctx, word);
+        if (mask == 0) {
+            continue; // Infeasible solutions contribute 0 (modified objective function)
+        }
+        const size_t stop = MIN(64, ctx->num_states - word * 64);
+        for (size_t bit = 0; bit < stop; ++bit) {
+            const size_t idx = word * 64 + bit;
+            exp_val += (double) (mask >> bit & 1) * prob_for_amplitude(angle_state, idx) * state_profit(ctx, idx);
         }
-
-        const double prob = prob_for_amplitude(angle_state, idx);
-        exp_val += prob * angle_state[idx].profit;
     }
     return exp_val;
 }
 
 
-double
-angles_to_value(const double* angles) {
-    cbs_t *angle_state = quasiadiabatic_evolution(angles);
+mps_t*
+mps_quasiadiabatic_evolution(qaoa_context_t* ctx, const double* angles) {
+    mps_t* mps = create_product_mps(ctx->kp->size, ctx->prob_dist_vals, ctx->options.max_bond_dim);
+    int pairs[ctx->kp->size][2];
+    const int num_pairs = copula_mixer_pairs(ctx->kp->size, pairs);
+    cmplx gate[16];
+
+    for (int j = 0; j < ctx->depth; ++j) {
+        // Linear phase separation unitary as a product of single-qubit phases
+        for (bit_t qubit = 0; qubit < ctx->kp->size; ++qubit) {
+            mps_apply_phase(mps, qubit, cexp(-I * angles[2 * j] * ctx->kp->items[qubit].profit));
+        }
+        for (int pair = 0; pair < num_pairs; ++pair) {
+            copula_gate_matrix(ctx, pairs[pair][0], pairs[pair][1], angles[2 * j + 1], gate);
+            mps_apply_two_qubit(mps, pairs[pair][0], pairs[pair][1], gate);
+        }
+    }
+    return mps;
+}
+
 
-    const double exp_value = expectation_value(angle_state);
-    if (angle_state != NULL) {
-        free(angle_state);
+double
+workspace_value(qaoa_context_t* ctx, workspace_t* workspace, const double* angles) {
+    if (ctx->options.backend == MPS) {
+        mps_t* mps = mps_quasiadiabatic_evolution(ctx, angles);
+        const double exp_value = mps_feasible_expectation(mps, ctx->kp);
+        free_mps(mps);
+        return exp_value;
     }
-    return exp_value;
+
+    evolve_state(ctx, workspace->angle_state, angles);
+    return expectation_value(ctx, workspace->angle_state);
+}
+
+
+double
+angles_to_value(qaoa_context_t* ctx, const double* angles) {
+    return workspace_value(ctx, ctx->eval_workspace, angles);
 }
 
 
 /*
  * =============================================================================
- *                                Optimization
+ *                            Budgets and tracing
  * =============================================================================
  */
 
-double
-angles_to_value_nlopt(unsigned n, const double *angles, double *grad, void *my_func_data) {
-    // grad is NULL bcs both Nelder Mead and Powell are derivative-free algorithms
-    return -angles_to_value(angles);
+void
+start_trace(qaoa_context_t* ctx) {
+    free(ctx->eval_trace.records);
+    memset(&ctx->eval_trace, 0, sizeof(trace_t));
+    ctx->eval_trace.start_time = wall_time();
 }
 
 
-nlopt_algorithm
-map_enum_to_nlopt_algorithm(const opt_t opt_type) {
-    switch (opt_type) {
-        case NELDER_MEAD:
-            return NLOPT_LN_NELDERMEAD;
-        case POWELL:
-            return NLOPT_LN_BOBYQA; // or another suitable algorithm for POWELL
-        case BFGS:
-            return NLOPT_LD_LBFGS;  // Limited-memory BFGS
-        default:
-            // Cannot happen because main function is interrupted in case of a non-matching optimization type
-            printf("No matching classical optimizer.");
-            return -1;
+size_t
+remaining_evals(qaoa_context_t* ctx) {
+    if (ctx->options.max_evals == 0) {
+        return SIZE_MAX;
     }
+    const size_t max_evals = ctx->options.max_evals;
+    const size_t num_evals = ctx->checkpoint.prior_evals + ctx->eval_trace.num_evals; // Including resumed ones
+    return num_evals < max_evals ? max_evals - num_evals : 0;
 }
 
 
-void
-fine_grid_search(const int m, double* best_angles, double* best_value) {
-    const double step_size = 2 * M_PI / m;
-    double angles[2 * depth];
-    *best_value = -INFINITY;
+double
+remaining_time(qaoa_context_t* ctx) {
+    if (ctx->options.max_time == 0) {
+        return INFINITY;
+    }
+    return MAX(ctx->options.max_time - (wall_time() - ctx->eval_trace.start_time), 0);
+}
+
 
-    for (int j = 0; j < 2 * depth; j++) {
-        angles[j] = 0; // Set all angles to 0 initially to prepare layer-wise fine-grid search
+bool_t
+budget_left(qaoa_context_t* ctx) {
+    if (remaining_evals(ctx) == 0 || remaining_time(ctx) == 0) {
+        ctx->eval_trace.exhausted = TRUE;
+        return FALSE;
     }
+    return TRUE;
+}
 
-    for (int j = 0; j < depth; j++) { // Iterate over pairs of angles
-        for (int s1 = 0; s1 < m; ++s1) { // Iterate over m choices for gamma value
-            angles[2*j] = s1 * step_size;
-            for (int s2 = 0; s2 < m; ++s2) { // Iterate over m choices for beta value
-                angles[2*j+1] = s2 * step_size;
 
-                const double value = angles_to_value(angles);
-                if (value > *best_value) {
-                    *best_value = value;
-                    best_angles[2*j] = angles[2*j];
-                    best_angles[2*j+1] = angles[2*j+1];
-                }
+double
+traced_value(qaoa_context_t* ctx, workspace_t* workspace, const double* angles) {
+    double value;
+    if (cache_lookup(ctx, angles, &value)) {
+        return value; // Neither evaluated nor traced, so repeats do not count towards the budgets
+    }
+    value = workspace_value(ctx, workspace, angles);
+    cache_insert(ctx, angles, value);
+    const double elapsed = wall_time() - ctx->eval_trace.start_time;
+    const size_t record_size = 2 + 2 * ctx->depth;
+    char* snapshot = NULL;
+    size_t snapshot_size = 0;
+
+    #pragma omp critical(eval_trace)
+    {
+        if (ctx->eval_trace.num_evals == ctx->eval_trace.capacity) {
+            ctx->eval_trace.capacity = MAX(2 * ctx->eval_trace.capacity, 1024);
+            const size_t num_bytes = ctx->eval_trace.capacity * record_size * sizeof(double);
+            ctx->eval_trace.records = realloc(ctx->eval_trace.records, num_bytes);
+        }
+        double* record = ctx->eval_trace.records + ctx->eval_trace.num_evals * record_size;
+        record[0] = elapsed;
+        record[1] = value;
+        memcpy(record + 2, angles, 2 * ctx->depth * sizeof(double));
+        ++ctx->eval_trace.num_evals;
+
+        if (ctx->checkpoint.path != NULL) {
+            if (value > ctx->checkpoint.best_value) {
+                ctx->checkpoint.best_value = value;
+                memcpy(ctx->checkpoint.best_angles, angles, 2 * ctx->depth * sizeof(double));
+            }
+            if (wall_time() - ctx->checkpoint.last_write >= CHECKPOINT_INTERVAL) {
+                snapshot = checkpoint_snapshot(ctx, &snapshot_size);
+                ctx->checkpoint.last_write = wall_time(); // Claimed, so that no other thread writes it as well
             }
         }
-        angles[2*j] = best_angles[2*j]; // Keep best angles found in this layer
-        angles[2*j+1] = best_angles[2*j+1]; // Keep best angles found in this layer
     }
+    if (snapshot != NULL) { // The file is written outside, so that the other threads go on evaluating meanwhile
+        store_checkpoint(ctx->checkpoint.path, snapshot, snapshot_size);
+        free(snapshot);
+    }
+    return value;
 }
 
 
-double*
-nlopt_optimizer(const opt_t optimization_type, const int m, const int memory_size) {
-    const nlopt_algorithm nlopt_optimization_algorithm = map_enum_to_nlopt_algorithm(optimization_type);
-    const nlopt_opt opt = nlopt_create(nlopt_optimization_algorithm, 2 * depth);
-    double* angles = malloc(2 * depth * sizeof(double));
-    double best_value;
-    double lower_bounds[2 * depth];
-    double upper_bounds[2 * depth];
-
-    // Set your optimization parameters
-    nlopt_set_xtol_rel(opt, 1e-6);
-
-    // Set the objective function
-    nlopt_set_min_objective(opt, angles_to_value_nlopt, NULL);
+/*
+ * =============================================================================
+ *                                 Memo cache
+ * =============================================================================
+ */
+
+void
+create_eval_cache(qaoa_context_t* ctx, const size_t max_bytes) {
+    free_eval_cache(ctx);
+    ctx->eval_cache.key_size = 2 * ctx->depth;
+    const size_t slot_bytes = (ctx->eval_cache.key_size + 1) * sizeof(double) + 1;
+    ctx->eval_cache.num_slots = 0;
+    if (max_bytes >= slot_bytes) { // Largest power of two of slots within the bytes, so that hashes are masked
+        ctx->eval_cache.num_slots = 1;
+        while (2 * ctx->eval_cache.num_slots * slot_bytes <= max_bytes) {
+            ctx->eval_cache.num_slots *= 2;
+        }
+        ctx->eval_cache.entries = malloc(ctx->eval_cache.num_slots * (ctx->eval_cache.key_size + 1) * sizeof(double));
+        ctx->eval_cache.used = calloc(ctx->eval_cache.num_slots, sizeof(unsigned char));
+    }
+}
+
+
+void
+free_eval_cache(qaoa_context_t* ctx) {
+    free(ctx->eval_cache.entries);
+    free(ctx->eval_cache.used);
+    memset(&ctx->eval_cache, 0, sizeof(memo_cache_t));
+}
+
+
+static size_t
+cache_slot(qaoa_context_t* ctx, const double* angles) {
+    // FNV-1a over the bytes of the angles, so that the key is bit-exact
+    const unsigned char* bytes = (const unsigned char*) angles;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t byte = 0; byte < ctx->eval_cache.key_size * sizeof(double); ++byte) {
+        hash = (hash ^ bytes[byte]) * 1099511628211ULL;
+    }
+    return (size_t) (hash ^ hash >> 32) & (ctx->eval_cache.num_slots - 1);
+}
+
+
+bool_t
+cache_lookup(qaoa_context_t* ctx, const double* angles, double* value) {
+    if (ctx->eval_cache.num_slots == 0) {
+        return FALSE;
+    }
+    const size_t home = cache_slot(ctx, angles);
+    const size_t key_bytes = ctx->eval_cache.key_size * sizeof(double);
+    bool_t found = FALSE;
+
+    #pragma omp critical(eval_cache)
+    {
+        for (size_t probe = 0; probe < MEMO_CACHE_PROBES && !found; ++probe) {
+            const size_t slot = (home + probe) & (ctx->eval_cache.num_slots - 1);
+            if (!ctx->eval_cache.used[slot]) {
+                break; // Keys are never removed from a run of probes, so the key is not cached
+            }
+            const double* entry = ctx->eval_cache.entries + slot * (ctx->eval_cache.key_size + 1);
+            if (memcmp(entry, angles, key_bytes) == 0) {
+                *value = entry[ctx->eval_cache.key_size];
+                found = TRUE;
+            }
+        }
+        ++*(found ? &ctx->eval_cache.hits : &ctx->eval_cache.misses);
+    }
+    return found;
+}
+
+
+void
+cache_insert(qaoa_context_t* ctx, const double* angles, const double value) {
+    if (ctx->eval_cache.num_slots == 0) {
+        return;
+    }
+    const size_t home = cache_slot(ctx, angles);
+    const size_t key_bytes = ctx->eval_cache.key_size * sizeof(double);
+
+    #pragma omp critical(eval_cache)
+    {
+        // First free slot of the probes, or else the home slot, whose previous key is evicted
+        size_t target = home;
+        for (size_t probe = 0; probe < MEMO_CACHE_PROBES; ++probe) {
+            const size_t slot = (home + probe) & (ctx->eval_cache.num_slots - 1);
+            const double* entry = ctx->eval_cache.entries + slot * (ctx->eval_cache.key_size + 1);
+            if (!ctx->eval_cache.used[slot] || memcmp(entry, angles, key_bytes) == 0) {
+                target = slot;
+                break;
+            }
+        }
+        double* entry = ctx->eval_cache.entries + target * (ctx->eval_cache.key_size + 1);
+        memcpy(entry, angles, key_bytes);
+        entry[ctx->eval_cache.key_size] = value;
+        ctx->eval_cache.used[target] = TRUE;
+    }
+}
+
+
+/*
+ * =============================================================================
+ *                                 Checkpoints
+ * =============================================================================
+ */
+
+static uint64_t
+fnv_update(uint64_t hash, const void* data, const size_t num_bytes) {
+    const unsigned char* bytes = data;
+    for (size_t byte = 0; byte < num_bytes; ++byte) {
+        hash = (hash ^ bytes[byte]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+uint64_t
+instance_hash(qaoa_context_t* ctx) {
+    // Field by field, so that padding never enters the hash
+    uint64_t hash = 14695981039346656037ULL;
+    hash = fnv_update(hash, &ctx->kp->size, sizeof(ctx->kp->size));
+    hash = fnv_update(hash, &ctx->kp->capacity, sizeof(ctx->kp->capacity));
+    for (bit_t item = 0; item < ctx->kp->size; ++item) {
+        hash = fnv_update(hash, &ctx->kp->items[item].profit, sizeof(num_t));
+        hash = fnv_update(hash, &ctx->kp->items[item].cost, sizeof(num_t));
+    }
+    if (ctx->kp_type == QUADRATIC && ctx->kp->quad_profit != NULL) {
+        hash = fnv_update(hash, ctx->kp->quad_profit, (size_t) ctx->kp->size * ctx->kp->size * sizeof(num_t));
+    }
+    hash = fnv_update(hash, &ctx->qaoa_type, sizeof(ctx->qaoa_type));
+    hash = fnv_update(hash, &ctx->bias, sizeof(ctx->bias));
+    hash = fnv_update(hash, &ctx->k, sizeof(ctx->k));
+    hash = fnv_update(hash, &ctx->theta, sizeof(ctx->theta));
+    hash = fnv_update(hash, &ctx->kp_type, sizeof(ctx->kp_type));
+    hash = fnv_update(hash, &ctx->options.backend, sizeof(ctx->options.backend));
+    hash = fnv_update(hash, &ctx->options.max_bond_dim, sizeof(ctx->options.max_bond_dim));
+    return fnv_update(hash, &ctx->num_states, sizeof(ctx->num_states));
+}
+
+
+static bool_t
+read_checkpoint(qaoa_context_t* ctx, checkpoint_header_t* header) {
+    FILE* file = fopen(ctx->checkpoint.path, "rb");
+    if (file == NULL) {
+        printf("No checkpoint found, starting from scratch\n");
+        return FALSE;
+    }
+    const size_t num_angles = 2 * ctx->depth;
+    const size_t num_starts = ctx->checkpoint.num_starts;
+    const bool_t valid = fread(header, sizeof(checkpoint_header_t), 1, file) == 1
+        && memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) == 0
+        && header->version == CHECKPOINT_VERSION
+        && header->depth == (uint32_t) ctx->depth
+        && header->m == (uint32_t) ctx->m
+        && header->grid == (uint32_t) ctx->options.grid
+        && header->num_starts == (uint32_t) num_starts
+        && header->instance_hash == ctx->checkpoint.instance_hash
+        && fread(ctx->checkpoint.best_angles, sizeof(double), num_angles, file) == num_angles
+        && fread(ctx->checkpoint.starts, sizeof(double), num_starts * num_angles, file) == num_starts * num_angles
+        && fread(ctx->checkpoint.start_values, sizeof(double), num_starts, file) == num_starts;
+    fclose(file);
+    if (!valid) {
+        printf("Checkpoint does not match the run, starting from scratch\n");
+    }
+    return valid;
+}
+
+
+void
+open_checkpoint(qaoa_context_t* ctx, const char* instance) {
+    checkpoint_t* checkpoint = &ctx->checkpoint;
+    memset(checkpoint, 0, sizeof(checkpoint_t));
+    checkpoint->path = path_to_storage(ctx, instance);
+    strcat(checkpoint->path, "checkpoint.bin");
+    checkpoint->instance_hash = instance_hash(ctx);
+    checkpoint->num_starts = (int) MIN((size_t) ctx->options.num_starts, (size_t) ctx->m * ctx->m);
+    checkpoint->starts = calloc((size_t) checkpoint->num_starts * 2 * ctx->depth, sizeof(double));
+    checkpoint->start_values = malloc(checkpoint->num_starts * sizeof(double));
+    checkpoint->best_angles = calloc(2 * ctx->depth, sizeof(double));
+    checkpoint->best_value = -INFINITY;
+    checkpoint->last_write = wall_time();
+
+    checkpoint_header_t header;
+    if (!ctx->options.resume || !read_checkpoint(ctx, &header)) { // A rejected checkpoint may have been read partly
+        memset(checkpoint->starts, 0, (size_t) checkpoint->num_starts * 2 * ctx->depth * sizeof(double));
+        memset(checkpoint->best_angles, 0, 2 * ctx->depth * sizeof(double));
+        checkpoint->start_values[0] = -INFINITY;
+        return;
+    }
+    checkpoint->resumed = TRUE;
+    checkpoint->completed_layers = (int) header.completed_layers;
+    checkpoint->search_done = header.search_done != 0;
+    checkpoint->best_value = header.best_value;
+    checkpoint->prior_evals = header.num_evals;
+    ctx->eval_trace.start_time -= header.elapsed; // The seconds of earlier processes count towards max_time
+    if (checkpoint->search_done) {
+        printf("Resuming from checkpoint after the grid search and %zu evaluations\n", checkpoint->prior_evals);
+    } else {
+        printf("Resuming from checkpoint after %d of %d layers and %zu evaluations\n", checkpoint->completed_layers,
+               ctx->depth, checkpoint->prior_evals);
+    }
+}
+
+
+char*
+checkpoint_snapshot(qaoa_context_t* ctx, size_t* num_bytes) {
+    const checkpoint_t* checkpoint = &ctx->checkpoint;
+    const size_t num_angles = 2 * ctx->depth;
+    checkpoint_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.depth = ctx->depth;
+    header.m = ctx->m;
+    header.grid = ctx->options.grid;
+    header.num_starts = checkpoint->num_starts;
+    header.completed_layers = checkpoint->completed_layers;
+    header.search_done = checkpoint->search_done;
+    header.instance_hash = checkpoint->instance_hash;
+    header.num_evals = checkpoint->prior_evals + ctx->eval_trace.num_evals;
+    header.elapsed = wall_time() - ctx->eval_trace.start_time;
+    header.best_value = checkpoint->best_value;
+
+    // Laid out as in the file: header, best angles, starts, start values
+    *num_bytes = sizeof(header) + (1 + (size_t) checkpoint->num_starts) * num_angles * sizeof(double)
+        + checkpoint->num_starts * sizeof(double);
+    char* snapshot = malloc(*num_bytes);
+    char* pos = snapshot;
+    memcpy(pos, &header, sizeof(header));
+    pos += sizeof(header);
+    memcpy(pos, checkpoint->best_angles, num_angles * sizeof(double));
+    pos += num_angles * sizeof(double);
+    memcpy(pos, checkpoint->starts, (size_t) checkpoint->num_starts * num_angles * sizeof(double));
+    pos += (size_t) checkpoint->num_starts * num_angles * sizeof(double);
+    memcpy(pos, checkpoint->start_values, checkpoint->num_starts * sizeof(double));
+    return snapshot;
+}
+
+
+void
+store_checkpoint(const char* path, const char* snapshot, const size_t num_bytes) {
+    #pragma omp critical(checkpoint_file)
+    {
+        char temp_path[1100];
+        sprintf(temp_path, "%s.tmp", path);
+        FILE* file = fopen(temp_path, "wb");
+        if (file != NULL) { // Otherwise, the run goes on without checkpoints rather than failing
+            fwrite(snapshot, 1, num_bytes, file);
+            fclose(file);
+#if defined(_WIN32) || defined(_WIN64)
+            remove(path); // Renaming does not replace existing files on Windows
+#endif
+            rename(temp_path, path);
+        }
+    }
+}
+
+
+void
+write_checkpoint(qaoa_context_t* ctx) {
+    if (ctx->checkpoint.path == NULL) {
+        return;
+    }
+    size_t num_bytes;
+    char* snapshot = checkpoint_snapshot(ctx, &num_bytes);
+    store_checkpoint(ctx->checkpoint.path, snapshot, num_bytes);
+    free(snapshot);
+    ctx->checkpoint.last_write = wall_time();
+}
+
+
+void
+checkpoint_layers(qaoa_context_t* ctx, const int completed_layers, const double* best_angles, const double best_value) {
+    if (ctx->checkpoint.path == NULL) {
+        return;
+    }
+    ctx->checkpoint.completed_layers = completed_layers;
+    memcpy(ctx->checkpoint.starts, best_angles, 2 * ctx->depth * sizeof(double));
+    ctx->checkpoint.start_values[0] = best_value;
+    write_checkpoint(ctx);
+}
+
+
+void
+checkpoint_search(qaoa_context_t* ctx, const double* starts, const double* start_values) {
+    if (ctx->checkpoint.path == NULL) {
+        return;
+    }
+    ctx->checkpoint.completed_layers = ctx->depth;
+    ctx->checkpoint.search_done = TRUE;
+    memcpy(ctx->checkpoint.starts, starts, (size_t) ctx->checkpoint.num_starts * 2 * ctx->depth * sizeof(double));
+    memcpy(ctx->checkpoint.start_values, start_values, ctx->checkpoint.num_starts * sizeof(double));
+    write_checkpoint(ctx);
+}
+
+
+void
+close_checkpoint(qaoa_context_t* ctx) {
+    if (ctx->checkpoint.path == NULL) {
+        return;
+    }
+    remove(ctx->checkpoint.path);
+    free(ctx->checkpoint.path);
+    free(ctx->checkpoint.starts);
+    free(ctx->checkpoint.start_values);
+    free(ctx->checkpoint.best_angles);
+    memset(&ctx->checkpoint, 0, sizeof(checkpoint_t));
+}
+
+
+static int
+resume_layers(qaoa_context_t* ctx, double* best_angles, double* best_value) {
+    // The best angles of the layers a checkpoint has completed, followed by zeros, or else all zeros
+    if (ctx->checkpoint.resumed && !ctx->checkpoint.search_done) {
+        memcpy(best_angles, ctx->checkpoint.starts, 2 * ctx->depth * sizeof(double));
+        *best_value = ctx->checkpoint.start_values[0];
+        return ctx->checkpoint.completed_layers;
+    }
+    memset(best_angles, 0, 2 * ctx->depth * sizeof(double));
+    *best_value = -INFINITY;
+    return 0;
+}
+
+
+/*
+ * =============================================================================
+ *                                Optimization
+ * =============================================================================
+ */
+
+double
+angles_to_value_nlopt(unsigned n, const double *angles, double *grad, void *my_func_data) {
+    // grad is NULL bcs both Nelder Mead and Powell are derivative-free algorithms
+    workspace_t* workspace = my_func_data;
+    return -traced_value(workspace->ctx, workspace, angles);
+}
+
+
+nlopt_algorithm
+map_enum_to_nlopt_algorithm(const opt_t opt_type) {
+    switch (opt_type) {
+        case NELDER_MEAD:
+            return NLOPT_LN_NELDERMEAD;
+        case POWELL:
+            return NLOPT_LN_BOBYQA; // or another suitable algorithm for POWELL
+        case BFGS:
+            return NLOPT_LD_LBFGS;  // Limited-memory BFGS
+        default:
+            // Cannot happen because main function is interrupted in case of a non-matching optimization type
+            printf("No matching classical optimizer.");
+            return -1;
+    }
+}
+
+
+void
+compute_gamma_period(qaoa_context_t* ctx) {
+    num_t divisor = 0;
+    if (ctx->sol_profits.data != NULL) { // Profits of all simulated states
+        for (size_t idx = 0; idx < ctx->num_states && divisor != 1; ++idx) {
+            divisor = gcd(divisor, get_profit(&ctx->sol_profits, idx));
+        }
+    } else { // Linear Copula instances: every subset of items is a state
+        for (bit_t item = 0; item < ctx->kp->size && divisor != 1; ++item) {
+            divisor = gcd(divisor, ctx->kp->items[item].profit);
+        }
+    }
+    ctx->gamma_period = divisor > 0 ? 2 * M_PI / divisor : 2 * M_PI;
+}
+
+
+void
+canonicalize_angles(qaoa_context_t* ctx, double* angles) {
+    for (int j = 0; j < ctx->depth; ++j) {
+        angles[2 * j] = fmod(fmod(angles[2 * j], ctx->gamma_period) + ctx->gamma_period, ctx->gamma_period);
+        angles[2 * j + 1] = fmod(fmod(angles[2 * j + 1], 2 * M_PI) + 2 * M_PI, 2 * M_PI);
+    }
+    if (angles[0] > ctx->gamma_period / 2) { // Complex conjugate of the evolution, which has the same expectation value
+        for (int j = 0; j < ctx->depth; ++j) {
+            angles[2 * j] = angles[2 * j] > 0 ? ctx->gamma_period - angles[2 * j] : 0;
+            angles[2 * j + 1] = angles[2 * j + 1] > 0 ? 2 * M_PI - angles[2 * j + 1] : 0;
+        }
+    }
+}
+
+
+size_t
+workspace_budget(const run_options_t* options) {
+    const double memory = options->max_memory > 0 ? (double) options->max_memory : (double) physical_memory();
+    return (size_t) (WORKSPACE_MEMORY_SHARE * memory);
+}
+
+
+int
+workspace_threads(qaoa_context_t* ctx, const size_t num_tasks) {
+    int num_threads = 1;
+#ifdef _OPENMP
+    // Every thread owns a workspace, so large state vectors limit the threads; the kernels share the others instead
+    const size_t workspace_bytes = ctx->options.backend == MPS ? 0 : ctx->num_states * sizeof(cmplx);
+    num_threads = omp_get_max_threads();
+    if (workspace_bytes > 0) {
+        num_threads = (int) MIN((size_t) num_threads, MAX(workspace_budget(&ctx->options) / workspace_bytes, 1));
+    }
+    omp_set_max_active_levels(2); // Lets every thread of the batch open a team for its kernels
+#endif
+    return (int) MAX(MIN((size_t) num_threads, num_tasks), 1);
+}
+
+
+void
+evaluate_angle_batch(qaoa_context_t* ctx, const double* batch, const size_t num_points, double* values) {
+    // Points beyond the budgets are not evaluated and can never be the best ones
+    const size_t num_allowed = MIN(num_points, remaining_evals(ctx));
+    const size_t evals_before = ctx->eval_trace.num_evals;
+    const int num_threads = workspace_threads(ctx, num_allowed);
+    size_t num_skipped = 0;
+
+    #pragma omp parallel num_threads(num_threads) reduction(+:num_skipped)
+    {
+        workspace_t* workspace = num_threads > 1 ? create_workspace(ctx) : ctx->eval_workspace;
+        #pragma omp for schedule(dynamic)
+        for (size_t point = 0; point < num_points; ++point) {
+            if (point < num_allowed && remaining_time(ctx) > 0) {
+                values[point] = traced_value(ctx, workspace, batch + point * 2 * ctx->depth);
+            } else {
+                values[point] = -INFINITY;
+                ++num_skipped;
+            }
+        }
+        if (workspace != ctx->eval_workspace) {
+            free_workspace(workspace);
+        }
+    }
+
+    // Cached points are not evaluated again, so only the skipped ones tell that a budget is exhausted
+    ctx->eval_trace.num_search_evals += ctx->eval_trace.num_evals - evals_before;
+    if (num_skipped > 0) {
+        ctx->eval_trace.exhausted = TRUE;
+    }
+}
+
+
+static void
+select_runners_up(
+    qaoa_context_t* ctx,
+    const double* batch,
+    const double* values,
+    const size_t num_points,
+    const int num_candidates,
+    double* best_angles,
+    double* best_values
+) {
+    size_t best_points[num_candidates];
+    int num_found = 1;
+    for (size_t point = 0; point < num_points && num_candidates > 1; ++point) {
+        const double* angles = batch + point * 2 * ctx->depth;
+        if (memcmp(angles, best_angles, 2 * ctx->depth * sizeof(double)) == 0) {
+            continue;
+        }
+        // Insertion into the sorted runners-up; equal values keep grid order
+        int pos = num_found;
+        while (pos > 1 && values[point] > best_values[pos - 1]) {
+            --pos;
+        }
+        if (pos == num_candidates) {
+            continue;
+        }
+        const int last = MIN(num_found, num_candidates - 1);
+        for (int cand = last; cand > pos; --cand) {
+            best_values[cand] = best_values[cand - 1];
+            best_points[cand] = best_points[cand - 1];
+        }
+        best_values[pos] = values[point];
+        best_points[pos] = point;
+        num_found = MIN(num_found + 1, num_candidates);
+    }
+    for (int cand = 1; cand < num_found; ++cand) {
+        memcpy(best_angles + cand * 2 * ctx->depth, batch + best_points[cand] * 2 * ctx->depth,
+               2 * ctx->depth * sizeof(double));
+    }
+    for (int cand = num_found; cand < num_candidates; ++cand) { // Fewer distinct points than candidates
+        memcpy(best_angles + cand * 2 * ctx->depth, best_angles, 2 * ctx->depth * sizeof(double));
+        best_values[cand] = best_values[0];
+    }
+}
+
+
+void
+fine_grid_search(qaoa_context_t* ctx, const int m, const int num_candidates, double* best_angles, double* best_values) {
+    const double gamma_step = ctx->gamma_period / m;
+    const double beta_step = 2 * M_PI / m;
+    size_t num_points = (size_t) m * m;
+    double* batch = malloc(num_points * 2 * ctx->depth * sizeof(double));
+    double* values = malloc(num_points * sizeof(double));
+    double best_value;
+
+    // All angles are 0 initially to prepare layer-wise fine-grid search, unless a checkpoint has completed layers
+    const int first_layer = resume_layers(ctx, best_angles, &best_value);
+    if (first_layer == ctx->depth) {
+        num_points = 0; // The runners-up of the last layer are lost
+    }
+
+    for (int j = first_layer; j < ctx->depth; j++) { // Iterate over pairs of angles
+        // The first gamma only ranges over half a period, see canonicalize_angles
+        num_points = (size_t) (j == 0 ? m / 2 + 1 : m) * m;
+        for (size_t point = 0; point < num_points; ++point) {
+            double* angles = batch + point * 2 * ctx->depth;
+            memcpy(angles, best_angles, 2 * ctx->depth * sizeof(double)); // Best angles of the previous layers
+            angles[2*j] = (double) (point / m) * gamma_step; // m choices for gamma value per period
+            angles[2*j+1] = (double) (point % m) * beta_step; // m choices for beta value
+        }
+
+        evaluate_angle_batch(ctx, batch, num_points, values);
+
+        // Strict comparison in grid order, so that the lowest index wins ties just as in a serial search
+        size_t best_point = num_points;
+        for (size_t point = 0; point < num_points; ++point) {
+            if (values[point] > best_value) {
+                best_value = values[point];
+                best_point = point;
+            }
+        }
+        if (best_point < num_points) { // Keep best angles found in this layer
+            best_angles[2*j] = batch[best_point * 2 * ctx->depth + 2*j];
+            best_angles[2*j+1] = batch[best_point * 2 * ctx->depth + 2*j+1];
+        }
+        checkpoint_layers(ctx, j + 1, best_angles, best_value);
+    }
+    best_values[0] = best_value;
+
+    // Runners-up among the grid points of the last layer, which contains the best angles of all previous layers
+    select_runners_up(ctx, batch, values, num_points, num_candidates, best_angles, best_values);
+    free(batch);
+    free(values);
+}
+
+
+void
+adaptive_grid_search(
+    qaoa_context_t* ctx,
+    const int m,
+    const int budget,
+    const int num_candidates,
+    double* best_angles,
+    double* best_values
+) {
+    const int layer_budget = MAX(budget / ctx->depth, ADAPTIVE_MIN_LAYER_EVALS);
+    const int coarse = MAX((int) sqrt(layer_budget / 2.), 2); // Half of the budget for the coarse grid
+    const double min_step = 2 * M_PI / m / ADAPTIVE_MAX_ZOOM; // In units of beta; gamma steps scale with its period
+    const double gamma_scale = ctx->gamma_period / (2 * M_PI);
+    const size_t capacity = (size_t) MAX(layer_budget, coarse * coarse) + 8 * ADAPTIVE_REFINE_CELLS;
+    double* batch = malloc(capacity * 2 * ctx->depth * sizeof(double));
+    double* values = malloc(capacity * sizeof(double));
+    double best_value;
+    size_t num_points = 0;
+
+    // All angles are 0 initially to prepare layer-wise search, unless a checkpoint has completed layers
+    const int first_layer = resume_layers(ctx, best_angles, &best_value);
+
+    for (int j = first_layer; j < ctx->depth; j++) { // Iterate over pairs of angles
+        // Coarse uniform grid over the whole layer; the first gamma only ranges over half a period
+        double step = 2 * M_PI / coarse;
+        num_points = (size_t) (j == 0 ? coarse / 2 + 1 : coarse) * coarse;
+        for (size_t point = 0; point < num_points; ++point) {
+            double* angles = batch + point * 2 * ctx->depth;
+            memcpy(angles, best_angles, 2 * ctx->depth * sizeof(double)); // Best angles of the previous layers
+            angles[2*j] = (double) (point / coarse) * step * gamma_scale;
+            angles[2*j+1] = (double) (point % coarse) * step;
+        }
+        evaluate_angle_batch(ctx, batch, num_points, values);
+
+        // Halve the step around the best cells as long as the budget allows
+        while (num_points + 8 * ADAPTIVE_REFINE_CELLS <= (size_t) layer_budget && step / 2 >= min_step) {
+            step /= 2;
+            bool_t centers[num_points];
+            memset(centers, 0, sizeof(centers));
+            const size_t level_start = num_points;
+            for (int cell = 0; cell < ADAPTIVE_REFINE_CELLS; ++cell) {
+                size_t center = level_start;
+                for (size_t point = 0; point < level_start; ++point) { // Lowest index wins ties
+                    if (!centers[point] && (center == level_start || values[point] > values[center])) {
+                        center = point;
+                    }
+                }
+                if (center == level_start) {
+                    break;
+                }
+                centers[center] = TRUE;
+
+                for (int neighbour = 0; neighbour < 9; ++neighbour) {
+                    if (neighbour == 4) {
+                        continue; // The center itself
+                    }
+                    double* angles = batch + num_points * 2 * ctx->depth;
+                    memcpy(angles, batch + center * 2 * ctx->depth, 2 * ctx->depth * sizeof(double));
+                    angles[2*j] += (neighbour / 3 - 1) * step * gamma_scale;
+                    angles[2*j+1] += (neighbour % 3 - 1) * step;
+                    canonicalize_angles(ctx, angles); // Later layers are still 0, which the reflection preserves
+                    bool_t known = FALSE;
+                    for (size_t point = 0; point < num_points && !known; ++point) {
+                        known = fabs(batch[point * 2 * ctx->depth + 2*j] - angles[2*j]) < ADAPTIVE_SAME_ANGLE
+                            && fabs(batch[point * 2 * ctx->depth + 2*j+1] - angles[2*j+1]) < ADAPTIVE_SAME_ANGLE;
+                    }
+                    num_points += !known;
+                }
+            }
+            if (num_points == level_start) {
+                break; // All neighbours have been evaluated before
+            }
+            evaluate_angle_batch(ctx, batch + level_start * 2 * ctx->depth, num_points - level_start,
+                                 values + level_start);
+        }
+
+        size_t best_point = num_points;
+        for (size_t point = 0; point < num_points; ++point) {
+            if (values[point] > best_value) {
+                best_value = values[point];
+                best_point = point;
+            }
+        }
+        if (best_point < num_points) { // Keep best angles found in this layer
+            best_angles[2*j] = batch[best_point * 2 * ctx->depth + 2*j];
+            best_angles[2*j+1] = batch[best_point * 2 * ctx->depth + 2*j+1];
+        }
+        checkpoint_layers(ctx, j + 1, best_angles, best_value);
+    }
+    best_values[0] = best_value;
+
+    // Runners-up among the points of the last layer
+    select_runners_up(ctx, batch, values, num_points, num_candidates, best_angles, best_values);
+    free(batch);
+    free(values);
+}
+
+
+double
+dirichlet_kernel(const int num_samples, const double x) {
+    const double denominator = num_samples * sin(x / 2);
+    return fabs(denominator) < 1e-12 ? 1 : sin(num_samples * x / 2) / denominator;
+}
+
+
+void
+fourier_search(
+    qaoa_context_t* ctx,
+    const int m,
+    const int beta_order,
+    const int num_candidates,
+    double* best_angles,
+    double* best_values
+) {
+    const double gamma_step = ctx->gamma_period / m;
+    const int num_betas = 2 * beta_order + 1; // Equispaced samples that determine a polynomial of this order
+    const int resolution = FOURIER_RESOLUTION * num_betas; // Dense points per period of beta
+    const size_t capacity = (size_t) m * num_betas + FOURIER_VERIFY_POINTS;
+    double* batch = malloc(capacity * 2 * ctx->depth * sizeof(double));
+    double* values = malloc(capacity * sizeof(double));
+    double* kernel = malloc(resolution * sizeof(double));
+    double line_maxima[m];
+    int line_betas[m];
+    double best_value;
+    size_t num_points = 0;
+
+    // The interpolant at dense point d is sum_k f_k D(2pi (d - FOURIER_RESOLUTION k) / resolution)
+    for (int offset = 0; offset < resolution; ++offset) {
+        kernel[offset] = dirichlet_kernel(num_betas, 2 * M_PI * offset / resolution);
+    }
+
+    // All angles are 0 initially to prepare layer-wise search, unless a checkpoint has completed layers
+    const int first_layer = resume_layers(ctx, best_angles, &best_value);
+
+    for (int j = first_layer; j < ctx->depth; j++) { // Iterate over pairs of angles
+        // The first gamma only ranges over half a period, see canonicalize_angles
+        const int num_lines = j == 0 ? m / 2 + 1 : m;
+        const size_t num_samples = (size_t) num_lines * num_betas;
+        for (size_t point = 0; point < num_samples; ++point) {
+            double* angles = batch + point * 2 * ctx->depth;
+            memcpy(angles, best_angles, 2 * ctx->depth * sizeof(double)); // Best angles of the previous layers
+            angles[2*j] = (double) (point / num_betas) * gamma_step;
+            angles[2*j+1] = (double) (point % num_betas) * 2 * M_PI / num_betas;
+        }
+        evaluate_angle_batch(ctx, batch, num_samples, values);
+        num_points = num_samples;
+
+        // Maximize the trigonometric interpolant in beta along every line of constant gamma
+        for (int line = 0; line < num_lines; ++line) {
+            const double* line_values = values + (size_t) line * num_betas;
+            bool_t complete = TRUE; // Lines cut short by the budgets cannot be interpolated
+            for (int sample = 0; sample < num_betas; ++sample) {
+                complete &= isfinite(line_values[sample]) != 0;
+            }
+            line_maxima[line] = -INFINITY;
+            for (int dense = 0; dense < resolution && complete; ++dense) {
+                double interpolant = 0;
+                for (int sample = 0; sample < num_betas; ++sample) {
+                    interpolant += line_values[sample]
+                        * kernel[(dense - FOURIER_RESOLUTION * sample + resolution) % resolution];
+                }
+                if (interpolant > line_maxima[line]) {
+                    line_maxima[line] = interpolant;
+                    line_betas[line] = dense;
+                }
+            }
+        }
+
+        // Verify the maxima of the best lines by exact evaluations; ties go to the lower gamma
+        bool_t chosen[num_lines];
+        memset(chosen, 0, sizeof(chosen));
+        for (int verify = 0; verify < FOURIER_VERIFY_POINTS; ++verify) {
+            int best_line = num_lines;
+            for (int line = 0; line < num_lines; ++line) {
+                if (!chosen[line] && isfinite(line_maxima[line])
+                    && (best_line == num_lines || line_maxima[line] > line_maxima[best_line])) {
+                    best_line = line;
+                }
+            }
+            if (best_line == num_lines) {
+                break;
+            }
+            chosen[best_line] = TRUE;
+            if (line_betas[best_line] % FOURIER_RESOLUTION == 0) {
+                continue; // The maximum is a sample
+            }
+            double* angles = batch + num_points * 2 * ctx->depth;
+            memcpy(angles, best_angles, 2 * ctx->depth * sizeof(double));
+            angles[2*j] = (double) best_line * gamma_step;
+            angles[2*j+1] = (double) line_betas[best_line] * 2 * M_PI / resolution;
+            ++num_points;
+        }
+        evaluate_angle_batch(ctx, batch + num_samples * 2 * ctx->depth, num_points - num_samples, values + num_samples);
+
+        size_t best_point = num_points;
+        for (size_t point = 0; point < num_points; ++point) {
+            if (values[point] > best_value) {
+                best_value = values[point];
+                best_point = point;
+            }
+        }
+        if (best_point < num_points) { // Keep best angles found in this layer
+            best_angles[2*j] = batch[best_point * 2 * ctx->depth + 2*j];
+            best_angles[2*j+1] = batch[best_point * 2 * ctx->depth + 2*j+1];
+        }
+        checkpoint_layers(ctx, j + 1, best_angles, best_value);
+    }
+    best_values[0] = best_value;
+
+    // Runners-up among the samples and verified points of the last layer
+    select_runners_up(ctx, batch, values, num_points, num_candidates, best_angles, best_values);
+    free(batch);
+    free(values);
+    free(kernel);
+}
+
+
+static void
+print_angles(qaoa_context_t* ctx, const double* angles) {
+    printf("gamma = (");
+    for (size_t j = 0; j < ctx->depth; j++) {
+        printf("%g", angles[2 * j]);
+        if (ctx->depth > 1 & j != ctx->depth - 1) {
+            printf(", ");
+        }
+    }
+    printf("), beta = (");
+    for (size_t j = 0; j < ctx->depth; j++) {
+        printf("%g", angles[2 * j + 1]);
+        if (ctx->depth > 1 & j != ctx->depth - 1) {
+            printf(", ");
+        }
+    }
+    printf(")");
+}
+
+
+static nlopt_opt
+create_local_optimizer(
+    qaoa_context_t* ctx,
+    const opt_t optimization_type,
+    const int memory_size,
+    workspace_t* workspace,
+    const size_t max_evals,
+    const double max_time
+) {
+    const nlopt_algorithm nlopt_optimization_algorithm = map_enum_to_nlopt_algorithm(optimization_type);
+    const nlopt_opt opt = nlopt_create(nlopt_optimization_algorithm, 2 * ctx->depth);
+    double lower_bounds[2 * ctx->depth];
+    double upper_bounds[2 * ctx->depth];
+
+    // Set your optimization parameters
+    nlopt_set_xtol_rel(opt, 1e-6);
+    if (max_evals < SIZE_MAX) {
+        nlopt_set_maxeval(opt, (int) MIN(max_evals, INT_MAX));
+    }
+    if (isfinite(max_time)) {
+        nlopt_set_maxtime(opt, max_time);
+    }
+
+    // Set the objective function, evaluated in the given workspace
+    nlopt_set_min_objective(opt, angles_to_value_nlopt, workspace);
 
     // Adjust the memory (vector storage) for L-BFGS
     if (optimization_type == BFGS) {
         nlopt_set_vector_storage(opt, memory_size);  // Set the memory size (e.g., 10, 20, etc.)
     }
 
-    // Set constraints for the optimizer
-    for (int i = 0; i < 2 * depth; ++i) {
+    // Set constraints for the optimizer: one period per angle, and about half of it for the first gamma, whose margin
+    // keeps optima just beyond the symmetry axis reachable; results are canonicalized afterwards
+    for (int i = 0; i < 2 * ctx->depth; ++i) {
         lower_bounds[i] = 0.0;
-        upper_bounds[i] = 2.0 * M_PI;
+        upper_bounds[i] = i % 2 == 1 ? 2.0 * M_PI
+                        : i == 0 ? ctx->gamma_period * (0.5 + FIRST_GAMMA_MARGIN) : ctx->gamma_period;
     }
 
     // Set the bounds for the optimization variables
     nlopt_set_lower_bounds(opt, lower_bounds);
     nlopt_set_upper_bounds(opt, upper_bounds);
+    return opt;
+}
+
+
+double*
+multi_start_optimizer(
+    qaoa_context_t* ctx,
+    const opt_t optimization_type,
+    const int memory_size,
+    const int num_starts,
+    double* starts,
+    const double* start_values,
+    const size_t max_evals_per_start
+) {
+    double values[num_starts];
+    nlopt_result results[num_starts];
+
+    if (!budget_left(ctx)) {
+        printf("Budget exhausted, skipping the local optimization\n");
+        double* angles = malloc(2 * ctx->depth * sizeof(double));
+        memcpy(angles, starts, 2 * ctx->depth * sizeof(double)); // Starts are sorted by their values
+        return angles;
+    }
+    // The evaluations left are shared among the starts, which all run until the same deadline
+    const size_t evals_left = remaining_evals(ctx);
+    const size_t budget_per_start = evals_left < SIZE_MAX ? MAX(evals_left / num_starts, 1) : SIZE_MAX;
+    const size_t evals_per_start = MIN(budget_per_start, max_evals_per_start);
+    const double time_left = remaining_time(ctx);
+
+    // Run one local optimization per start, each in a workspace of its own
+    #pragma omp parallel for schedule(dynamic) num_threads(workspace_threads(ctx, num_starts))
+    for (int start = 0; start < num_starts; ++start) {
+        workspace_t* workspace = num_starts > 1 ? create_workspace(ctx) : ctx->eval_workspace;
+        const nlopt_opt opt = create_local_optimizer(ctx, optimization_type, memory_size, workspace, evals_per_start,
+                                                     time_left);
+        double obj = 0;
+        results[start] = nlopt_optimize(opt, starts + start * 2 * ctx->depth, &obj); // opt_f must not be NULL
+        canonicalize_angles(ctx, starts + start * 2 * ctx->depth); // Same value by symmetry
+        values[start] = -obj;
+        nlopt_destroy(opt);
+        if (workspace != ctx->eval_workspace) {
+            free_workspace(workspace);
+        }
+    }
+    for (int start = 0; start < num_starts; ++start) {
+        // Only the budgets count as exhausted, not the cap of the starts
+        if ((results[start] == NLOPT_MAXEVAL_REACHED && budget_per_start <= max_evals_per_start)
+            || results[start] == NLOPT_MAXTIME_REACHED) {
+            ctx->eval_trace.exhausted = TRUE;
+        }
+    }
 
-    // Set all angles initially to 0
-    for (size_t j = 0; j < 2 * depth; j++) {
-        angles[j] = 0;
+    // Log every start and keep the best; ties keep the better start
+    int best_start = -1;
+    for (int start = 0; start < num_starts; ++start) {
+        if (num_starts > 1) {
+            printf("Start %d from value %f: ", start + 1, start_values[start]);
+        }
+        if (results[start] < 0) {
+            printf("NLOpt failed with code %d\n", results[start]);
+            continue;
+        }
+        print_angles(ctx, starts + start * 2 * ctx->depth);
+        printf(" with value %f\n", values[start]);
+        if (best_start < 0 || values[start] > values[best_start]) {
+            best_start = start;
+        }
+    }
+
+    double* angles = malloc(2 * ctx->depth * sizeof(double));
+    memcpy(angles, starts + MAX(best_start, 0) * 2 * ctx->depth, 2 * ctx->depth * sizeof(double));
+    if (num_starts > 1 && best_start >= 0) {
+        printf("Best of %d starts: start %d with value %f\n", num_starts, best_start + 1, values[best_start]);
+    }
+    return angles;
+}
+
+
+double*
+nlopt_optimizer(qaoa_context_t* ctx, const opt_t optimization_type, const int m, const int memory_size) {
+    const int num_starts = (int) MIN((size_t) ctx->options.num_starts, (size_t) m * m);
+    double* starts = malloc(num_starts * 2 * ctx->depth * sizeof(double));
+    double grid_values[num_starts];
+
+    // A checkpoint of a completed search restores its candidates, and the best start becomes the best angles
+    // evaluated so far if the local optimization had already improved on it
+    const checkpoint_t* checkpoint = &ctx->checkpoint;
+    const bool_t resumed = checkpoint->resumed && checkpoint->search_done;
+    const bool_t searched = resumed || ctx->grid_starts != NULL;
+    if (ctx->grid_starts != NULL) { // Searched beforehand, e.g. in lockstep with other instances
+        memcpy(starts, ctx->grid_starts, num_starts * 2 * ctx->depth * sizeof(double));
+        memcpy(grid_values, ctx->grid_values, num_starts * sizeof(double));
+    } else if (resumed) {
+        memcpy(starts, checkpoint->starts, num_starts * 2 * ctx->depth * sizeof(double));
+        memcpy(grid_values, checkpoint->start_values, num_starts * sizeof(double));
+        if (checkpoint->best_value > grid_values[0]) {
+            memcpy(starts, checkpoint->best_angles, 2 * ctx->depth * sizeof(double));
+            canonicalize_angles(ctx, starts); // Same value by symmetry
+            grid_values[0] = checkpoint->best_value;
+        }
     }
 
     // Perform fine grid search before optimizing
-    fine_grid_search(m, angles, &best_value);
+    const char* search_name;
+    size_t max_evals_per_start = SIZE_MAX;
+    if (ctx->options.grid == GRID_FOURIER) {
+        // The Grover mixer of a layer only contributes the frequencies -1, 0 and 1 of its beta, so the interpolant
+        // is exact; the Copula mixer does not have such a low order, and half as many betas as the uniform grid
+        // only approximate it
+        const int beta_order = ctx->options.fourier_order > 0 ? ctx->options.fourier_order
+            : ctx->qaoa_type == QTG ? 1 : MAX(m / 4 - 1, 1);
+        if (!searched) {
+            fourier_search(ctx, m, beta_order, num_starts, starts, grid_values);
+        }
+        max_evals_per_start = (size_t) FOURIER_REFINE_EVALS * 2 * ctx->depth; // Only a short refinement is left
+        search_name = "Fourier surrogate";
+    } else if (ctx->options.grid == GRID_ADAPTIVE) {
+        const int budget = ctx->options.grid_budget > 0 ? ctx->options.grid_budget
+                                                         : ctx->depth * m * m / ADAPTIVE_DEFAULT_SHARE;
+        if (!searched) {
+            adaptive_grid_search(ctx, m, budget, num_starts, starts, grid_values);
+        }
+        search_name = "Adaptive grid";
+    } else {
+        if (!searched) {
+            fine_grid_search(ctx, m, num_starts, starts, grid_values);
+        }
+        search_name = "Fine-grid";
+    }
+    if (!resumed) {
+        checkpoint_search(ctx, starts, grid_values);
+    }
 
-    printf("Fine-grid search --> NLOpt transformed gamma = (");
-    for (size_t j = 0; j < depth; j++) {
-        printf("%g", angles[2 * j]);
-        if (depth > 1 & j != depth - 1) {
-            printf(", ");
+    printf("%s%s search --> NLOpt transformed ",
+           ctx->grid_starts != NULL ? "Batched " : resumed ? "Resumed " : "", search_name);
+    print_angles(ctx, starts);
+    printf(" with value %f%s", grid_values[0], num_starts > 1 ? "\n" : " to ");
+
+    double* angles = multi_start_optimizer(ctx, optimization_type, memory_size, num_starts, starts, grid_values,
+                                           max_evals_per_start);
+    free(starts);
+    return angles;
+}
+
+
+double*
+warm_start_optimizer(
+    qaoa_context_t* ctx,
+    const opt_t optimization_type,
+    const int memory_size,
+    const double* start_angles
+) {
+    double start[2 * ctx->depth];
+    const bool_t resumed = ctx->checkpoint.resumed && isfinite(ctx->checkpoint.best_value);
+    memcpy(start, resumed ? ctx->checkpoint.best_angles : start_angles, 2 * ctx->depth * sizeof(double));
+    canonicalize_angles(ctx, start);
+    const double start_value = traced_value(ctx, ctx->eval_workspace, start);
+
+    printf("Warm start --> NLOpt transformed ");
+    print_angles(ctx, start);
+    printf(" with value %f to ", start_value);
+
+    return multi_start_optimizer(ctx, optimization_type, memory_size, 1, start, &start_value, SIZE_MAX);
+}
+
+
+void
+interpolate_angles(const int prev_depth, const double* prev_angles, double* angles) {
+    // INTERP: entry i of the p + 1 new values per angle type lies on the piecewise linear curve through the p old ones
+    for (int i = 0; i <= prev_depth; ++i) {
+        for (int type = 0; type < 2; ++type) { // gamma at even, beta at odd positions
+            const double left = i > 0 ? prev_angles[2 * (i - 1) + type] : 0;
+            const double right = i < prev_depth ? prev_angles[2 * i + type] : 0;
+            angles[2 * i + type] = ((double) i * left + (double) (prev_depth - i) * right) / prev_depth;
         }
     }
-    printf("), beta = (");
-    for (size_t j = 0; j < depth; j++) {
-        printf("%g", angles[2 * j + 1]);
-        if (depth > 1 & j != depth - 1) {
-            printf(", ");
+}
+
+
+/*
+ * =============================================================================
+ *                              Parameter transfer
+ * =============================================================================
+ */
+
+angle_key_t
+instance_angle_key(qaoa_context_t* ctx, const char* instance) {
+    angle_key_t key;
+    strcpy(key.qaoa, ctx->qaoa_type == QTG ? "qtg" : "copula");
+    key.quadratic = ctx->kp_type == QUADRATIC;
+    key.depth = ctx->depth;
+    key.size = ctx->kp->size;
+    key.capacity_ratio = (double) ctx->kp->capacity / MAX(cost_sum(ctx->kp), 1);
+    const char* groups = strstr(instance, "_g_"); // Only the generator knows the groups; 0 marks them unknown
+    key.num_groups = groups != NULL ? MAX(atoi(groups + 3), 0) : 0;
+    const num_t profit_total = ctx->kp_type == QUADRATIC ? quad_profit_sum(ctx->kp) : profit_sum(ctx->kp);
+    key.mean_profit = (double) profit_total / ctx->kp->size;
+    return key;
+}
+
+
+char*
+path_to_angle_db() {
+    char* path = calloc(1024, sizeof(char));
+    sprintf(path, "..%cinstances%cangle_db.txt", path_sep(), path_sep());
+    return path;
+}
+
+
+double*
+transfer_optimizer(
+    qaoa_context_t* ctx,
+    const opt_t optimization_type,
+    const int memory_size,
+    const char* instance,
+    const num_t optimal_sol_val
+) {
+    const angle_key_t key = instance_angle_key(ctx, instance);
+    angle_record_t records[ctx->options.num_starts];
+    char* path = path_to_angle_db();
+    const int num_starts = angle_db_nearest(path, &key, ctx->options.num_starts, records);
+    free(path);
+    if (num_starts == 0) {
+        printf("No angles to transfer for this instance, falling back to the fine-grid search\n");
+        return NULL;
+    }
+
+    double* starts = malloc(num_starts * 2 * ctx->depth * sizeof(double));
+    double start_values[num_starts];
+    for (int start = 0; start < num_starts; ++start) {
+        // gamma multiplies profits, so its value transfers relative to the profit scale
+        const double scale = key.mean_profit > 0 ? records[start].key.mean_profit / key.mean_profit : 1;
+        for (int j = 0; j < ctx->depth; ++j) {
+            starts[start * 2 * ctx->depth + 2 * j] = records[start].angles[2 * j] * scale;
+            starts[start * 2 * ctx->depth + 2 * j + 1] = records[start].angles[2 * j + 1];
+        }
+        canonicalize_angles(ctx, starts + start * 2 * ctx->depth);
+    }
+    evaluate_angle_batch(ctx, starts, num_starts, start_values);
+
+    int best_start = 0;
+    for (int start = 1; start < num_starts; ++start) {
+        if (start_values[start] > start_values[best_start]) {
+            best_start = start;
+        }
+    }
+    const double best_ratio = start_values[best_start] / optimal_sol_val;
+    const double recorded_ratio = records[best_start].approx_ratio;
+    free_angle_records(records, num_starts);
+    if (best_ratio < TRANSFER_ACCEPT * recorded_ratio) {
+        printf(
+            "Transferred angles reach approximation ratio %f instead of %f, falling back to the fine-grid search\n",
+            best_ratio, recorded_ratio
+        );
+        free(starts);
+        return NULL;
+    }
+
+    printf("Transfer of %d nearest angles --> NLOpt transformed ", num_starts);
+    print_angles(ctx, starts + best_start * 2 * ctx->depth);
+    printf(" with value %f%s", start_values[best_start], num_starts > 1 ? "\n" : " to ");
+
+    double* angles = multi_start_optimizer(ctx, optimization_type, memory_size, num_starts, starts, start_values,
+                                           SIZE_MAX);
+    free(starts);
+    return angles;
+}
+
+
+void
+export_angles(qaoa_context_t* ctx, const char* instance, const double tot_approx_ratio, const double* angles) {
+    const angle_key_t key = instance_angle_key(ctx, instance);
+    char* path = path_to_angle_db();
+    if (!angle_db_append(path, &key, tot_approx_ratio, angles)) {
+        printf("Warning: Could not append the optimized angles to %s.\n", path);
+    }
+    free(path);
+}
+
+
+/*
+ * =============================================================================
+ *                                  Export data
+ * =============================================================================
+ */
+
+char*
+path_for_instance(qaoa_context_t* ctx, const char* instance) {
+    char* qaoa_type_str = ctx->qaoa_type == QTG ? "qtg" : ctx->options.backend == MPS ? "copula-mps" : "copula";
+    char *path = calloc(1024, sizeof(char));
+    sprintf(
+        path, "..%cinstances%c%s%c%s%cp_%d%c",
+        path_sep(), path_sep(), instance, path_sep(), qaoa_type_str, path_sep(), ctx->depth, path_sep()
+    );
+    return path;
+}
+
+
+char*
+path_to_storage(qaoa_context_t* ctx, const char* instance) {
+    char* path = path_for_instance(ctx, instance);
+    char* opt_type_str;
+    switch (ctx->opt_type) { // No default needed as main function assures one of them
+        case POWELL:
+            opt_type_str = "powell";
+            break;
+        case NELDER_MEAD:
+            opt_type_str = "nelder-mead";
+            break;
+        case BFGS:
+            opt_type_str = "bfgs";
+            break;
+    }
+    char* path_to_storage = calloc(1024, sizeof(char));
+    sprintf(path_to_storage, "%s%s%c", path, opt_type_str, path_sep());
+    if (ctx->run_label[0] != '\0') { // One more level for runs of a sweep
+        sprintf(path_to_storage + strlen(path_to_storage), "%s%c", ctx->run_label, path_sep());
+    }
+    free(path);
+    return path_to_storage;
+}
+
+
+static void
+create_path_dirs(char* path) {
+    // Create every level of the path from the outermost one inwards; existing directories are left untouched
+    for (char* sep = strchr(path + 2, path_sep()); sep != NULL; sep = strchr(sep + 1, path_sep())) {
+        *sep = '\0';
+        create_dir(path);
+        *sep = path_sep();
+    }
+}
+
+
+void
+create_storage_dirs(qaoa_context_t* ctx, const char* instance) {
+    char* path = path_to_storage(ctx, instance);
+    create_path_dirs(path);
+    free(path);
+}
+
+
+void
+export_results(
+    qaoa_context_t* ctx,
+    const char* instance,
+    const num_t optimal_sol_val,
+    const num_t int_greedy_sol_val,
+    const double tot_approx_ratio,
+    const double prob_beating_greedy
+) {
+    char* path_to_results = path_to_storage(ctx, instance);
+    strcat(path_to_results, "results.txt");
+    FILE* file = fopen(path_to_results, "w");
+
+    fprintf(file, "%llu\n", ctx->num_states); // Save number of states for easier Python access
+    fprintf(file, "%ld\n", optimal_sol_val); // Save optimal solution value for documentation
+    fprintf(file, "%f\n", (double) int_greedy_sol_val / optimal_sol_val); // Save rescaled integer Greedy solution
+    fprintf(file, "%f\n", tot_approx_ratio); // Save total approximation ratio as global QAOA result
+    fprintf(file, "%f", prob_beating_greedy); // Save probability of beating Greedy for easier Python access
+
+    fclose(file);
+    free(path_to_results);
+}
+
+
+typedef struct profit_prob {
+    num_t profit;
+    double prob;
+} profit_prob_t;
+
+
+static int
+compare_profit_probs(const void* entry1, const void* entry2) {
+    const num_t first = ((const profit_prob_t*) entry1)->profit;
+    const num_t second = ((const profit_prob_t*) entry2)->profit;
+    return (first > second) - (first < second);
+}
+
+
+static size_t
+profit_slot(const num_t profit, const size_t num_slots) {
+    const uint64_t hash = (uint64_t) profit * 0x9E3779B97F4A7C15ULL; // Fibonacci hashing
+    return (size_t) (hash ^ hash >> 32) & (num_slots - 1);
+}
+
+
+void
+build_distribution(qaoa_context_t* ctx, const cmplx* angle_state, distribution_t* dist) {
+    size_t num_slots = DISTRIBUTION_MIN_SLOTS;
+    num_t* profits = malloc(num_slots * sizeof(num_t));
+    double* probs = malloc(num_slots * sizeof(double));
+    unsigned char* used = calloc(num_slots, sizeof(unsigned char));
+    size_t num_profits = 0;
+    dist->infeasible_prob = 0;
+
+    for (size_t word = 0; word * 64 < ctx->num_states; ++word) {
+        const uint64_t mask = feasibility_word(ctx, word);
+        const size_t stop = MIN(64, ctx->num_states - word * 64);
+        for (size_t bit = 0; bit < stop; ++bit) {
+            const size_t idx = word * 64 + bit;
+            const double prob = prob_for_amplitude(angle_state, idx);
+            if (!(mask >> bit & 1)) {
+                dist->infeasible_prob += prob;
+                continue;
+            }
+            const num_t profit = state_profit(ctx, idx);
+            size_t slot = profit_slot(profit, num_slots);
+            while (used[slot] && profits[slot] != profit) {
+                slot = (slot + 1) & (num_slots - 1); // Linear probing
+            }
+            if (used[slot]) {
+                probs[slot] += prob;
+                continue;
+            }
+            used[slot] = TRUE;
+            profits[slot] = profit;
+            probs[slot] = prob;
+            if (2 * ++num_profits <= num_slots) {
+                continue;
+            }
+
+            // Keep the load below one half by rehashing into twice as many slots
+            num_t* new_profits = malloc(2 * num_slots * sizeof(num_t));
+            double* new_probs = malloc(2 * num_slots * sizeof(double));
+            unsigned char* new_used = calloc(2 * num_slots, sizeof(unsigned char));
+            for (size_t old = 0; old < num_slots; ++old) {
+                if (!used[old]) {
+                    continue;
+                }
+                size_t new_slot = profit_slot(profits[old], 2 * num_slots);
+                while (new_used[new_slot]) {
+                    new_slot = (new_slot + 1) & (2 * num_slots - 1);
+                }
+                new_used[new_slot] = TRUE;
+                new_profits[new_slot] = profits[old];
+                new_probs[new_slot] = probs[old];
+            }
+            free(profits);
+            free(probs);
+            free(used);
+            profits = new_profits;
+            probs = new_probs;
+            used = new_used;
+            num_slots *= 2;
+        }
+    }
+
+    // Compact the occupied slots and sort them by profit
+    profit_prob_t* entries = malloc(MAX(num_profits, 1) * sizeof(profit_prob_t));
+    num_profits = 0;
+    for (size_t slot = 0; slot < num_slots; ++slot) {
+        if (used[slot]) {
+            entries[num_profits].profit = profits[slot];
+            entries[num_profits].prob = probs[slot];
+            ++num_profits;
+        }
+    }
+    qsort(entries, num_profits, sizeof(profit_prob_t), compare_profit_probs);
+    dist->num_profits = num_profits;
+    dist->profits = malloc(MAX(num_profits, 1) * sizeof(num_t));
+    dist->probs = malloc(MAX(num_profits, 1) * sizeof(double));
+    for (size_t idx = 0; idx < num_profits; ++idx) {
+        dist->profits[idx] = entries[idx].profit;
+        dist->probs[idx] = entries[idx].prob;
+    }
+    free(entries);
+    free(profits);
+    free(probs);
+    free(used);
+}
+
+
+void
+free_distribution(distribution_t* dist) {
+    free(dist->profits);
+    free(dist->probs);
+    dist->profits = NULL;
+    dist->probs = NULL;
+    dist->num_profits = 0;
+}
+
+
+num_t
+distribution_quantile(const distribution_t* dist, const double prob) {
+    double cdf = dist->infeasible_prob; // Infeasible states count as profit 0
+    if (dist->infeasible_prob > 0 && cdf >= prob) {
+        return 0;
+    }
+    for (size_t idx = 0; idx < dist->num_profits; ++idx) {
+        cdf += dist->probs[idx];
+        if (cdf >= prob) {
+            return dist->profits[idx];
         }
     }
-    double value = angles_to_value(angles);
-    printf(") with value %f to ", value);
+    return dist->num_profits > 0 ? dist->profits[dist->num_profits - 1] : 0; // Rounding errors of the total
+}
+
+
+void
+export_distribution(qaoa_context_t* ctx, const char* instance, const cmplx* angle_state, const num_t optimal_sol_val) {
+    distribution_t dist;
+    build_distribution(ctx, angle_state, &dist);
+
+    char* path = path_to_storage(ctx, instance);
+    const size_t dir_length = strlen(path);
+    FILE* file = fopen(strcat(path, "distribution.csv"), "w");
+    double cdf = dist.infeasible_prob;
+    fprintf(file, "profit,ratio,probability,cdf\n");
+    for (size_t idx = 0; idx < dist.num_profits; ++idx) {
+        cdf += dist.probs[idx];
+        fprintf(file, "%ld,%.10g,%.10g,%.10g\n", dist.profits[idx], (double) dist.profits[idx] / optimal_sol_val,
+                dist.probs[idx], cdf);
+    }
+    fclose(file);
+
+    path[dir_length] = '\0';
+    file = fopen(strcat(path, "quantiles.txt"), "w");
+    fprintf(file, "distinct_profits=%zu\n", dist.num_profits);
+    fprintf(file, "infeasible_probability=%.10g\n", dist.infeasible_prob);
+    for (int idx = 0; idx < ctx->options.num_quantiles; ++idx) {
+        const num_t quantile = distribution_quantile(&dist, ctx->options.quantiles[idx]);
+        fprintf(file, "quantile_%g=%.10g\n", ctx->options.quantiles[idx], (double) quantile / optimal_sol_val);
+    }
+    fclose(file);
+
+    free(path);
+    free_distribution(&dist);
+}
+
+
+static bool_t
+write_raw_column(
+    qaoa_context_t* ctx,
+    FILE* file,
+    const cmplx* angle_state,
+    const num_t optimal_sol_val,
+    const bool_t probabilities,
+    double* chunk
+) {
+    for (size_t first = 0; first < ctx->num_states; first += RAW_DATA_CHUNK) {
+        const size_t num_rows = MIN(RAW_DATA_CHUNK, ctx->num_states - first);
+        #pragma omp parallel for
+        for (size_t row = 0; row < num_rows; ++row) {
+            chunk[row] = probabilities ? prob_for_amplitude(angle_state, first + row)
+                                       : (double) state_profit(ctx, first + row) / optimal_sol_val;
+        }
+        if (fwrite(chunk, sizeof(double), num_rows, file) != num_rows) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+void
+export_raw_data(qaoa_context_t* ctx, const char* instance, const cmplx* angle_state, const num_t optimal_sol_val) {
+    char* path_to_raw_data = path_to_storage(ctx, instance);
+    strcat(path_to_raw_data, "raw_data.bin");
+    FILE* file = fopen(path_to_raw_data, "wb");
+    if (file == NULL) {
+        printf("Error: Could not open %s.\n", path_to_raw_data);
+        free(path_to_raw_data);
+        return;
+    }
+
+    raw_data_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAW_DATA_MAGIC, sizeof(header.magic));
+    header.version = RAW_DATA_VERSION;
+    header.num_states = ctx->num_states;
+    header.optimal_sol_val = (double) optimal_sol_val;
+
+    // Columnar: all ratios first, then all probabilities, each streamed in chunks
+    double* chunk = malloc(RAW_DATA_CHUNK * sizeof(double));
+    const bool_t success = fwrite(&header, sizeof(header), 1, file) == 1
+        && write_raw_column(ctx, file, angle_state, optimal_sol_val, FALSE, chunk)
+        && write_raw_column(ctx, file, angle_state, optimal_sol_val, TRUE, chunk);
+    if (fclose(file) != 0 || !success) {
+        printf("Error: Could not write %s.\n", path_to_raw_data);
+    }
+    free(chunk);
+    free(path_to_raw_data);
+}
 
-    // Run the optimization
-    double obj = 0;
-    const nlopt_result result = nlopt_optimize(opt, angles, &obj); // opt_f must not be NULL
-    value = angles_to_value(angles);
 
-    // Check the result and print the optimized values
-    if (result < 0) {
-        printf("\nNLOpt failed with code %d\n", result);
-    } else {
-        printf("gamma = (");
-        for (size_t j = 0; j < depth; j++) {
-            printf("%g", angles[2 * j]);
-            if (depth > 1 & j != depth - 1) {
-                printf(", ");
-            }
-        }
-        printf("), beta = (");
-        for (size_t j = 0; j < depth; j++) {
-            printf("%g", angles[2 * j + 1]);
-            if (depth > 1 & j != depth - 1) {
-                printf(", ");
-            }
+bool_t
+convert_raw_data(const char* path, FILE* out) {
+    FILE* ratios = fopen(path, "rb");
+    FILE* probs = fopen(path, "rb");
+    raw_data_header_t header;
+    bool_t success = ratios != NULL && probs != NULL && fread(&header, sizeof(header), 1, ratios) == 1
+        && memcmp(header.magic, RAW_DATA_MAGIC, sizeof(header.magic)) == 0 && header.version == RAW_DATA_VERSION
+        && seek_file(probs, sizeof(header) + header.num_states * sizeof(double));
+
+    // Both columns are read in step through two handles on the same file
+    double* ratio_chunk = malloc(RAW_DATA_CHUNK * sizeof(double));
+    double* prob_chunk = malloc(RAW_DATA_CHUNK * sizeof(double));
+    for (uint64_t first = 0; success && first < header.num_states; first += RAW_DATA_CHUNK) {
+        const size_t num_rows = (size_t) MIN(RAW_DATA_CHUNK, header.num_states - first);
+        success = fread(ratio_chunk, sizeof(double), num_rows, ratios) == num_rows
+            && fread(prob_chunk, sizeof(double), num_rows, probs) == num_rows;
+        for (size_t row = 0; success && row < num_rows; ++row) {
+            fprintf(out, "%f %f\n", ratio_chunk[row], prob_chunk[row]);
         }
-        printf(") with value %f\n", value);
     }
-
-    // Clean up
-    nlopt_destroy(opt);
-    return angles;
+    free(ratio_chunk);
+    free(prob_chunk);
+    if (ratios != NULL) {
+        fclose(ratios);
+    }
+    if (probs != NULL) {
+        fclose(probs);
+    }
+    return success;
 }
 
 
-/*
- * =============================================================================
- *                                  Export data
- * =============================================================================
- */
+void
+export_trace(qaoa_context_t* ctx, const char* instance) {
+    char* path = path_to_storage(ctx, instance);
+    FILE* file = fopen(strcat(path, "trace.csv"), "w");
+    const size_t record_size = 2 + 2 * ctx->depth;
+
+    fprintf(file, "evaluation,elapsed,value");
+    for (int j = 1; j <= ctx->depth; ++j) {
+        fprintf(file, ",gamma_%d,beta_%d", j, j);
+    }
+    fprintf(file, "\n");
+    for (size_t eval = 0; eval < ctx->eval_trace.num_evals; ++eval) {
+        const double* record = ctx->eval_trace.records + eval * record_size;
+        fprintf(file, "%zu,%.6f,%.10g", eval + 1, record[0], record[1]);
+        for (int j = 0; j < 2 * ctx->depth; ++j) {
+            fprintf(file, ",%.10g", record[2 + j]);
+        }
+        fprintf(file, "\n");
+    }
 
-char*
-path_for_instance(const char* instance) {
-    char* qaoa_type_str = qaoa_type == QTG ? "qtg" : "copula";
-    char *path = calloc(1024, sizeof(char));
-    sprintf(
-        path, "..%cinstances%c%s%c%s%cp_%d%c",
-        path_sep(), path_sep(), instance, path_sep(), qaoa_type_str, path_sep(), depth, path_sep()
-    );
-    return path;
+    fclose(file);
+    free(path);
 }
 
 
-char*
-path_to_storage(const char* instance) {
-    char* path = path_for_instance(instance);
-    char* opt_type_str;
-    switch (opt_type) { // No default needed as main function assures one of them
-        case POWELL:
-            opt_type_str = "powell";
-            break;
-        case NELDER_MEAD:
-            opt_type_str = "nelder-mead";
-            break;
-        case BFGS:
-            opt_type_str = "bfgs";
-            break;
-    }
-    char* path_to_storage = calloc(1024, sizeof(char));
-    sprintf(path_to_storage, "%s%s%c", path, opt_type_str, path_sep());
+void
+export_summary(qaoa_context_t* ctx, const char* instance) {
+    char* path = path_to_storage(ctx, instance);
+    FILE* file = fopen(strcat(path, "summary.txt"), "w");
+
+    fprintf(file, "evaluations=%zu\n", ctx->eval_trace.num_evals);
+    fprintf(file, "search_evaluations=%zu\n", ctx->eval_trace.num_search_evals);
+    fprintf(file, "local_evaluations=%zu\n", ctx->eval_trace.num_evals - ctx->eval_trace.num_search_evals);
+    fprintf(file, "resumed_evaluations=%zu\n", ctx->checkpoint.prior_evals);
+    fprintf(file, "batched_evaluations=%zu\n", ctx->num_grid_evals);
+    fprintf(file, "elapsed_seconds=%.6f\n", ctx->eval_trace.elapsed);
+    fprintf(file, "max_evals=%d\n", ctx->options.max_evals);
+    fprintf(file, "max_time=%g\n", ctx->options.max_time);
+    fprintf(file, "budget_exhausted=%d\n", ctx->eval_trace.exhausted);
+    fprintf(file, "cache_hits=%zu\n", ctx->eval_cache.hits);
+    fprintf(file, "cache_misses=%zu\n", ctx->eval_cache.misses);
+    fprintf(file, "cache_hit_rate=%.6f\n",
+            ctx->eval_cache.hits + ctx->eval_cache.misses > 0
+                ? (double) ctx->eval_cache.hits / (double) (ctx->eval_cache.hits + ctx->eval_cache.misses) : 0.);
+
+    fclose(file);
     free(path);
-    return path_to_storage;
 }
 
 
 void
-export_results(
+export_result_record(
+    qaoa_context_t* ctx,
     const char* instance,
     const num_t optimal_sol_val,
     const num_t int_greedy_sol_val,
     const double tot_approx_ratio,
-    const double prob_beating_greedy
+    const double prob_beating_greedy,
+    const bool_t warm_start
 ) {
-    char* path_to_results = path_to_storage(instance);
-    strcat(path_to_results, "results.txt");
-    FILE* file = fopen(path_to_results, "w");
-
-    fprintf(file, "%llu\n", num_states); // Save number of states for easier Python access
-    fprintf(file, "%ld\n", optimal_sol_val); // Save optimal solution value for documentation
-    fprintf(file, "%f\n", (double) int_greedy_sol_val / optimal_sol_val); // Save rescaled integer Greedy solution
-    fprintf(file, "%f\n", tot_approx_ratio); // Save total approximation ratio as global QAOA result
-    fprintf(file, "%f", prob_beating_greedy); // Save probability of beating Greedy for easier Python access
-
-    fclose(file);
-    free(path_to_results);
-}
-
-
-void
-export_raw_data(const char* instance, const cbs_t* angle_state, const num_t optimal_sol_val) {
-    char* path_to_raw_data = path_to_storage(instance);
-    strcat(path_to_raw_data, "raw_data.txt");
-    FILE* file = fopen(path_to_raw_data, "w");
-
-    for (size_t idx = 0; idx < num_states; ++idx) {
-        const double approx_ratio = (double) angle_state[idx].profit / optimal_sol_val;
-        double const prob = prob_for_amplitude(angle_state, idx);
-        fprintf(file, "%f %f\n", approx_ratio, prob);
+    if (ctx->options.results_log[0] == '\0') {
+        return;
+    }
+    result_record_t record;
+    memset(&record, 0, sizeof(record));
+    snprintf(record.key.instance, sizeof(record.key.instance), "%s", instance);
+    strcpy(record.key.qaoa_type, ctx->qaoa_type == QTG ? "qtg" : ctx->options.backend == MPS ? "copula-mps" : "copula");
+    record.key.depth = ctx->depth;
+    strcpy(record.key.optimizer,
+           ctx->opt_type == POWELL ? "powell" : ctx->opt_type == NELDER_MEAD ? "nelder-mead" : "bfgs");
+
+    // The fields of the benchmark line, followed by the options that change the optimization if they are set
+    char options[128] = "";
+    int length = 0;
+    if (warm_start) {
+        length += sprintf(options + length, " init=interp");
+    } else if (ctx->options.init == INIT_TRANSFER) {
+        length += sprintf(options + length, " init=transfer");
+    }
+    if (ctx->options.grid != GRID_UNIFORM) {
+        length += sprintf(options + length, " grid=%s", ctx->options.grid == GRID_ADAPTIVE ? "adaptive" : "fourier");
+    }
+    if (ctx->options.num_starts > 1) {
+        sprintf(options + length, " starts=%d", ctx->options.num_starts);
+    }
+    format_result_params(record.key.params, ctx->m, (long long) ctx->bias, ctx->k, ctx->theta,
+                         options[0] != '\0' ? options + 1 : options);
+
+    record.num_states = ctx->num_states;
+    record.optimal_sol_val = optimal_sol_val;
+    record.greedy_ratio = (double) int_greedy_sol_val / optimal_sol_val;
+    record.approx_ratio = tot_approx_ratio;
+    record.prob_beating_greedy = prob_beating_greedy;
+    record.num_evals = ctx->checkpoint.prior_evals + ctx->num_grid_evals + ctx->eval_trace.num_evals;
+    record.elapsed = ctx->eval_trace.elapsed;
+    if (!append_result(ctx->options.results_log, &record)) {
+        printf("Warning: Could not append the results to %s.\n", ctx->options.results_log);
     }
-
-    fclose(file);
-    free(path_to_raw_data);
 }
 
+
 void
-export_resources(const char* instance, const resource_t res) {
-    char* path = path_for_instance(instance);
+export_resources(qaoa_context_t* ctx, const char* instance, const resource_t res) {
+    char* path = path_for_instance(ctx, instance);
     FILE* file = fopen(strcat(path, "resources"), "w");
 
     fprintf(file, "%d\n", res.qubit_count);
@@ -644,9 +2646,8 @@ export_resources(const char* instance, const resource_t res) {
  * =============================================================================
  */
 
-void
-qaoa(
-    const char* instance,
+qaoa_context_t*
+create_context(
     knapsack_t* input_kp,
     const qaoa_type_t input_qaoa_type,
     const int input_depth,
@@ -656,148 +2657,735 @@ qaoa(
     const double copula_k,
     const double copula_theta,
     const int input_memory_size,
-    knapsack_type_t kp_type // 0 if linear knapsack, 1 if quadratic knapsack
+    const knapsack_type_t input_kp_type,
+    const run_options_t* input_options
 ) {
-    kp = input_kp;
-    qaoa_type = input_qaoa_type;
-    depth = input_depth;
-    opt_type = input_opt_type;
-    m = input_m;
-    bias = input_bias;
-    k = copula_k;
-    theta = copula_theta;
-    memory_size = input_memory_size;
-    
-    switch (kp_type) {
+    if (input_options->backend == MPS && (input_qaoa_type != COPULA || input_kp_type != LINEAR)) {
+        printf("Error: The MPS backend only supports the Copula QAOA on linear knapsack instances.\n");
+        return NULL;
+    }
+
+    qaoa_context_t* ctx = calloc(1, sizeof(qaoa_context_t));
+    ctx->kp = input_kp;
+    ctx->qaoa_type = input_qaoa_type;
+    ctx->depth = input_depth;
+    ctx->opt_type = input_opt_type;
+    ctx->m = input_m;
+    ctx->bias = input_bias;
+    ctx->k = copula_k;
+    ctx->theta = copula_theta;
+    ctx->memory_size = input_memory_size;
+    ctx->kp_type = input_kp_type;
+    ctx->options = *input_options;
+    ctx->gamma_period = 2 * M_PI;
+    return ctx;
+}
+
+
+void
+prepare_instance(qaoa_context_t* ctx, num_t* int_greedy_sol_val, num_t* optimal_sol_val) {
+    switch (ctx->kp_type) {
         case QUADRATIC:
-            apply_quad_int_greedy(kp);
+            apply_quad_int_greedy(ctx->kp);
             break;
         case LINEAR:
-            sort_knapsack(kp, RATIO);
-            apply_int_greedy(kp);
+            sort_knapsack(ctx->kp, RATIO);
+            apply_int_greedy(ctx->kp);
             break;
     }
 
 
     printf("\n===== Preparation ======\n");
     
-    path_t* int_greedy_sol = path_rep(kp);
-    const num_t int_greedy_sol_val = int_greedy_sol->tot_profit;
-    printf("Integer greedy solution = %ld\n", int_greedy_sol_val);
-    remove_all_items(kp);
+    path_t* int_greedy_sol = path_rep(ctx->kp);
+    *int_greedy_sol_val = int_greedy_sol->tot_profit;
+    printf("Integer greedy solution = %ld\n", *int_greedy_sol_val);
+    remove_all_items(ctx->kp);
 
-    switch (qaoa_type) {
+    switch (ctx->qaoa_type) {
         case QTG:
             printf("Generating states via QTG...\n");
-            qtg_nodes = qtg(kp, bias, int_greedy_sol->vector, &num_states, kp_type);
-            free_path(int_greedy_sol);
-            printf("Done! Number of states = %zu\n", num_states);
+            ctx->qtg_nodes = qtg(ctx->kp, ctx->bias, int_greedy_sol->vector, &ctx->num_states, ctx->kp_type);
+            printf("Done! Number of states = %zu\n", ctx->num_states);
+            build_profit_table(ctx);
             double init_sol_val = 0;
-            for (size_t idx = 0; idx < num_states; ++idx) {
-                init_sol_val += qtg_nodes[idx].prob * qtg_nodes[idx].path.tot_profit;
+            for (size_t idx = 0; idx < ctx->num_states; ++idx) {
+                init_sol_val += ctx->qtg_nodes[idx].prob * ctx->qtg_nodes[idx].path.tot_profit;
             }
             printf("Initial solution value = %f\n", init_sol_val);
             break;
 
         case COPULA:
-            num_states = POW2(kp->size);
-
-            printf(
-                "Computing a list of probability distribution values, objective function values and feasibilities...\n"
-            );
-
-            prob_dist_vals = malloc(kp->size * sizeof(double));
-            for (bit_t bit = 0; bit < kp->size; ++bit) {
-                prob_dist_vals[bit] = prob_dist(bit);
-            }
-
-            sol_profits = malloc(num_states * sizeof(num_t));
-            for (size_t idx = 0; idx < num_states; ++idx) {
-                switch (kp_type) {
-                    case LINEAR:
-                        sol_profits[idx] = objective_func(kp, idx);
-                        break;
-                    case QUADRATIC:
-                        sol_profits[idx] = quad_objective_func(kp, idx);
-                        break;
-                }
+            ctx->num_states = POW2(ctx->kp->size);
+
+            if (ctx->options.backend == MPS) {
+                printf("Using the MPS backend with maximal bond dimension %d\n", ctx->options.max_bond_dim);
+                break; // Profits and feasibilities are accounted for during the contraction
             }
 
-            sol_feasibilities = malloc(num_states * sizeof(bool_t));
-            for (size_t idx = 0; idx < num_states; ++idx) {
-                sol_feasibilities[idx] = sol_cost(kp, idx) <= kp->capacity;
+            printf("Computing a list of objective function values and feasibilities...\n");
+
+            switch (ctx->kp_type) {
+                case LINEAR:
+                    // Linear profits factorise over the qubits, so no table over all basis states is needed
+                    build_phase_blocks(ctx);
+                    break;
+                case QUADRATIC:
+                    build_profit_table(ctx);
+                    break;
+            }
+
+            // One bit per computational basis state, 64 of them packed into each word
+            ctx->sol_feasibilities = calloc((ctx->num_states + 63) / 64, sizeof(uint64_t));
+            for (size_t idx = 0; idx < ctx->num_states; ++idx) {
+                if (sol_cost(ctx->kp, idx) <= ctx->kp->capacity) {
+                    ctx->sol_feasibilities[idx / 64] |= (uint64_t) 1 << (idx % 64);
+                }
             }
             break;
     }
-    num_t optimal_sol_val;
-    switch (kp_type) {
+    free_path(int_greedy_sol);
+
+    switch (ctx->kp_type) {
         case LINEAR:
-            optimal_sol_val = combo_wrap(kp, 0, kp->capacity, FALSE, FALSE, TRUE, FALSE);
+            *optimal_sol_val = combo_wrap(ctx->kp, 0, ctx->kp->capacity, FALSE, FALSE, TRUE, FALSE);
             break;
         case QUADRATIC:
-            optimal_sol_val = 180;
+            *optimal_sol_val = 180;
+    }
+    printf("Optimal solution value = %ld\n", *optimal_sol_val);
+
+    compute_gamma_period(ctx);
+    printf("Period of gamma = 2pi/%.0f\n", 2 * M_PI / ctx->gamma_period);
+}
+
+
+instance_context_t*
+prepare_instance_context(
+    knapsack_t* input_kp,
+    const qaoa_type_t input_qaoa_type,
+    const size_t input_bias,
+    const knapsack_type_t input_kp_type,
+    const run_options_t* input_options
+) {
+    qaoa_context_t* ctx = create_context(input_kp, input_qaoa_type, 0, POWELL, 0, input_bias, 0, 0, 0, input_kp_type,
+                                         input_options);
+    if (ctx == NULL) {
+        return NULL;
+    }
+    instance_context_t* prepared = calloc(1, sizeof(instance_context_t));
+    prepare_instance(ctx, &prepared->int_greedy_sol_val, &prepared->optimal_sol_val);
+
+    // The tables move from the temporary context into the preparation
+    prepared->kp = input_kp;
+    prepared->qaoa_type = input_qaoa_type;
+    prepared->bias = input_bias;
+    prepared->kp_type = input_kp_type;
+    prepared->backend = input_options->backend;
+    prepared->num_states = ctx->num_states;
+    prepared->qtg_nodes = ctx->qtg_nodes;
+    prepared->sol_profits = ctx->sol_profits;
+    prepared->sol_feasibilities = ctx->sol_feasibilities;
+    prepared->num_phase_blocks = ctx->num_phase_blocks;
+    prepared->block_profits = ctx->block_profits;
+    prepared->gamma_period = ctx->gamma_period;
+    prepared->ref_count = 1;
+    free(ctx);
+    return prepared;
+}
+
+
+void
+retain_instance_context(instance_context_t* prepared) {
+    ++prepared->ref_count;
+}
+
+
+void
+release_instance_context(instance_context_t* prepared) {
+    if (--prepared->ref_count > 0) {
+        return;
+    }
+    if (prepared->qtg_nodes != NULL) {
+        free_nodes(prepared->qtg_nodes, prepared->num_states);
+    }
+    free(prepared->sol_profits.data);
+    free(prepared->sol_feasibilities);
+    free(prepared->block_profits);
+    free_knapsack(prepared->kp);
+    free(prepared);
+}
+
+
+double
+instance_context_bytes(const instance_context_t* prepared) {
+    const knapsack_t* kp = prepared->kp;
+    double bytes = (double) kp->size * sizeof(item_t);
+    if (kp->quad_profit != NULL) {
+        bytes += (double) kp->size * kp->size * sizeof(num_t);
+    }
+    if (prepared->qtg_nodes != NULL) {
+        const double string_bytes = (kp->size / 64 + 1) * sizeof(uint64_t) + ESTIMATE_MALLOC_OVERHEAD;
+        bytes += (double) prepared->num_states * (sizeof(node_t) + string_bytes);
+    }
+    if (prepared->sol_profits.data != NULL) {
+        bytes += (double) prepared->num_states * ((size_t) 1 << prepared->sol_profits.width); // 1, 2, 4 or 8 bytes
+    }
+    if (prepared->sol_feasibilities != NULL) {
+        bytes += (double) (prepared->num_states + 63) / 64 * sizeof(uint64_t);
+    }
+    bytes += (double) prepared->num_phase_blocks * POW2(PHASE_BLOCK_BITS) * sizeof(num_t);
+    return bytes;
+}
+
+
+qaoa_context_t*
+create_shared_context(
+    instance_context_t* prepared,
+    const int input_depth,
+    const opt_t input_opt_type,
+    const int input_m,
+    const double copula_k,
+    const double copula_theta,
+    const int input_memory_size,
+    const run_options_t* input_options
+) {
+    if (input_options->backend != prepared->backend) {
+        printf("Error: The backend of a run must match the one its instance was prepared for.\n");
+        return NULL;
+    }
+    qaoa_context_t* ctx = create_context(prepared->kp, prepared->qaoa_type, input_depth, input_opt_type, input_m,
+                                         prepared->bias, copula_k, copula_theta, input_memory_size, prepared->kp_type,
+                                         input_options);
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->num_states = prepared->num_states;
+    ctx->qtg_nodes = prepared->qtg_nodes;
+    ctx->sol_profits = prepared->sol_profits;
+    ctx->sol_feasibilities = prepared->sol_feasibilities;
+    ctx->num_phase_blocks = prepared->num_phase_blocks;
+    ctx->block_profits = prepared->block_profits;
+    ctx->gamma_period = prepared->gamma_period;
+    ctx->shared = prepared;
+    retain_instance_context(prepared);
+
+    printf("\n===== Shared preparation =====\n");
+    printf("Integer greedy solution = %ld\n", prepared->int_greedy_sol_val);
+    printf("Number of states = %zu\n", prepared->num_states);
+    printf("Optimal solution value = %ld\n", prepared->optimal_sol_val);
+    return ctx;
+}
+
+
+static void
+prepare_run(qaoa_context_t* ctx) {
+    if (ctx->qaoa_type == COPULA) {
+        printf("Computing a list of probability distribution values for k = %.2f...\n", ctx->k);
+        build_prob_dist_vals(ctx);
     }
-    printf("Optimal solution value = %ld\n", optimal_sol_val);
+    if (ctx->options.backend == STATEVECTOR) {
+        prepare_initial_state(ctx); // Restored at the start of every evaluation instead of being rebuilt
+    }
+    ctx->eval_workspace = create_workspace(ctx);
+}
+
+
+double*
+run_qaoa(
+    qaoa_context_t* ctx,
+    const char* instance,
+    const num_t int_greedy_sol_val,
+    const num_t optimal_sol_val,
+    const double* start_angles
+) {
+    prepare_run(ctx);
 
 
     printf("\n===== Running QAOA =====\n");
 
     printf("Optimize angles...\n");
-    double* opt_angles = nlopt_optimizer(opt_type, m, memory_size);
+    create_eval_cache(ctx, MEMO_CACHE_BYTES);
+    start_trace(ctx);
+    create_storage_dirs(ctx, instance); // Checkpoints are written there long before the results
+    open_checkpoint(ctx, instance);
+    double* opt_angles = NULL;
+    if (start_angles != NULL) {
+        opt_angles = warm_start_optimizer(ctx, ctx->opt_type, ctx->memory_size, start_angles);
+    } else if (ctx->options.init == INIT_TRANSFER) {
+        opt_angles = transfer_optimizer(ctx, ctx->opt_type, ctx->memory_size, instance, optimal_sol_val);
+    }
+    if (opt_angles == NULL) {
+        opt_angles = nlopt_optimizer(ctx, ctx->opt_type, ctx->m, ctx->memory_size);
+    }
+    ctx->eval_trace.elapsed = wall_time() - ctx->eval_trace.start_time;
+    printf(
+        "%zu evaluations and %zu cache hits in %.2f s%s\n",
+        ctx->eval_trace.num_evals, ctx->eval_cache.hits, ctx->eval_trace.elapsed,
+        ctx->eval_trace.exhausted ? " (budget exhausted)" : ""
+    );
 
     printf("Quasi-adiabatic evolution of optimal angles...\n");
     fflush(stdout);
-    cbs_t *opt_angle_state = quasiadiabatic_evolution(opt_angles);
-
-    if (opt_angles != NULL) {
-        free(opt_angles);
+    cmplx* opt_angle_state = NULL;
+    mps_t* opt_mps = NULL;
+    if (ctx->options.backend == MPS) {
+        opt_mps = mps_quasiadiabatic_evolution(ctx, opt_angles);
+        printf("Discarded weight during truncation = %g\n", opt_mps->trunc_weight);
+    } else {
+        opt_angle_state = quasiadiabatic_evolution(ctx, opt_angles);
     }
 
     printf("Compute expectation value...\n");
 
-    const double sol_val = expectation_value(opt_angle_state);
+    const double sol_val = opt_mps != NULL ? mps_feasible_expectation(opt_mps, ctx->kp)
+                                           : expectation_value(ctx, opt_angle_state);
     printf("Objective function value for optimized angles = %f\n", sol_val);
 
     const double tot_approx_ratio = sol_val / optimal_sol_val;
     printf("Total approximation ratio for optimized angles = %f\n", tot_approx_ratio);
 
-    const double prob_beat_greedy = prob_beating_greedy(opt_angle_state, int_greedy_sol_val);
+    const double prob_beat_greedy = opt_mps != NULL
+        ? mps_prob_beating_greedy(opt_mps, ctx->kp, int_greedy_sol_val, MPS_NUM_SAMPLES)
+        : prob_beating_greedy(ctx, opt_angle_state, int_greedy_sol_val);
     printf("Probability of beating Greedy = %f\n", prob_beat_greedy);
 
 
     printf("\n ===== Export results =====\n");
 
-    export_results(instance, optimal_sol_val, int_greedy_sol_val, tot_approx_ratio, prob_beat_greedy);
-    export_raw_data(instance, opt_angle_state, optimal_sol_val);
+    export_results(ctx, instance, optimal_sol_val, int_greedy_sol_val, tot_approx_ratio, prob_beat_greedy);
+    export_angles(ctx, instance, tot_approx_ratio, opt_angles);
+    export_trace(ctx, instance);
+    export_summary(ctx, instance);
+    export_result_record(ctx, instance, optimal_sol_val, int_greedy_sol_val, tot_approx_ratio, prob_beat_greedy,
+                         start_angles != NULL);
+    if (opt_mps != NULL) {
+        printf("Raw data is not available for the MPS backend.\n"); // 2^n amplitudes are never formed
+        free_mps(opt_mps);
+    } else {
+        export_distribution(ctx, instance, opt_angle_state, optimal_sol_val);
+        if (ctx->options.raw_data == RAW_STATES) { // The per-state dump is opt-in, for debugging
+            export_raw_data(ctx, instance, opt_angle_state, optimal_sol_val);
+        }
+    }
+    close_checkpoint(ctx); // Nothing is left to resume
     printf("Results exported successfully!\n");
 
-    // Free optimized-angles solution state and global variables
+    // Free optimized-angles solution state and the variables depending on the run's hyperparameters
     if (opt_angle_state != NULL) {
         free(opt_angle_state);
     }
-    free_global_variables();
+    free_run_variables(ctx);
+    return opt_angles;
+}
 
 
+void
+export_resource_counts(qaoa_context_t* ctx, const char* instance) {
     printf("\n===== Export resource counts =====\n");
 
     resource_t res;
-    switch (qaoa_type) {
+    switch (ctx->qaoa_type) {
         case QTG:
-            res.qubit_count = qubit_count_qtg_qaoa(kp);
-            res.cycle_count = cycle_count_qtg_qaoa(kp, depth, COPPERSMITH, TOFFOLI, FALSE);
-            res.gate_count = gate_count_qtg_qaoa(kp, depth, COPPERSMITH, TOFFOLI, FALSE);
-            res.cycle_count_decomp = cycle_count_qtg_qaoa(kp, depth, COPPERSMITH, TOFFOLI, TRUE);
-            res.gate_count_decomp = gate_count_qtg_qaoa(kp, depth, COPPERSMITH, TOFFOLI, TRUE);
+            res.qubit_count = qubit_count_qtg_qaoa(ctx->kp);
+            res.cycle_count = cycle_count_qtg_qaoa(ctx->kp, ctx->depth, COPPERSMITH, TOFFOLI, FALSE);
+            res.gate_count = gate_count_qtg_qaoa(ctx->kp, ctx->depth, COPPERSMITH, TOFFOLI, FALSE);
+            res.cycle_count_decomp = cycle_count_qtg_qaoa(ctx->kp, ctx->depth, COPPERSMITH, TOFFOLI, TRUE);
+            res.gate_count_decomp = gate_count_qtg_qaoa(ctx->kp, ctx->depth, COPPERSMITH, TOFFOLI, TRUE);
             break;
         case COPULA:
-            res.qubit_count = qubit_count_copula_qaoa(kp);
-            res.cycle_count = cycle_count_copula_qaoa(kp, depth);
-            res.gate_count = gate_count_copula_qaoa(kp, depth);
+            res.qubit_count = qubit_count_copula_qaoa(ctx->kp);
+            res.cycle_count = cycle_count_copula_qaoa(ctx->kp, ctx->depth);
+            res.gate_count = gate_count_copula_qaoa(ctx->kp, ctx->depth);
             res.cycle_count_decomp = res.cycle_count;
             res.gate_count_decomp = res.gate_count;
             break;
     }
-    export_resources(instance, res);
+    export_resources(ctx, instance, res);
 
     printf("Resource counts exported successfully!\n");
 }
+
+
+void
+qaoa(
+    const char* instance,
+    instance_context_t* prepared,
+    const int input_depth,
+    const opt_t input_opt_type,
+    const int input_m,
+    const double copula_k,
+    const double copula_theta,
+    const int input_memory_size,
+    const run_options_t* input_options
+) {
+    qaoa_context_t* ctx = create_shared_context(prepared, input_depth, input_opt_type, input_m, copula_k,
+                                                copula_theta, input_memory_size, input_options);
+    if (ctx == NULL) {
+        return;
+    }
+
+    free(run_qaoa(ctx, instance, prepared->int_greedy_sol_val, prepared->optimal_sol_val, NULL));
+
+    export_resource_counts(ctx, instance);
+    free_context(ctx);
+}
+
+
+void
+copula_sweep(
+    const char* instance,
+    instance_context_t* prepared,
+    const int input_depth,
+    const opt_t input_opt_type,
+    const int input_m,
+    const double* copula_ks,
+    const int num_ks,
+    const double* copula_thetas,
+    const int num_thetas,
+    const int input_memory_size,
+    const run_options_t* input_options
+) {
+    if (prepared->qaoa_type != COPULA) {
+        printf("Error: A sweep over k and theta needs an instance prepared for the Copula QAOA.\n");
+        return;
+    }
+    qaoa_context_t* ctx = create_shared_context(prepared, input_depth, input_opt_type, input_m, copula_ks[0],
+                                                copula_thetas[0], input_memory_size, input_options);
+    if (ctx == NULL) {
+        return;
+    }
+
+    // Everything that does not depend on k or theta is shared with all workers
+    const num_t int_greedy_sol_val = prepared->int_greedy_sol_val;
+    const num_t optimal_sol_val = prepared->optimal_sol_val;
+
+    const int num_combinations = num_ks * num_thetas;
+    int max_workers = ctx->options.num_workers > 0 ? ctx->options.num_workers : (int) num_processors();
+    max_workers = MIN(max_workers, num_combinations);
+    printf("\n===== Copula sweep over %d combinations with up to %d workers =====\n", num_combinations, max_workers);
+
+    int num_running = 0;
+    int num_failed = 0;
+    for (int comb = 0; comb < num_combinations; ++comb) {
+        ctx->k = copula_ks[comb / num_thetas];
+        ctx->theta = copula_thetas[comb % num_thetas];
+        sprintf(ctx->run_label, "k_%g_theta_%g", ctx->k, ctx->theta);
+
+        if (num_running == max_workers) {
+            num_failed += !wait_for_worker();
+            --num_running;
+        }
+        printf("\n===== Sweep: k = %g, theta = %g =====\n", ctx->k, ctx->theta);
+        fflush(stdout); // Otherwise buffered output is duplicated in the worker
+        const int64_t pid = max_workers > 1 ? fork_worker() : -1;
+        if (pid == 0) {
+#ifdef _OPENMP
+            omp_set_num_threads((int) MAX(num_processors() / max_workers, 1)); // Share the processors among workers
+#endif
+            // ... and the memory
+            const uint64_t memory = ctx->options.max_memory > 0 ? ctx->options.max_memory : physical_memory();
+            ctx->options.max_memory = memory / max_workers;
+            free(run_qaoa(ctx, instance, int_greedy_sol_val, optimal_sol_val, NULL));
+            fflush(stdout);
+            _Exit(0); // The shared tables belong to the parent
+        } else if (pid > 0) {
+            ++num_running;
+        } else { // Serial fallback
+            free(run_qaoa(ctx, instance, int_greedy_sol_val, optimal_sol_val, NULL));
+        }
+    }
+    while (num_running > 0) {
+        num_failed += !wait_for_worker();
+        --num_running;
+    }
+    if (num_failed > 0) {
+        printf("Error: %d of %d sweep runs failed.\n", num_failed, num_combinations);
+    }
+    ctx->run_label[0] = '\0';
+
+    export_resource_counts(ctx, instance);
+    free_context(ctx);
+}
+
+
+void
+depth_sweep(
+    const char* instance,
+    instance_context_t* prepared,
+    const int min_depth,
+    const int max_depth,
+    const opt_t input_opt_type,
+    const int input_m,
+    const double copula_k,
+    const double copula_theta,
+    const int input_memory_size,
+    const run_options_t* input_options
+) {
+    qaoa_context_t* ctx = create_shared_context(prepared, min_depth, input_opt_type, input_m, copula_k, copula_theta,
+                                                input_memory_size, input_options);
+    if (ctx == NULL) {
+        return;
+    }
+
+    // The instance-dependent tables do not depend on the depth either
+    const num_t int_greedy_sol_val = prepared->int_greedy_sol_val;
+    const num_t optimal_sol_val = prepared->optimal_sol_val;
+
+    double* opt_angles = NULL;
+    for (ctx->depth = min_depth; ctx->depth <= max_depth; ++ctx->depth) {
+        printf("\n===== Depth sweep: p = %d =====\n", ctx->depth);
+        double* start_angles = NULL;
+        if (opt_angles != NULL) { // Warm start from the optimized angles of the previous depth
+            start_angles = malloc(2 * ctx->depth * sizeof(double));
+            interpolate_angles(ctx->depth - 1, opt_angles, start_angles);
+            free(opt_angles);
+        }
+        opt_angles = run_qaoa(ctx, instance, int_greedy_sol_val, optimal_sol_val, start_angles);
+        free(start_angles);
+        export_resource_counts(ctx, instance);
+    }
+    free(opt_angles);
+    free_context(ctx);
+}
+
+
+/*
+ * =============================================================================
+ *                                  Landscape
+ * =============================================================================
+ */
+
+void
+scan_landscape(
+    const char* instance,
+    knapsack_t* input_kp,
+    const qaoa_type_t input_qaoa_type,
+    const int input_depth,
+    const int layer,
+    const int resolution,
+    const size_t input_bias,
+    const double copula_k,
+    const double copula_theta,
+    const knapsack_type_t input_kp_type,
+    const run_options_t* input_options,
+    const double* fixed_angles,
+    const int csv_stride
+) {
+    qaoa_context_t* ctx = create_context(input_kp, input_qaoa_type, input_depth, POWELL, resolution, input_bias,
+                                         copula_k, copula_theta, 0, input_kp_type, input_options);
+    if (ctx == NULL) {
+        return;
+    }
+    ctx->options.max_evals = 0; // A landscape is always complete
+    ctx->options.max_time = 0;
+
+    num_t int_greedy_sol_val, optimal_sol_val;
+    prepare_instance(ctx, &int_greedy_sol_val, &optimal_sol_val);
+    prepare_run(ctx);
+
+    char* dir = path_for_instance(ctx, instance);
+    create_path_dirs(dir);
+    char path_to_grid[1100], path_to_csv[1100];
+    sprintf(path_to_grid, "%slandscape_layer_%d.bin", dir, layer + 1);
+    sprintf(path_to_csv, "%slandscape_layer_%d.csv", dir, layer + 1);
+    free(dir);
+    FILE* grid_file = fopen(path_to_grid, "wb");
+    FILE* csv_file = csv_stride > 0 ? fopen(path_to_csv, "w") : NULL;
+    if (grid_file == NULL || (csv_stride > 0 && csv_file == NULL)) {
+        printf("Error: Could not open the landscape files of %s.\n", instance);
+        if (grid_file != NULL) {
+            fclose(grid_file);
+        }
+        free_run_variables(ctx);
+        free_context(ctx);
+        return;
+    }
+
+    landscape_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LANDSCAPE_MAGIC, sizeof(header.magic));
+    header.version = LANDSCAPE_VERSION;
+    header.depth = ctx->depth;
+    header.layer = layer;
+    header.num_gammas = resolution;
+    header.num_betas = resolution;
+    header.gamma_period = ctx->gamma_period;
+    fwrite(&header, sizeof(header), 1, grid_file);
+    fwrite(fixed_angles, sizeof(double), 2 * ctx->depth, grid_file);
+    if (csv_file != NULL) {
+        fprintf(csv_file, "gamma,beta,value\n");
+    }
+
+    printf("\n===== Scanning the landscape of layer %d on a %d x %d grid =====\n", layer + 1, resolution, resolution);
+    fflush(stdout);
+    const int rows_per_chunk = MAX(LANDSCAPE_CHUNK_POINTS / resolution, 1);
+    double* batch = malloc((size_t) rows_per_chunk * resolution * 2 * ctx->depth * sizeof(double));
+    double* values = malloc((size_t) rows_per_chunk * resolution * sizeof(double));
+    start_trace(ctx);
+    size_t num_evals = 0;
+    for (int first_row = 0; first_row < resolution; first_row += rows_per_chunk) {
+        // Rows of constant gamma, each over all betas, are evaluated in parallel and streamed to the files
+        const int num_rows = MIN(rows_per_chunk, resolution - first_row);
+        const size_t num_points = (size_t) num_rows * resolution;
+        for (size_t point = 0; point < num_points; ++point) {
+            double* angles = batch + point * 2 * ctx->depth;
+            memcpy(angles, fixed_angles, 2 * ctx->depth * sizeof(double));
+            angles[2 * layer] = (double) (first_row + (int) (point / resolution)) * ctx->gamma_period / resolution;
+            angles[2 * layer + 1] = (double) (point % resolution) * 2 * M_PI / resolution;
+        }
+        evaluate_angle_batch(ctx, batch, num_points, values);
+        num_evals += ctx->eval_trace.num_evals;
+        ctx->eval_trace.num_evals = 0; // The values are kept in the files instead of the trace
+
+        fwrite(values, sizeof(double), num_points, grid_file);
+        for (size_t point = 0; point < num_points && csv_file != NULL; ++point) {
+            const int row = first_row + (int) (point / resolution);
+            const int col = (int) (point % resolution);
+            if (row % csv_stride == 0 && col % csv_stride == 0) {
+                fprintf(csv_file, "%.10g,%.10g,%.10g\n", batch[point * 2 * ctx->depth + 2 * layer],
+                        batch[point * 2 * ctx->depth + 2 * layer + 1], values[point]);
+            }
+        }
+    }
+    const double elapsed = wall_time() - ctx->eval_trace.start_time;
+    printf("%zu evaluations in %.2f s\n", num_evals, elapsed);
+    printf("Landscape exported to %s%s%s\n", path_to_grid, csv_file != NULL ? " and " : "",
+           csv_file != NULL ? path_to_csv : "");
+
+    free(batch);
+    free(values);
+    fclose(grid_file);
+    if (csv_file != NULL) {
+        fclose(csv_file);
+    }
+    free_run_variables(ctx);
+    free_context(ctx);
+}
+
+
+/*
+ * =============================================================================
+ *                             Resource estimation
+ * =============================================================================
+ */
+
+double
+measure_flop_rate() {
+    cmplx* amplitudes = malloc(ESTIMATE_CALIBRATION_SIZE * sizeof(cmplx));
+    for (size_t idx = 0; idx < ESTIMATE_CALIBRATION_SIZE; ++idx) {
+        amplitudes[idx] = 1.0 / (double) (idx + 1);
+    }
+    const cmplx phase = cexp(-I * 0.1);
+
+    size_t num_rounds = 0;
+    double elapsed;
+    const double start = wall_time();
+    do {
+        for (size_t idx = 0; idx < ESTIMATE_CALIBRATION_SIZE; ++idx) {
+            amplitudes[idx] *= phase;
+        }
+        ++num_rounds;
+        elapsed = wall_time() - start;
+    } while (elapsed < ESTIMATE_CALIBRATION_TIME);
+
+    volatile double sink = creal(amplitudes[num_rounds % ESTIMATE_CALIBRATION_SIZE]); // Keeps the loop alive
+    (void) sink;
+    free(amplitudes);
+    return (double) CMUL_FLOPS * ESTIMATE_CALIBRATION_SIZE * num_rounds / elapsed;
+}
+
+
+estimate_t
+estimate_run(
+    const knapsack_t* kp,
+    const qaoa_type_t qaoa_type,
+    const knapsack_type_t kp_type,
+    const int depth,
+    const int m,
+    const run_options_t* options,
+    const int num_threads,
+    const double flop_rate
+) {
+    estimate_t estimate;
+    memset(&estimate, 0, sizeof(estimate));
+    const num_t max_profit = kp_type == LINEAR ? profit_sum(kp) : quad_profit_sum(kp);
+    const size_t profit_bytes = (size_t) 1 << narrowest_profit_width(max_profit);
+    int pairs[kp->size][2];
+    const int num_pairs = qaoa_type == COPULA ? copula_mixer_pairs(kp->size, pairs) : 0;
+
+    double table_bytes = 0;
+    double generation_bytes = 0;
+    double layer_flops;
+    if (qaoa_type == QTG) {
+        double layer_sizes[kp->size + 1];
+        estimate.exact = qtg_layer_sizes(kp, ESTIMATE_MAX_CAPACITIES, layer_sizes);
+        estimate.num_states = layer_sizes[kp->size];
+        // Every node owns a bit string; the last step of qtg holds the previous layer and twice its size as children
+        const double string_bytes = (kp->size / 64 + 1) * sizeof(uint64_t) + ESTIMATE_MALLOC_OVERHEAD;
+        const double prev_layer = kp->size > 0 ? layer_sizes[kp->size - 1] : 1;
+        table_bytes = estimate.num_states * (sizeof(node_t) + string_bytes + profit_bytes);
+        generation_bytes = 3 * prev_layer * sizeof(node_t) + (prev_layer + estimate.num_states) * string_bytes;
+        layer_flops = estimate.num_states * (CEXP_FLOPS + CMUL_FLOPS + GROVER_FLOPS);
+    } else {
+        estimate.exact = TRUE;
+        estimate.num_states = ldexp(1, kp->size);
+        if (options->backend == STATEVECTOR) {
+            table_bytes = estimate.num_states / 8 + (kp_type == QUADRATIC ? estimate.num_states * profit_bytes : 0);
+        }
+        // Linear profits are applied from the factorised tables, i.e. without an exponential per state
+        layer_flops = estimate.num_states * ((kp_type == LINEAR ? 0 : CEXP_FLOPS) + CMUL_FLOPS
+                                             + num_pairs * COPULA_PAIR_FLOPS);
+    }
+
+    double state_bytes;
+    int num_workspaces;
+    if (options->backend == MPS) {
+        // One MPS per thread; a two-qubit gate decomposes a matrix of twice the bond dimension
+        const double bond = options->max_bond_dim;
+        state_bytes = ESTIMATE_MPS_COPIES * kp->size * 2 * bond * bond * sizeof(cmplx);
+        num_workspaces = num_threads;
+        layer_flops = num_pairs * 4 * pow(2 * bond, 3) * CMUL_FLOPS;
+        estimate.flops_per_eval = depth * layer_flops;
+    } else {
+        state_bytes = estimate.num_states * sizeof(cmplx);
+        num_workspaces = (int) MIN((double) num_threads, MAX(floor(workspace_budget(options) / state_bytes), 1));
+        estimate.flops_per_eval = depth * layer_flops + estimate.num_states * EXPECTATION_FLOPS;
+    }
+    // Initial state, serial workspace and the per-thread workspaces of the batch evaluations
+    estimate.peak_bytes = MAX(generation_bytes, table_bytes + (2 + num_workspaces) * state_bytes);
+
+    const int num_starts = MAX(options->num_starts, 1);
+    double search_evals, local_evals = (double) num_starts * ESTIMATE_LOCAL_EVALS * 2 * depth;
+    switch (options->grid) {
+        case GRID_ADAPTIVE:
+            search_evals = options->grid_budget > 0 ? options->grid_budget
+                                                    : (double) depth * m * m / ADAPTIVE_DEFAULT_SHARE;
+            break;
+        case GRID_FOURIER: {
+            const int beta_order = options->fourier_order > 0 ? options->fourier_order
+                                 : qaoa_type == QTG ? 1 : MAX(m / 4 - 1, 1);
+            search_evals = (double) depth * (m * (2 * beta_order + 1) + FOURIER_VERIFY_POINTS);
+            local_evals = (double) num_starts * FOURIER_REFINE_EVALS * 2 * depth;
+            break;
+        }
+        default:
+            search_evals = (double) depth * m * m;
+            break;
+    }
+    estimate.num_evals = search_evals + local_evals;
+    if (options->max_evals > 0) {
+        estimate.num_evals = MIN(estimate.num_evals, options->max_evals);
+    }
+
+    // The grid searches are spread over the threads, the local optimizations over the starts
+    const double search_seconds = MIN(search_evals, estimate.num_evals) * estimate.flops_per_eval
+                                  / (flop_rate * num_workspaces);
+    const double local_seconds = MAX(estimate.num_evals - search_evals, 0) * estimate.flops_per_eval
+                                 / (flop_rate * MIN(num_starts, num_threads));
+    estimate.seconds = search_seconds + local_seconds;
+    if (options->max_time > 0) {
+        estimate.seconds = MIN(estimate.seconds, options->max_time);
+    }
+    return estimate;
+}
@@ -0,0 +1,495 @@
+/*
+ * =============================================================================
+ *                            includes
+ * =============================================================================
+ */
+
+#include "results.h"
+#include "syslinks.h"
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define RESULT_NUM_FIELDS       14 // Fields of a record, from the tag to the checksum
+#define RESULTS_MIN_SLOTS       1024 // Initial slots of the hash table of a results index
+
+
+/*
+ * =============================================================================
+ *                                  Records
+ * =============================================================================
+ */
+
+static uint64_t
+fnv_hash(const char* data, const size_t num_bytes) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t byte = 0; byte < num_bytes; ++byte) {
+        hash = (hash ^ (unsigned char) data[byte]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+void
+format_result_params(
+    char params[256], const int m, const long long bias, const double k, const double theta, const char* options
+) {
+    char values[4][32];
+    strcpy(values[0], RESULT_UNKNOWN);
+    strcpy(values[1], RESULT_UNKNOWN);
+    strcpy(values[2], RESULT_UNKNOWN);
+    strcpy(values[3], RESULT_UNKNOWN);
+    if (m >= 0) {
+        sprintf(values[0], "%d", m);
+    }
+    if (bias >= 0) {
+        sprintf(values[1], "%lld", bias);
+    }
+    if (!isnan(k)) {
+        sprintf(values[2], "%g", k);
+    }
+    if (!isnan(theta)) {
+        sprintf(values[3], "%g", theta);
+    }
+    snprintf(params, 256, "m=%s bias=%s k=%s theta=%s%s%s", values[0], values[1], values[2], values[3],
+             options[0] != '\0' ? " " : "", options);
+}
+
+
+bool_t
+append_result(const char* path, const result_record_t* record) {
+    char line[RESULT_MAX_LINE];
+    const result_key_t* key = &record->key;
+    int length = snprintf(
+        line, sizeof(line), "%s\t%s\t%s\t%d\t%s\t%s\t%llu\t%lld\t%.6f\t%.6f\t%.6f\t%llu\t%.6f\t",
+        RESULT_TAG, key->instance, key->qaoa_type, key->depth, key->optimizer, key->params,
+        (unsigned long long) record->num_states, (long long) record->optimal_sol_val, record->greedy_ratio,
+        record->approx_ratio, record->prob_beating_greedy, (unsigned long long) record->num_evals, record->elapsed
+    );
+    if (length < 0 || length + 18 >= (int) sizeof(line)) { // Room for the checksum and the line break
+        return FALSE;
+    }
+    length += sprintf(line + length, "%016llx\n", (unsigned long long) fnv_hash(line, length));
+    return append_file(path, line, length);
+}
+
+
+static bool_t
+parse_fields(char* record_start, result_record_t* record) {
+    // The checksum covers everything up to and including the last tab
+    char* checksum = strrchr(record_start, '\t');
+    if (checksum == NULL) {
+        return FALSE;
+    }
+    ++checksum;
+    char* end;
+    const unsigned long long expected = strtoull(checksum, &end, 16);
+    if (end != checksum + 16 || expected != fnv_hash(record_start, checksum - record_start)) {
+        return FALSE;
+    }
+
+    char* fields[RESULT_NUM_FIELDS];
+    int num_fields = 0;
+    for (char* field = record_start; field != NULL && num_fields < RESULT_NUM_FIELDS; ++num_fields) {
+        fields[num_fields] = field;
+        char* tab = strchr(field, '\t');
+        if (tab != NULL) {
+            *tab++ = '\0';
+        }
+        field = tab;
+    }
+    if (num_fields != RESULT_NUM_FIELDS || fields[RESULT_NUM_FIELDS - 1] != checksum
+        || strcmp(fields[0], RESULT_TAG) != 0
+        || strlen(fields[1]) >= sizeof(record->key.instance) || strlen(fields[2]) >= sizeof(record->key.qaoa_type)
+        || strlen(fields[4]) >= sizeof(record->key.optimizer) || strlen(fields[5]) >= sizeof(record->key.params)) {
+        return FALSE;
+    }
+
+    memset(record, 0, sizeof(result_record_t));
+    strcpy(record->key.instance, fields[1]);
+    strcpy(record->key.qaoa_type, fields[2]);
+    record->key.depth = atoi(fields[3]);
+    strcpy(record->key.optimizer, fields[4]);
+    strcpy(record->key.params, fields[5]);
+    record->num_states = strtoull(fields[6], NULL, 10);
+    record->optimal_sol_val = (num_t) strtoll(fields[7], NULL, 10);
+    record->greedy_ratio = atof(fields[8]);
+    record->approx_ratio = atof(fields[9]);
+    record->prob_beating_greedy = atof(fields[10]);
+    record->num_evals = strtoull(fields[11], NULL, 10);
+    record->elapsed = atof(fields[12]);
+    return TRUE;
+}
+
+
+bool_t
+parse_result(const char* line, result_record_t* record) {
+    char copy[RESULT_MAX_LINE];
+    if (strlen(line) >= sizeof(copy)) {
+        return FALSE;
+    }
+    strcpy(copy, line);
+    copy[strcspn(copy, "\r\n")] = '\0';
+
+    // A record torn by a crash is continued by the next write on the same line, so the last tag starts the record
+    char* record_start = NULL;
+    for (char* tag = strstr(copy, RESULT_TAG "\t"); tag != NULL; tag = strstr(tag + 1, RESULT_TAG "\t")) {
+        record_start = tag;
+    }
+    return record_start != NULL && parse_fields(record_start, record);
+}
+
+
+/*
+ * =============================================================================
+ *                                   Index
+ * =============================================================================
+ */
+
+static uint64_t
+key_hash(const result_key_t* key) {
+    char joined[sizeof(result_key_t) + 16];
+    const int length = snprintf(joined, sizeof(joined), "%s\t%s\t%d\t%s\t%s", key->instance, key->qaoa_type,
+                                key->depth, key->optimizer, key->params);
+    return fnv_hash(joined, length);
+}
+
+
+static bool_t
+same_key(const result_key_t* first, const result_key_t* second) {
+    return first->depth == second->depth && strcmp(first->instance, second->instance) == 0
+        && strcmp(first->qaoa_type, second->qaoa_type) == 0 && strcmp(first->optimizer, second->optimizer) == 0
+        && strcmp(first->params, second->params) == 0;
+}
+
+
+static int
+imported_keys(const result_key_t* key, result_key_t* imported) {
+    // Keys an import of the results tree writes for the same run: only k and theta known, or nothing known
+    if (strncmp(key->params, "m=" RESULT_UNKNOWN, strlen("m=" RESULT_UNKNOWN)) == 0) {
+        return 0; // Imported itself
+    }
+    int num_imported = 0;
+    double k, theta;
+    const char* copula = strstr(key->params, " k=");
+    if (copula != NULL && sscanf(copula, " k=%lf theta=%lf", &k, &theta) == 2) {
+        imported[num_imported] = *key;
+        format_result_params(imported[num_imported++].params, -1, -1, k, theta, "");
+    }
+    imported[num_imported] = *key;
+    format_result_params(imported[num_imported++].params, -1, -1, NAN, NAN, "");
+    return num_imported;
+}
+
+
+static size_t
+find_slot(const results_index_t* index, const result_key_t* key) {
+    // The slot of the key, or else the free slot at which its probing ends
+    size_t slot = (size_t) key_hash(key) & (index->num_slots - 1);
+    while (index->slots[slot] != 0 && !same_key(&index->records[index->slots[slot] - 1].key, key)) {
+        slot = (slot + 1) & (index->num_slots - 1);
+    }
+    return slot;
+}
+
+
+static void
+remove_slot(results_index_t* index, size_t slot) {
+    // Backward-shift deletion, so that the freed slot ends no probing sequence of another key
+    const size_t mask = index->num_slots - 1;
+    for (size_t next = (slot + 1) & mask; index->slots[next] != 0; next = (next + 1) & mask) {
+        const size_t home = (size_t) key_hash(&index->records[index->slots[next] - 1].key) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) { // Its home is not between the gap and itself
+            index->slots[slot] = index->slots[next];
+            slot = next;
+        }
+    }
+    index->slots[slot] = 0;
+}
+
+
+static void
+init_results_index(results_index_t* index) {
+    memset(index, 0, sizeof(results_index_t));
+    index->capacity = RESULTS_MIN_SLOTS / 2;
+    index->records = malloc(index->capacity * sizeof(result_record_t));
+    index->num_slots = RESULTS_MIN_SLOTS;
+    index->slots = calloc(index->num_slots, sizeof(size_t));
+}
+
+
+static void
+index_record(results_index_t* index, const result_record_t* record) {
+    size_t slot = find_slot(index, &record->key);
+    if (index->slots[slot] != 0) { // A later run of the same key supersedes the earlier one
+        index->records[index->slots[slot] - 1] = *record;
+        ++index->num_superseded;
+        return;
+    }
+
+    // A live run supersedes the record an earlier import wrote for it, which keeps its position among the records
+    result_key_t imported[2];
+    const int num_imported = imported_keys(&record->key, imported);
+    for (int idx = 0; idx < num_imported; ++idx) {
+        const size_t imported_slot = find_slot(index, imported + idx);
+        if (index->slots[imported_slot] != 0) {
+            const size_t position = index->slots[imported_slot] - 1;
+            remove_slot(index, imported_slot);
+            index->records[position] = *record;
+            index->slots[find_slot(index, &record->key)] = position + 1;
+            ++index->num_superseded;
+            return;
+        }
+    }
+
+    if (index->num_records == index->capacity) {
+        index->capacity *= 2;
+        index->records = realloc(index->records, index->capacity * sizeof(result_record_t));
+    }
+    index->records[index->num_records++] = *record;
+    index->slots[slot] = index->num_records;
+
+    // Keep the load below one half by rehashing into twice as many slots
+    if (2 * index->num_records > index->num_slots) {
+        free(index->slots);
+        index->num_slots *= 2;
+        index->slots = calloc(index->num_slots, sizeof(size_t));
+        for (size_t idx = 0; idx < index->num_records; ++idx) {
+            index->slots[find_slot(index, &index->records[idx].key)] = idx + 1;
+        }
+    }
+}
+
+
+bool_t
+load_results_index(const char* path, results_index_t* index) {
+    memset(index, 0, sizeof(results_index_t));
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return FALSE;
+    }
+    init_results_index(index);
+
+    char line[RESULT_MAX_LINE];
+    result_record_t record;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strchr(line, '\n') == NULL && !feof(file)) { // Overlong lines are no records; skip their remainder
+            int ch;
+            while ((ch = fgetc(file)) != EOF && ch != '\n') {}
+            ++index->num_damaged;
+            continue;
+        }
+        if (line[0] == '\n') {
+            continue;
+        }
+        if (parse_result(line, &record)) {
+            index_record(index, &record);
+        } else {
+            ++index->num_damaged;
+        }
+    }
+    fclose(file);
+    return TRUE;
+}
+
+
+const result_record_t*
+lookup_result(const results_index_t* index, const result_key_t* key) {
+    if (index->num_slots == 0) {
+        return NULL;
+    }
+    size_t slot = find_slot(index, key);
+    if (index->slots[slot] == 0) { // Fall back to the history imported from a results tree
+        result_key_t imported[2];
+        const int num_imported = imported_keys(key, imported);
+        for (int idx = 0; idx < num_imported && index->slots[slot] == 0; ++idx) {
+            slot = find_slot(index, imported + idx);
+        }
+    }
+    return index->slots[slot] != 0 ? &index->records[index->slots[slot] - 1] : NULL;
+}
+
+
+void
+free_results_index(results_index_t* index) {
+    free(index->records);
+    free(index->slots);
+    memset(index, 0, sizeof(results_index_t));
+}
+
+
+/*
+ * =============================================================================
+ *                                   Import
+ * =============================================================================
+ */
+
+static void
+free_names(char** names, const int64_t num_names) {
+    for (int64_t idx = 0; idx < num_names; ++idx) {
+        free(names[idx]);
+    }
+    if (num_names >= 0) {
+        free(names);
+    }
+}
+
+
+static bool_t
+read_results_file(const char* dir, result_record_t* record) {
+    char path[2048];
+    snprintf(path, sizeof(path), "%s%cresults.txt", dir, path_sep());
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return FALSE;
+    }
+    unsigned long long num_states;
+    long long optimal_sol_val;
+    const bool_t valid = fscanf(file, "%llu %lld %lf %lf %lf", &num_states, &optimal_sol_val, &record->greedy_ratio,
+                                &record->approx_ratio, &record->prob_beating_greedy) == 5;
+    fclose(file);
+    record->num_states = num_states;
+    record->optimal_sol_val = (num_t) optimal_sol_val;
+
+    // The summary of the angle optimization only exists for newer runs
+    snprintf(path, sizeof(path), "%s%csummary.txt", dir, path_sep());
+    record->num_evals = 0;
+    record->elapsed = 0;
+    file = fopen(path, "r");
+    if (file != NULL) {
+        char line[256];
+        while (fgets(line, sizeof(line), file) != NULL) {
+            if (strncmp(line, "evaluations=", 12) == 0) {
+                record->num_evals = strtoull(line + 12, NULL, 10);
+            } else if (strncmp(line, "elapsed_seconds=", 16) == 0) {
+                record->elapsed = atof(line + 16);
+            }
+        }
+        fclose(file);
+    }
+    return valid;
+}
+
+
+static void
+index_known_runs(const char* path, results_index_t* known) {
+    // Keys under which an import would write the runs the log holds already, whether imported or written live
+    init_results_index(known);
+    results_index_t logged;
+    if (!load_results_index(path, &logged)) {
+        return;
+    }
+    for (size_t idx = 0; idx < logged.num_records; ++idx) {
+        result_record_t record = logged.records[idx];
+        result_key_t imported[2];
+        const int num_imported = imported_keys(&record.key, imported);
+        if (num_imported == 0) {
+            index_record(known, &record);
+        }
+        for (int general = 0; general < num_imported; ++general) {
+            record.key = imported[general];
+            index_record(known, &record);
+        }
+    }
+    free_results_index(&logged);
+}
+
+
+static int64_t
+import_run(const result_record_t* record, const char* path, const results_index_t* known) {
+    if (lookup_result(known, &record->key) != NULL) {
+        return 0;
+    }
+    return append_result(path, record) ? 1 : -1;
+}
+
+
+static int64_t
+import_optimizer_dir(const char* dir, result_record_t* record, const char* path, const results_index_t* known) {
+    // Results of a single run, or one subdirectory per run of a Copula sweep
+    if (read_results_file(dir, record)) {
+        format_result_params(record->key.params, -1, -1, NAN, NAN, "");
+        return import_run(record, path, known);
+    }
+    char** labels;
+    const int64_t num_labels = list_dir(dir, &labels);
+    int64_t num_imported = 0;
+    for (int64_t idx = 0; idx < num_labels && num_imported >= 0; ++idx) {
+        char label_dir[2048];
+        double k, theta;
+        snprintf(label_dir, sizeof(label_dir), "%s%c%s", dir, path_sep(), labels[idx]);
+        if (sscanf(labels[idx], "k_%lf_theta_%lf", &k, &theta) != 2 || !read_results_file(label_dir, record)) {
+            continue;
+        }
+        format_result_params(record->key.params, -1, -1, k, theta, "");
+        const int64_t num_runs = import_run(record, path, known);
+        num_imported = num_runs < 0 ? -1 : num_imported + num_runs;
+    }
+    free_names(labels, num_labels);
+    return num_imported;
+}
+
+
+int64_t
+import_results_tree(const char* root, const char* path) {
+    char** instances;
+    const int64_t num_instances = list_dir(root, &instances);
+    if (num_instances < 0) {
+        return -1;
+    }
+
+    int64_t num_imported = 0;
+    result_record_t record;
+    memset(&record, 0, sizeof(record));
+    results_index_t known;
+    index_known_runs(path, &known);
+    for (int64_t inst = 0; inst < num_instances && num_imported >= 0; ++inst) {
+        if (strlen(instances[inst]) >= sizeof(record.key.instance)) {
+            continue;
+        }
+        strcpy(record.key.instance, instances[inst]);
+        char inst_dir[1024];
+        snprintf(inst_dir, sizeof(inst_dir), "%s%c%s", root, path_sep(), instances[inst]);
+        char** types;
+        const int64_t num_types = list_dir(inst_dir, &types); // Negative for files such as the instance itself
+        for (int64_t type = 0; type < num_types && num_imported >= 0; ++type) {
+            if (strlen(types[type]) >= sizeof(record.key.qaoa_type)) {
+                continue;
+            }
+            strcpy(record.key.qaoa_type, types[type]);
+            char type_dir[1400];
+            snprintf(type_dir, sizeof(type_dir), "%s%c%s", inst_dir, path_sep(), types[type]);
+            char** depths;
+            const int64_t num_depths = list_dir(type_dir, &depths);
+            for (int64_t depth = 0; depth < num_depths && num_imported >= 0; ++depth) {
+                if (sscanf(depths[depth], "p_%d", &record.key.depth) != 1) {
+                    continue; // e.g. the resource counts
+                }
+                char depth_dir[1600];
+                snprintf(depth_dir, sizeof(depth_dir), "%s%c%s", type_dir, path_sep(), depths[depth]);
+                char** optimizers;
+                const int64_t num_optimizers = list_dir(depth_dir, &optimizers);
+                for (int64_t opt = 0; opt < num_optimizers && num_imported >= 0; ++opt) {
+                    if (strlen(optimizers[opt]) >= sizeof(record.key.optimizer)) {
+                        continue;
+                    }
+                    strcpy(record.key.optimizer, optimizers[opt]);
+                    char opt_dir[1800];
+                    snprintf(opt_dir, sizeof(opt_dir), "%s%c%s", depth_dir, path_sep(), optimizers[opt]);
+                    const int64_t num_runs = import_optimizer_dir(opt_dir, &record, path, &known);
+                    num_imported = num_runs < 0 ? -1 : num_imported + num_runs;
+                }
+                free_names(optimizers, num_optimizers);
+            }
+            free_names(depths, num_depths);
+        }
+        free_names(types, num_types);
+    }
+    free_names(instances, num_instances);
+    free_results_index(&known);
+    return num_imported;
+}
@@ -0,0 +1,649 @@
+/*
+ * =============================================================================
+ *                            includes
+ * =============================================================================
+ */
+
+#include "runner.h"
+#include "batch.h"
+#include "syslinks.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define RUNNER_MEMORY_SHARE     0.8 // Share of the physical memory the running jobs may use by default
+
+
+/*
+ * =============================================================================
+ *                                   Jobs
+ * =============================================================================
+ */
+
+bool_t
+parse_kp_type(const char* name, knapsack_type_t* kp_type) {
+    if (strcmp(name, "linear") == 0) {
+        *kp_type = LINEAR;
+    } else if (strcmp(name, "quadratic") == 0) {
+        *kp_type = QUADRATIC;
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+bool_t
+parse_job(const char* line, const int line_number, const knapsack_type_t kp_type, job_t* job) {
+    char buffer[4096];
+    char input_qaoa_type[16], input_opt_type[16], input_p[32];
+    char input_k[512], input_theta[512];
+    int bias;
+    int num_consumed = 0;
+
+    memset(job, 0, sizeof(job_t));
+    job->line = line_number;
+    job->kp_type = kp_type;
+    snprintf(buffer, sizeof(buffer), "%s", line);
+    if (sscanf(
+            buffer,
+            "%1023s %15s %31s %15s %d %d %511s %511s %d%n",
+            job->instance, input_qaoa_type, input_p, input_opt_type, &job->m, &bias, input_k, input_theta,
+            &job->memory_size, &num_consumed
+        ) < 9) {
+        printf("Error: Line %d has fewer than the nine mandatory fields.\n", line_number);
+        return FALSE;
+    }
+    job->bias = bias;
+
+    if (strcmp(input_qaoa_type, "qtg") == 0) {
+        job->qaoa_type = QTG;
+    } else if (strcmp(input_qaoa_type, "copula") == 0) {
+        job->qaoa_type = COPULA;
+    } else {
+        printf("Error: Input for QAOA type in line %d does not match any of the permitted values.\n", line_number);
+        return FALSE;
+    }
+
+    // p may be a range such as 1-9, which requests a sweep over all depths in between
+    char* range_end;
+    job->min_depth = (int) strtol(input_p, &range_end, 10);
+    job->max_depth = *range_end == '-' ? (int) strtol(range_end + 1, &range_end, 10) : job->min_depth;
+    if (*range_end != '\0' || job->min_depth < 1 || job->max_depth < job->min_depth) {
+        printf("Error: Input for p in line %d is neither a positive depth nor a range of depths.\n", line_number);
+        return FALSE;
+    }
+
+    if (strcmp(input_opt_type, "powell") == 0) {
+        job->opt_type = POWELL;
+    } else if (strcmp(input_opt_type, "nelder-mead") == 0) {
+        job->opt_type = NELDER_MEAD;
+    } else if (strcmp(input_opt_type, "bfgs") == 0) {
+        job->opt_type = BFGS;
+    } else {
+        printf("Error: Input for optimization type in line %d does not match any of the permitted values.\n",
+               line_number);
+        return FALSE;
+    }
+
+    // k and theta may be comma-separated lists, which requests a sweep over all their combinations
+    job->num_ks = parse_value_list(input_k, job->ks, MAX_SWEEP_VALUES);
+    job->num_thetas = parse_value_list(input_theta, job->thetas, MAX_SWEEP_VALUES);
+    if (job->num_ks == 0 || job->num_thetas == 0) {
+        printf("Error: Input for k or theta in line %d is not a number or a comma-separated list of numbers.\n",
+               line_number);
+        return FALSE;
+    }
+    const bool_t sweep = job->num_ks > 1 || job->num_thetas > 1;
+    if (sweep && job->qaoa_type != COPULA) {
+        printf("Error: Sweeps over k and theta in line %d are only supported for the Copula QAOA.\n", line_number);
+        return FALSE;
+    }
+    if (sweep && job->max_depth > job->min_depth) {
+        printf("Error: Sweeps over k and theta in line %d cannot be combined with a range of depths.\n", line_number);
+        return FALSE;
+    }
+
+    // Optional key=value tokens after the mandatory fields
+    job->options = default_run_options();
+    for (char* token = strtok(buffer + num_consumed, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+        if (strncmp(token, "kp=", 3) == 0) { // Objective function of this line instead of the one of the benchmark
+            if (!parse_kp_type(token + 3, &job->kp_type)) {
+                printf("Error: Input for kp in line %d is neither linear nor quadratic.\n", line_number);
+                return FALSE;
+            }
+            continue;
+        }
+        if (!parse_run_option(&job->options, token)) {
+            printf("Error: Invalid run option %s in line %d.\n", token, line_number);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+int
+read_jobs(const char* path, const knapsack_type_t kp_type, job_t** jobs) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Error: Could not open %s.\n", path);
+        return -1;
+    }
+
+    char line[4096];
+    int line_number = 0;
+    int num_jobs = 0;
+    int capacity = 0;
+    *jobs = NULL;
+    while (fgets(line, sizeof(line), file)) {
+        ++line_number;
+        if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) { // Comments and empty lines are ignored
+            continue;
+        }
+        if (num_jobs == capacity) {
+            capacity = MAX(2 * capacity, 16);
+            *jobs = realloc(*jobs, capacity * sizeof(job_t));
+        }
+        if (!parse_job(line, line_number, kp_type, *jobs + num_jobs)) {
+            fclose(file);
+            free(*jobs);
+            *jobs = NULL;
+            return -1;
+        }
+        ++num_jobs;
+    }
+    fclose(file);
+    return num_jobs;
+}
+
+
+knapsack_t*
+load_job_knapsack(const job_t* job, const bool_t verbose) {
+    char path_to_instance[1100];
+    knapsack_t* kp = NULL;
+    switch (job->kp_type) {
+        case LINEAR:
+            sprintf(path_to_instance, "..%cinstances%c%s%ctest.in", path_sep(), path_sep(), job->instance,
+                    path_sep());
+            if (file_exists(path_to_instance)) {
+                kp = create_jooken_knapsack(path_to_instance);
+            }
+            if (kp != NULL && verbose) {
+                print_knapsack(kp);
+            }
+            break;
+        case QUADRATIC:
+            sprintf(path_to_instance, "..%cinstances%c%s%cquad_knap.txt", path_sep(), path_sep(), job->instance,
+                    path_sep());
+            if (file_exists(path_to_instance)) {
+                kp = create_quadratic_knapsack(path_to_instance);
+            }
+            if (kp != NULL && verbose) {
+                printf("%s", path_to_instance);
+                print_quadratic_knapsack(kp);
+            }
+            break;
+    }
+    if (kp == NULL) {
+        printf("Error: Could not read the instance %s.\n", path_to_instance);
+    }
+    return kp;
+}
+
+
+void
+estimate_job(job_t* job, const knapsack_t* kp, const int num_threads, const double flop_rate) {
+    const int num_combinations = job->num_ks * job->num_thetas;
+    memset(&job->estimate, 0, sizeof(estimate_t));
+    for (int depth = job->min_depth; depth <= job->max_depth; ++depth) {
+        const estimate_t run = estimate_run(kp, job->qaoa_type, job->kp_type, depth, job->m, &job->options,
+                                            num_threads, flop_rate);
+        job->estimate.num_states = run.num_states;
+        job->estimate.exact = run.exact;
+        job->estimate.peak_bytes = MAX(job->estimate.peak_bytes, run.peak_bytes);
+        job->estimate.flops_per_eval = MAX(job->estimate.flops_per_eval, run.flops_per_eval);
+        job->estimate.num_evals += num_combinations * run.num_evals;
+        job->estimate.seconds += num_combinations * run.seconds;
+    }
+    if (num_combinations > 1) { // The workers of a Copula sweep run concurrently
+        const int num_sweep_workers = MIN(MAX(job->options.num_workers, 1), num_combinations);
+        job->estimate.peak_bytes *= num_sweep_workers;
+        job->estimate.seconds /= num_sweep_workers;
+    }
+}
+
+
+bool_t
+print_estimates(job_t* jobs, const int num_jobs, int max_workers) {
+    if (max_workers == 0) {
+        max_workers = (int) num_processors();
+    }
+    const int num_threads = (int) MAX(num_processors() / MAX(MIN(max_workers, num_jobs), 1), 1);
+    const double flop_rate = measure_flop_rate();
+    printf("\n===== Estimates for %d threads per job at %.2f GFLOP/s per thread =====\n", num_threads,
+           flop_rate / 1e9);
+    printf("%6s  %-40s %-7s %-6s %14s %12s %12s %12s %12s\n", "line", "instance", "qaoa", "p", "states", "MiB",
+           "GFLOP/eval", "evals", "seconds");
+
+    double max_bytes = 0, tot_seconds = 0;
+    for (int idx = 0; idx < num_jobs; ++idx) {
+        job_t* job = jobs + idx;
+        knapsack_t* kp = load_job_knapsack(job, FALSE);
+        if (kp == NULL) {
+            return FALSE;
+        }
+        estimate_job(job, kp, num_threads, flop_rate);
+        free_knapsack(kp);
+
+        char depths[32];
+        if (job->max_depth > job->min_depth) {
+            sprintf(depths, "%d-%d", job->min_depth, job->max_depth);
+        } else {
+            sprintf(depths, "%d", job->min_depth);
+        }
+        printf("%6d  %-40s %-7s %-6s %s%12.6g %12.1f %12.4g %12.6g %12.4g\n", job->line, job->instance,
+               job->qaoa_type == QTG ? "qtg" : "copula", depths, job->estimate.exact ? "  " : "<=",
+               job->estimate.num_states, job->estimate.peak_bytes / 1048576.0, job->estimate.flops_per_eval / 1e9,
+               job->estimate.num_evals, job->estimate.seconds);
+        max_bytes = MAX(max_bytes, job->estimate.peak_bytes);
+        tot_seconds += job->estimate.seconds;
+    }
+    printf("Largest job needs %.1f MiB; all jobs take %.4g s serially\n", max_bytes / 1048576.0, tot_seconds);
+    return TRUE;
+}
+
+
+instance_context_t*
+prepare_job(const job_t* job) {
+    printf("\n===== Instance =====\n");
+    printf("Instance = %s\n", job->instance);
+    knapsack_t* kp = load_job_knapsack(job, TRUE);
+    if (kp == NULL) {
+        return NULL;
+    }
+    instance_context_t* prepared = prepare_instance_context(kp, job->qaoa_type, job->bias, job->kp_type,
+                                                            &job->options);
+    if (prepared == NULL) {
+        free_knapsack(kp);
+    }
+    return prepared;
+}
+
+
+bool_t
+same_preparation(const job_t* first, const job_t* second) {
+    return strcmp(first->instance, second->instance) == 0 && first->qaoa_type == second->qaoa_type
+        && first->kp_type == second->kp_type && first->options.backend == second->options.backend
+        && (first->qaoa_type != QTG || first->bias == second->bias);
+}
+
+
+static void
+print_job(const job_t* job) {
+    printf("\n===== Input parameters =====\n");
+    printf("Instance = %s\n", job->instance);
+    printf("QAOA type = %s\n", job->qaoa_type == QTG ? "qtg" : "copula");
+    printf("Objective = %s\n", job->kp_type == LINEAR ? "linear" : "quadratic");
+    if (job->max_depth > job->min_depth) {
+        printf("p = %d-%d\n", job->min_depth, job->max_depth);
+    } else {
+        printf("p = %d\n", job->min_depth);
+    }
+    printf("Optimization type = %s\n",
+           job->opt_type == POWELL ? "powell" : job->opt_type == NELDER_MEAD ? "nelder-mead" : "bfgs");
+    printf("m = %d\n", job->m);
+    if (job->qaoa_type == QTG) {
+        printf("bias = %zu\n", job->bias);
+    }
+    printf("k = %g", job->ks[0]);
+    for (int idx = 1; idx < job->num_ks; ++idx) {
+        printf(",%g", job->ks[idx]);
+    }
+    printf("\ntheta = %g", job->thetas[0]);
+    for (int idx = 1; idx < job->num_thetas; ++idx) {
+        printf(",%g", job->thetas[idx]);
+    }
+    printf("\n");
+    if (job->opt_type == BFGS) {
+        printf("Memory size for BFGS = %d\n", job->memory_size);
+    }
+    if (job->options.backend == MPS) {
+        printf("Backend = mps (maximal bond dimension %d)\n", job->options.max_bond_dim);
+    }
+}
+
+
+bool_t
+run_job(const job_t* job, instance_context_t* prepared) {
+    if (prepared == NULL) {
+        return FALSE;
+    }
+    print_job(job);
+
+    if (job->max_depth > job->min_depth) {
+        depth_sweep(
+            job->instance, prepared, job->min_depth, job->max_depth, job->opt_type, job->m, job->ks[0],
+            job->thetas[0], job->memory_size, &job->options
+        );
+    } else if (job->num_ks > 1 || job->num_thetas > 1) {
+        copula_sweep(
+            job->instance, prepared, job->min_depth, job->opt_type, job->m, job->ks, job->num_ks, job->thetas,
+            job->num_thetas, job->memory_size, &job->options
+        );
+    } else {
+        qaoa(
+            job->instance, prepared, job->min_depth, job->opt_type, job->m, job->ks[0], job->thetas[0],
+            job->memory_size, &job->options
+        );
+    }
+    return TRUE;
+}
+
+
+/*
+ * =============================================================================
+ *                                 Scheduling
+ * =============================================================================
+ */
+
+static int*
+group_jobs(const job_t* jobs, const int num_jobs, int* num_pending) {
+    int* leaders = malloc(num_jobs * sizeof(int)); // First job of the group of every job
+    for (int idx = 0; idx < num_jobs; ++idx) {
+        leaders[idx] = idx;
+        for (int prev = 0; prev < idx; ++prev) {
+            if (same_preparation(jobs + prev, jobs + idx)) {
+                leaders[idx] = leaders[prev];
+                break;
+            }
+        }
+        ++num_pending[leaders[idx]];
+    }
+    return leaders;
+}
+
+
+static instance_context_t*
+acquire_preparation(const job_t* jobs, const int idx, const int* leaders, instance_context_t** prepared) {
+    const int leader = leaders[idx];
+    if (prepared[leader] == NULL) { // The first job of a group prepares the instance for all others
+        prepared[leader] = prepare_job(jobs + idx);
+    }
+    return prepared[leader];
+}
+
+
+static double
+release_preparation(const int leader, instance_context_t** prepared) {
+    const double bytes = instance_context_bytes(prepared[leader]);
+    release_instance_context(prepared[leader]);
+    prepared[leader] = NULL;
+    return bytes;
+}
+
+
+static double
+finish_preparation(const int idx, const int* leaders, int* num_pending, instance_context_t** prepared) {
+    // Returns the bytes released, if this was the last pending job of its group
+    const int leader = leaders[idx];
+    if (--num_pending[leader] == 0 && prepared[leader] != NULL) {
+        return release_preparation(leader, prepared);
+    }
+    return 0;
+}
+
+
+static bool_t
+batchable_job(const job_t* job, const instance_context_t* prepared) {
+    // A single QTG run of a small instance whose search is the plain fine-grid search from scratch
+    const run_options_t* options = &job->options;
+    return prepared != NULL && prepared->num_states <= BATCH_MAX_STATES && job->qaoa_type == QTG
+        && options->backend == STATEVECTOR && job->max_depth == job->min_depth && job->num_ks == 1
+        && job->num_thetas == 1 && options->init == INIT_GRID && options->grid == GRID_UNIFORM
+        && options->num_starts == 1 && options->max_evals == 0 && options->max_time == 0 && !options->resume;
+}
+
+
+static void
+run_job_batch(const job_t* jobs, const int num_jobs, instance_context_t** job_prepared) {
+    const int depth = jobs[0].min_depth;
+    const size_t angle_size = 2 * depth;
+    double* best_angles = malloc(num_jobs * angle_size * sizeof(double));
+    double* best_values = malloc(num_jobs * sizeof(double));
+
+    printf("\n===== Lockstep grid search of %d instances =====\n", num_jobs);
+    const double start_time = wall_time();
+    batch_t* batch = create_batch(job_prepared, num_jobs, depth);
+    const size_t num_evals = batch_grid_search(batch, jobs[0].m, best_angles, best_values);
+    printf("%zu amplitudes, %zu evaluations per instance in %.2f s\n", batch->num_amplitudes, num_evals,
+           wall_time() - start_time);
+    free_batch(batch);
+
+    // The local optimizations stay serial, each starting from the best grid point of its instance
+    for (int idx = 0; idx < num_jobs; ++idx) {
+        const job_t* job = jobs + idx;
+        print_job(job);
+        qaoa_context_t* ctx = create_shared_context(job_prepared[idx], depth, job->opt_type, job->m, job->ks[0],
+                                                    job->thetas[0], job->memory_size, &job->options);
+        if (ctx == NULL) {
+            continue;
+        }
+        ctx->grid_starts = best_angles + idx * angle_size;
+        ctx->grid_values = best_values + idx;
+        ctx->num_grid_evals = num_evals;
+        free(run_qaoa(ctx, job->instance, job_prepared[idx]->int_greedy_sol_val, job_prepared[idx]->optimal_sol_val,
+                      NULL));
+        export_resource_counts(ctx, job->instance);
+        free_context(ctx);
+    }
+    free(best_angles);
+    free(best_values);
+}
+
+
+static int
+run_jobs_serially(const job_t* jobs, const int num_jobs) {
+    int* num_pending = calloc(num_jobs, sizeof(int));
+    instance_context_t** prepared = calloc(num_jobs, sizeof(instance_context_t*));
+    int* leaders = group_jobs(jobs, num_jobs, num_pending);
+    instance_context_t* job_prepared[BATCH_MAX_INSTANCES];
+    int num_failed = 0;
+    for (int idx = 0; idx < num_jobs;) {
+        // Consecutive small QTG runs of the same depth and grid are searched in lockstep
+        job_prepared[0] = acquire_preparation(jobs, idx, leaders, prepared);
+        int num_batched = 1;
+        while (batchable_job(jobs + idx, job_prepared[0]) && idx + num_batched < num_jobs
+               && num_batched < BATCH_MAX_INSTANCES) {
+            const job_t* next = jobs + idx + num_batched;
+            if (next->min_depth != jobs[idx].min_depth || next->m != jobs[idx].m) {
+                break;
+            }
+            job_prepared[num_batched] = acquire_preparation(jobs, idx + num_batched, leaders, prepared);
+            if (!batchable_job(next, job_prepared[num_batched])) {
+                break; // Its preparation is kept for its own run
+            }
+            ++num_batched;
+        }
+
+        if (num_batched > 1) {
+            run_job_batch(jobs + idx, num_batched, job_prepared);
+        } else {
+            num_failed += !run_job(jobs + idx, job_prepared[0]);
+        }
+        for (int member = 0; member < num_batched; ++member) {
+            finish_preparation(idx + member, leaders, num_pending, prepared);
+        }
+        idx += num_batched;
+    }
+    free(leaders);
+    free(prepared);
+    free(num_pending);
+    return num_failed;
+}
+
+
+static int
+compare_jobs(const void* job1, const void* job2) {
+    const job_t* first = job1;
+    const job_t* second = job2;
+    if (first->estimate.seconds != second->estimate.seconds) {
+        return first->estimate.seconds < second->estimate.seconds ? 1 : -1; // Longest jobs first
+    }
+    if (first->estimate.peak_bytes != second->estimate.peak_bytes) {
+        return first->estimate.peak_bytes < second->estimate.peak_bytes ? 1 : -1;
+    }
+    return first->line - second->line;
+}
+
+
+int
+run_jobs(job_t* jobs, const int num_jobs, int max_workers, uint64_t max_memory, const char* log_dir) {
+    int num_failed = 0;
+    if (max_workers == 0) {
+        max_workers = (int) num_processors();
+    }
+    max_workers = MIN(max_workers, num_jobs);
+    if (max_workers <= 1 || num_jobs <= 1) {
+        for (int idx = 0; idx < num_jobs; ++idx) {
+            jobs[idx].options.max_memory = max_memory;
+        }
+        return run_jobs_serially(jobs, num_jobs);
+    }
+
+    if (max_memory == 0) {
+        max_memory = (uint64_t) (RUNNER_MEMORY_SHARE * physical_memory());
+    }
+    const int num_threads = (int) MAX(num_processors() / max_workers, 1); // Share the processors among workers
+    const double flop_rate = measure_flop_rate();
+    for (int idx = 0; idx < num_jobs; ++idx) {
+        if (jobs[idx].options.num_workers == 0) {
+            jobs[idx].options.num_workers = 1; // Copula sweeps must not claim all processors for themselves
+        }
+        jobs[idx].options.max_memory = max_memory / max_workers; // Bounds the workspaces of its batch evaluations
+        knapsack_t* kp = load_job_knapsack(jobs + idx, FALSE);
+        if (kp == NULL) {
+            return num_jobs;
+        }
+        estimate_job(jobs + idx, kp, num_threads, flop_rate);
+        free_knapsack(kp);
+    }
+    qsort(jobs, num_jobs, sizeof(job_t), compare_jobs);
+    printf("\n===== Running %d jobs with up to %d workers of %d threads in %.1f GiB =====\n", num_jobs, max_workers,
+           num_threads, max_memory / 1073741824.0);
+
+    int* num_pending = calloc(num_jobs, sizeof(int));
+    instance_context_t** prepared = calloc(num_jobs, sizeof(instance_context_t*));
+    int* leaders = group_jobs(jobs, num_jobs, num_pending);
+    int64_t* pids = calloc(num_jobs, sizeof(int64_t));
+    bool_t* started = calloc(num_jobs, sizeof(bool_t));
+    int num_started = 0;
+    int num_running = 0;
+    double used_memory = 0; // Estimated peaks of the running jobs and the preparations held by the parent
+    while (num_started < num_jobs || num_running > 0) {
+        // Start the longest pending job that fits, as long as workers are free
+        int next = -1;
+        for (int idx = 0; idx < num_jobs && num_running < max_workers; ++idx) {
+            if (!started[idx] && (num_running == 0 || used_memory + jobs[idx].estimate.peak_bytes <= max_memory)) {
+                next = idx;
+                break;
+            }
+        }
+        if (next < 0 && num_running < max_workers) {
+            // Preparations of groups none of whose pending jobs fits are released and rebuilt once one does
+            for (int leader = 0; leader < num_jobs; ++leader) {
+                bool_t admissible = FALSE;
+                for (int idx = 0; idx < num_jobs && prepared[leader] != NULL && !admissible; ++idx) {
+                    admissible = !started[idx] && leaders[idx] == leader
+                        && used_memory + jobs[idx].estimate.peak_bytes <= max_memory;
+                }
+                if (prepared[leader] != NULL && !admissible) {
+                    used_memory -= release_preparation(leader, prepared);
+                }
+            }
+        }
+        if (next >= 0) {
+            const job_t* job = jobs + next;
+            started[next] = TRUE;
+            ++num_started;
+            if (job->estimate.peak_bytes > max_memory) {
+                printf("Warning: Line %d needs an estimated %.1f MiB beyond the limit and runs alone.\n", job->line,
+                       job->estimate.peak_bytes / 1048576.0);
+            }
+            printf("Starting line %d (%s, estimated %.1f MiB)\n", job->line, job->instance,
+                   job->estimate.peak_bytes / 1048576.0);
+            // Workers inherit the preparation of a group from the parent; the only job of a group prepares its own
+            const int leader = leaders[next];
+            instance_context_t* job_prepared = NULL;
+            if (num_pending[leader] > 1 || prepared[leader] != NULL) {
+                const bool_t held = prepared[leader] != NULL;
+                job_prepared = acquire_preparation(jobs, next, leaders, prepared);
+                if (!held && job_prepared != NULL) {
+                    used_memory += instance_context_bytes(job_prepared);
+                }
+            }
+            fflush(stdout); // Otherwise buffered output is duplicated in the worker
+            const int64_t pid = job_prepared != NULL || num_pending[leader] == 1 ? fork_worker() : -1;
+            if (pid == 0) {
+                char path_to_log[1200];
+                sprintf(path_to_log, "%sline_%d.txt", log_dir, job->line);
+                if (freopen(path_to_log, "w", stdout) == NULL) {
+                    _Exit(1);
+                }
+#ifdef _OPENMP
+                omp_set_num_threads(num_threads);
+#endif
+                if (job_prepared == NULL) {
+                    job_prepared = prepare_job(job);
+                }
+                const bool_t success = run_job(job, job_prepared);
+                fflush(stdout);
+                _Exit(success ? 0 : 1);
+            } else if (pid > 0) {
+                pids[next] = pid;
+                used_memory += job->estimate.peak_bytes;
+                ++num_running;
+            } else { // Serial fallback
+                if (job_prepared == NULL && num_pending[leader] == 1) {
+                    job_prepared = acquire_preparation(jobs, next, leaders, prepared);
+                    used_memory += job_prepared != NULL ? instance_context_bytes(job_prepared) : 0;
+                }
+                num_failed += !run_job(job, job_prepared);
+            }
+            used_memory -= finish_preparation(next, leaders, num_pending, prepared);
+            continue;
+        }
+
+        uint8_t success;
+        const int64_t pid = wait_for_worker_id(&success);
+        if (pid < 0) {
+            break;
+        }
+        for (int idx = 0; idx < num_jobs; ++idx) {
+            if (started[idx] && pids[idx] == pid) {
+                pids[idx] = 0;
+                used_memory -= jobs[idx].estimate.peak_bytes;
+                --num_running;
+                num_failed += !success;
+                printf("Finished line %d%s\n", jobs[idx].line, success ? "" : " with an error");
+                break;
+            }
+        }
+    }
+    if (num_failed > 0) {
+        printf("Error: %d of %d jobs failed.\n", num_failed, num_jobs);
+    }
+    free(pids);
+    free(started);
+    free(leaders);
+    free(prepared);
+    free(num_pending);
+    return num_failed;
+}
@@ -0,0 +1,215 @@
+/*
+ * =============================================================================
+ *                            includes
+ * =============================================================================
+ */
+
+#include "server.h"
+#include "syslinks.h"
+
+
+/*
+ * =============================================================================
+ *                                  Macros
+ * =============================================================================
+ */
+
+#define SERVER_MEMORY_SHARE     0.5 // Share of the physical memory the cached preparations may use by default
+
+
+/*
+ * =============================================================================
+ *                                Instance cache
+ * =============================================================================
+ */
+
+static void
+evict_least_recent(instance_cache_t* cache) {
+    int oldest = 0;
+    for (int idx = 1; idx < cache->num_entries; ++idx) {
+        if (cache->entries[idx].last_use < cache->entries[oldest].last_use) {
+            oldest = idx;
+        }
+    }
+    printf("Evicting %s (%.1f MiB) from the instance cache\n", cache->entries[oldest].key.instance,
+           cache->entries[oldest].bytes / 1048576.0);
+    cache->used_bytes -= cache->entries[oldest].bytes;
+    release_instance_context(cache->entries[oldest].prepared);
+    cache->entries[oldest] = cache->entries[--cache->num_entries];
+}
+
+
+instance_context_t*
+acquire_cached_instance(instance_cache_t* cache, const job_t* job) {
+    ++cache->clock;
+    for (int idx = 0; idx < cache->num_entries; ++idx) {
+        if (same_preparation(&cache->entries[idx].key, job)) {
+            ++cache->hits;
+            cache->entries[idx].last_use = cache->clock;
+            printf("Reusing the cached preparation of %s\n", job->instance);
+            retain_instance_context(cache->entries[idx].prepared);
+            return cache->entries[idx].prepared;
+        }
+    }
+
+    ++cache->misses;
+    instance_context_t* prepared = prepare_job(job);
+    if (prepared == NULL) {
+        return NULL;
+    }
+    const double bytes = instance_context_bytes(prepared);
+    while (cache->num_entries > 0 && cache->used_bytes + bytes > cache->max_bytes) {
+        evict_least_recent(cache);
+    }
+    if (cache->num_entries == cache->capacity) {
+        cache->capacity = MAX(2 * cache->capacity, 4);
+        cache->entries = realloc(cache->entries, cache->capacity * sizeof(cache_entry_t));
+    }
+    cache_entry_t* entry = cache->entries + cache->num_entries++;
+    entry->key = *job;
+    entry->prepared = prepared; // The reference of the preparation belongs to the cache
+    entry->bytes = bytes;
+    entry->last_use = cache->clock;
+    cache->used_bytes += bytes;
+    retain_instance_context(prepared);
+    return prepared;
+}
+
+
+void
+free_instance_cache(instance_cache_t* cache) {
+    for (int idx = 0; idx < cache->num_entries; ++idx) {
+        release_instance_context(cache->entries[idx].prepared);
+    }
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->num_entries = 0;
+    cache->capacity = 0;
+    cache->used_bytes = 0;
+}
+
+
+/*
+ * =============================================================================
+ *                                   Server
+ * =============================================================================
+ */
+
+static bool_t
+serve_job(instance_cache_t* cache, const int64_t client, const job_t* job) {
+    // Preparation happens in the server so that it is cached; its output goes to the client nevertheless
+    const int64_t saved = redirect_output(client);
+    instance_context_t* prepared = acquire_cached_instance(cache, job);
+    restore_output(saved);
+    if (prepared == NULL) {
+        return FALSE;
+    }
+
+    // Workers inherit the cached preparation copy-on-write and cannot corrupt the server when they fail
+    fflush(stdout); // Otherwise buffered output is duplicated in the worker
+    const int64_t pid = fork_worker();
+    bool_t success;
+    if (pid == 0) {
+        redirect_output(client);
+        success = run_job(job, prepared);
+        fflush(stdout);
+        _Exit(success ? 0 : 1);
+    } else if (pid > 0) {
+        success = wait_for_worker();
+    } else { // Serial fallback
+        const int64_t saved_job = redirect_output(client);
+        success = run_job(job, prepared);
+        restore_output(saved_job);
+    }
+    release_instance_context(prepared);
+    return success;
+}
+
+
+static bool_t
+serve_client(
+    instance_cache_t* cache, const int64_t client, const knapsack_type_t kp_type, const char* results_log
+) {
+    FILE* requests = local_stream(client, "r");
+    FILE* replies = local_stream(client, "w");
+    if (requests == NULL || replies == NULL) {
+        if (requests != NULL) {
+            fclose(requests);
+        }
+        if (replies != NULL) {
+            fclose(replies);
+        }
+        return TRUE;
+    }
+
+    bool_t shutdown = FALSE;
+    int line_number = 0;
+    char line[4096];
+    while (!shutdown && fgets(line, sizeof(line), requests) != NULL) {
+        ++line_number;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (strcmp(line, "shutdown") == 0) {
+            fprintf(replies, "@shutdown\n");
+            shutdown = TRUE;
+        } else if (strcmp(line, "stats") == 0) {
+            fprintf(replies, "@stats entries=%d memory_mib=%.1f max_memory_mib=%.1f hits=%zu misses=%zu\n",
+                    cache->num_entries, cache->used_bytes / 1048576.0, cache->max_bytes / 1048576.0, cache->hits,
+                    cache->misses);
+        } else {
+            job_t job;
+            bool_t success = FALSE;
+            const int64_t saved = redirect_output(client); // Parse errors are reported to the client
+            const bool_t valid = parse_job(line, line_number, kp_type, &job);
+            restore_output(saved);
+            if (valid) {
+                snprintf(job.options.results_log, sizeof(job.options.results_log), "%s", results_log);
+                printf("Serving line %d (%s)\n", line_number, job.instance);
+                fflush(stdout);
+                success = serve_job(cache, client, &job);
+            }
+            fprintf(replies, "@done %d %s\n", line_number, success ? "ok" : "error");
+        }
+        fflush(replies);
+    }
+    fclose(requests);
+    fclose(replies);
+    return !shutdown;
+}
+
+
+bool_t
+serve(const char* path, const knapsack_type_t kp_type, const char* results_log, const uint64_t max_bytes) {
+    const int64_t server = listen_local(path);
+    if (server < 0) {
+        printf("Error: Could not listen on %s; the path may be taken by another file or local sockets may not be "
+               "supported on this platform.\n", path);
+        return FALSE;
+    }
+
+    instance_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.max_bytes = max_bytes > 0 ? (double) max_bytes : SERVER_MEMORY_SHARE * (double) physical_memory();
+    printf("Serving on %s with %.1f MiB for cached instances\n", path, cache.max_bytes / 1048576.0);
+    fflush(stdout);
+
+    bool_t running = TRUE, failed = FALSE;
+    while (running) {
+        const int64_t client = accept_local(server);
+        if (client < 0) { // Persistent, e.g. out of descriptors, so retrying would only spin
+            printf("Error: Could not accept a client on %s.\n", path);
+            failed = TRUE;
+            break;
+        }
+        running = serve_client(&cache, client, kp_type, results_log);
+        close_local(client);
+    }
+
+    free_instance_cache(&cache);
+    close_local(server);
+    remove(path);
+    printf("Server on %s stopped\n", path);
+    return !failed;
+}
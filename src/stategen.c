@@ -172,3 +172,39 @@ qtg(const knapsack_t *k, size_t bias, \
     // printf("Number of states after QTG: %zu\n", *num_states);
     return parent;
 }
+
+/* 
+ * =============================================================================
+ *                            QTG state count
+ * =============================================================================
+ */
+
+bool_t
+qtg_layer_sizes(const knapsack_t *k, size_t max_entries, double layer_sizes[]) {
+    /*
+     * Costs are divided by a power of two until the table over all used
+     * capacities fits. Rounding them down keeps every feasible path feasible,
+     * so the counts then become upper bounds.
+     */
+    num_t scale = 1;
+    while ((size_t) (k->capacity / scale) + 1 > max_entries) {
+        scale *= 2;
+    }
+    const num_t capacity = k->capacity / scale;
+    /* counts[c] is the number of nodes in the current layer using cost c */
+    double *counts = calloc(capacity + 1, sizeof(double));
+    counts[0] = 1.;
+    layer_sizes[0] = 1.;
+    for (bit_t i = 0; i < k->size; ++i) {
+        const num_t cost = k->items[i].cost / scale;
+        for (num_t c = capacity; c >= cost; --c) {
+            counts[c] += counts[c - cost]; /* right branch, if affordable */
+        }
+        layer_sizes[i + 1] = 0.;
+        for (num_t c = 0; c <= capacity; ++c) {
+            layer_sizes[i + 1] += counts[c];
+        }
+    }
+    free(counts);
+    return scale == 1;
+}
@@ -9,6 +9,9 @@
 #include <windows.h>
 #include <direct.h>
 #include <intrin.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 /* 
  * =============================================================================
@@ -45,6 +48,142 @@ create_dir(const char* dirname) {
 	return _mkdir(dirname);
 }
 
+/* 
+ * =============================================================================
+ *                            Windows: wall-clock time
+ * =============================================================================
+ */
+
+double
+wall_time() {
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (double) counter.QuadPart / (double) frequency.QuadPart;
+}
+
+/* 
+ * =============================================================================
+ *                            Windows: worker processes
+ * =============================================================================
+ */
+
+uint32_t
+num_processors() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+int64_t
+fork_worker() {
+	return -1; // No fork on Windows; callers fall back to serial execution
+}
+
+uint8_t
+wait_for_worker() {
+	return 0;
+}
+
+int64_t
+wait_for_worker_id(uint8_t* success) {
+	*success = 0;
+	return -1;
+}
+
+uint64_t
+physical_memory() {
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	return GlobalMemoryStatusEx(&status) ? (uint64_t) status.ullTotalPhys : 0;
+}
+
+/* 
+ * =============================================================================
+ *                            Windows: local sockets
+ * =============================================================================
+ */
+
+int64_t
+listen_local(const char* path) {
+	return -1; // Named pipes are not supported; callers report that serving is unavailable
+}
+
+int64_t
+accept_local(int64_t server) {
+	return -1;
+}
+
+void
+close_local(int64_t fd) {
+}
+
+FILE*
+local_stream(int64_t fd, const char* mode) {
+	return NULL;
+}
+
+int64_t
+redirect_output(int64_t fd) {
+	return -1;
+}
+
+void
+restore_output(int64_t saved) {
+}
+
+/* 
+ * =============================================================================
+ *                            Windows: shared files
+ * =============================================================================
+ */
+
+uint8_t
+append_file(const char* path, const char* data, size_t size) {
+	const int fd = _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+	if (fd < 0) {
+		return 0;
+	}
+	const int written = _write(fd, data, (unsigned int) size);
+	_close(fd);
+	return written == (int) size;
+}
+
+uint8_t
+seek_file(FILE* file, uint64_t offset) {
+	return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+}
+
+int64_t
+tell_file(FILE* file) {
+	return _ftelli64(file);
+}
+
+int64_t
+list_dir(const char* path, char*** names) {
+	char pattern[MAX_PATH];
+	snprintf(pattern, sizeof(pattern), "%s\\*", path);
+	WIN32_FIND_DATAA entry;
+	HANDLE handle = FindFirstFileA(pattern, &entry);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+	int64_t num_names = 0, capacity = 16;
+	*names = malloc(capacity * sizeof(char*));
+	do {
+		if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) {
+			continue;
+		}
+		if (num_names == capacity) {
+			capacity *= 2;
+			*names = realloc(*names, capacity * sizeof(char*));
+		}
+		(*names)[num_names++] = _strdup(entry.cFileName);
+	} while (FindNextFileA(handle, &entry));
+	FindClose(handle);
+	return num_names;
+}
+
 #else
 
 /* 
@@ -53,9 +192,19 @@ create_dir(const char* dirname) {
  * =============================================================================
  */
 
+#define _FILE_OFFSET_BITS 64 // 64-bit off_t for fseeko and ftello on 32-bit systems
 #include "syslinks.h"
 #include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
 
 /* 
  * =============================================================================
@@ -90,4 +239,186 @@ create_dir(const char* dirname) {
 	return !mkdir(dirname, 0777);
 }
 
+/* 
+ * =============================================================================
+ *                            Unix/Apple: wall-clock time
+ * =============================================================================
+ */
+
+double
+wall_time() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + 1e-9 * (double) now.tv_nsec;
+}
+
+/* 
+ * =============================================================================
+ *                            Unix/Apple: worker processes
+ * =============================================================================
+ */
+
+uint32_t
+num_processors() {
+	const long num = sysconf(_SC_NPROCESSORS_ONLN);
+	return num > 0 ? (uint32_t) num : 1;
+}
+
+int64_t
+fork_worker() {
+	return fork();
+}
+
+uint8_t
+wait_for_worker() {
+	int status;
+	if (wait(&status) < 0) {
+		return 0;
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int64_t
+wait_for_worker_id(uint8_t* success) {
+	int status;
+	const pid_t pid = wait(&status);
+	*success = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	return pid;
+}
+
+uint64_t
+physical_memory() {
+	const long num_pages = sysconf(_SC_PHYS_PAGES);
+	const long page_size = sysconf(_SC_PAGESIZE);
+	return num_pages > 0 && page_size > 0 ? (uint64_t) num_pages * (uint64_t) page_size : 0;
+}
+
+/* 
+ * =============================================================================
+ *                            Unix/Apple: local sockets
+ * =============================================================================
+ */
+
+int64_t
+listen_local(const char* path) {
+	struct sockaddr_un address;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	struct stat status;
+	if (lstat(path, &status) == 0) {
+		if (!S_ISSOCK(status.st_mode)) {
+			return -1; // Never replace anything but a socket
+		}
+		unlink(path); // A socket left behind by a previous server
+	}
+
+	const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0) {
+		return -1;
+	}
+	if (bind(server, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(server, 4) < 0) {
+		close(server);
+		return -1;
+	}
+	signal(SIGPIPE, SIG_IGN); // A client that hangs up must not terminate the server
+	return server;
+}
+
+int64_t
+accept_local(int64_t server) {
+	int client;
+	do { // Interrupted calls and clients that hung up before being accepted are no failures of the socket
+		client = accept((int) server, NULL, NULL);
+	} while (client < 0 && (errno == EINTR || errno == ECONNABORTED));
+	return client;
+}
+
+void
+close_local(int64_t fd) {
+	close((int) fd);
+}
+
+FILE*
+local_stream(int64_t fd, const char* mode) {
+	const int copy = dup((int) fd);
+	FILE* stream = copy >= 0 ? fdopen(copy, mode) : NULL;
+	if (stream == NULL && copy >= 0) {
+		close(copy);
+	}
+	return stream;
+}
+
+int64_t
+redirect_output(int64_t fd) {
+	fflush(stdout);
+	const int saved = dup(STDOUT_FILENO);
+	if (saved >= 0) {
+		dup2((int) fd, STDOUT_FILENO);
+	}
+	return saved;
+}
+
+void
+restore_output(int64_t saved) {
+	fflush(stdout);
+	if (saved >= 0) {
+		dup2((int) saved, STDOUT_FILENO);
+		close((int) saved);
+	}
+}
+
+/* 
+ * =============================================================================
+ *                            Unix/Apple: shared files
+ * =============================================================================
+ */
+
+uint8_t
+append_file(const char* path, const char* data, size_t size) {
+	const int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (fd < 0) {
+		return 0;
+	}
+	const ssize_t written = write(fd, data, size);
+	close(fd);
+	return written == (ssize_t) size;
+}
+
+uint8_t
+seek_file(FILE* file, uint64_t offset) {
+	return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+}
+
+int64_t
+tell_file(FILE* file) {
+	return ftello(file);
+}
+
+int64_t
+list_dir(const char* path, char*** names) {
+	DIR* dir = opendir(path);
+	if (dir == NULL) {
+		return -1;
+	}
+	int64_t num_names = 0, capacity = 16;
+	*names = malloc(capacity * sizeof(char*));
+	for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+			continue;
+		}
+		if (num_names == capacity) {
+			capacity *= 2;
+			*names = realloc(*names, capacity * sizeof(char*));
+		}
+		(*names)[num_names++] = strdup(entry->d_name);
+	}
+	closedir(dir);
+	return num_names;
+}
+
 #endif
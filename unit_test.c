@@ -2,8 +2,29 @@
 #include "stategen.h"
 #include "knapsack.h"
 #include "include/qaoa.h"
+#include "include/batch.h"
+#include "include/runner.h"
+#include "include/results.h"
 
 int main() {
+    // Check, if the Copula mixer couples every pair of neighbours on the ring exactly once, closing it by (n - 1, 0)
+    const bit_t ring_sizes[3] = {4, 5, 10};
+    const char* should_be_pairs[3] = {
+        "1-2 3-0 0-1 2-3 ", "1-2 3-4 0-1 2-3 4-0 ", "1-2 3-4 5-6 7-8 9-0 0-1 2-3 4-5 6-7 8-9 "
+    };
+    int correct_pairs = 1;
+    for (int ring = 0; ring < 3; ++ring) {
+        int pairs[16][2];
+        char listed[128] = "";
+        const int num_pairs = copula_mixer_pairs(ring_sizes[ring], pairs);
+        for (int pair = 0; pair < num_pairs; ++pair) {
+            sprintf(listed + strlen(listed), "%d-%d ", pairs[pair][0], pairs[pair][1]);
+        }
+        if (strcmp(listed, should_be_pairs[ring]) != 0) correct_pairs = 0;
+    }
+    if (correct_pairs) printf("Correct Copula mixer pairs!\n");
+    else printf("Incorrect Copula mixer pairs!\n");
+
     knapsack_t *k = create_empty_knapsack(4, 10);
     k->items[0].profit = 5;
     k->items[0].cost = 2;
@@ -58,16 +79,20 @@ int main() {
     array_t cur;
     sw_init(cur, 4);
     for (int i = 0; i < 4; ++i) { if (k->items[i].included == 1) sw_setbit(cur, i); }
-    qtg_nodes = qtg(k, 1, cur, &num_states);
+    const run_options_t options = default_run_options();
+    qaoa_context_t* ctx = create_context(k, QTG, 0, POWELL, 0, 1, 0, 0, 0, LINEAR, &options);
+    ctx->qtg_nodes = qtg(k, 1, cur, &ctx->num_states, LINEAR);
+    build_profit_table(ctx);
+    prepare_initial_state(ctx);
 
     // Check, if the routine "qtg" worked properly
     // bias = 1
-    if (num_states == 8) printf("Correct number of states!\n");
+    if (ctx->num_states == 8) printf("Correct number of states!\n");
     int correct_prob = 1, correct_profit = 1, correct_vector = 1;
-    for (int i = 0; i < num_states; ++i) {
-        if (qtg_nodes[i].path.tot_profit != should_be[i].path.tot_profit) correct_profit = 0;
-        if (qtg_nodes[i].prob != should_be[i].prob) correct_prob = 0;
-        if (!sw_cmp(should_be[i].path.vector, qtg_nodes[i].path.vector)) correct_vector = 0;
+    for (int i = 0; i < ctx->num_states; ++i) {
+        if (ctx->qtg_nodes[i].path.tot_profit != should_be[i].path.tot_profit) correct_profit = 0;
+        if (ctx->qtg_nodes[i].prob != should_be[i].prob) correct_prob = 0;
+        if (!sw_cmp(should_be[i].path.vector, ctx->qtg_nodes[i].path.vector)) correct_vector = 0;
     }
     if (correct_prob) printf("Correct probabilities!\n");
     else printf("Incorrect Probabilities!\n");
@@ -77,14 +102,14 @@ int main() {
     else printf("Incorrect Vectors!\n");
 
     // Check, if we get the same expectation value, if we use the angles=(0,0)
-    depth = 1;
+    ctx->depth = 1;
     double opt_angles[2];
     opt_angles[0] = 0;
     opt_angles[1] = 0;
-    cbs_t* opt_angle_state = quasiadiabatic_evolution(opt_angles);
+    cmplx* opt_angle_state = quasiadiabatic_evolution(ctx, opt_angles);
     double exp = 0;
-    for (int l = 0; l < num_states; ++l) {
-        exp += pow(cabs(opt_angle_state[l].amplitude), 2) * (double) opt_angle_state[l].profit;
+    for (int l = 0; l < ctx->num_states; ++l) {
+        exp += pow(cabs(opt_angle_state[l]), 2) * (double) get_profit(&ctx->sol_profits, l);
     }
     if (fabs(exp - 6.74074) < pow(10, -5)) printf("Correct Expectation for p=1 angles=(0,0)!\n");
     else printf("Incorrect Expectation for p=1 angles=(0,0)!\n");
@@ -92,11 +117,200 @@ int main() {
     // Check, if we get the same expectation value, if we use the angles=(0.11,0.22)
     opt_angles[0] = 0.11;
     opt_angles[1] = 0.22;
-    opt_angle_state = quasiadiabatic_evolution(opt_angles);
+    opt_angle_state = quasiadiabatic_evolution(ctx, opt_angles);
     exp = 0;
-    for (int l = 0; l < num_states; ++l) {
-        exp += pow(cabs(opt_angle_state[l].amplitude), 2) * (double) opt_angle_state[l].profit;
+    for (int l = 0; l < ctx->num_states; ++l) {
+        exp += pow(cabs(opt_angle_state[l]), 2) * (double) get_profit(&ctx->sol_profits, l);
     }
     printf("%f\n", exp);
+
+    // Check, if the histogram over distinct profits reproduces the expectation value
+    distribution_t dist;
+    build_distribution(ctx, opt_angle_state, &dist);
+    double dist_exp = 0;
+    for (size_t l = 0; l < dist.num_profits; ++l) {
+        dist_exp += dist.probs[l] * (double) dist.profits[l];
+    }
+    if (dist.num_profits == 7 && fabs(dist_exp - exp) < pow(10, -9)) printf("Correct distribution!\n");
+    else printf("Incorrect distribution!\n");
+    free_distribution(&dist);
 //    if (fabs(exp - 6.74074) < pow(10, -5)) printf("Correct Expectation for p=1 angles=(0,0)!\n");
+
+    // Check, if three betas determine the expectation value for any beta, as the Grover mixer is of order 1 in beta
+    double interpolant = 0;
+    for (int sample = 0; sample < 3; ++sample) {
+        opt_angles[1] = sample * 2 * M_PI / 3;
+        opt_angle_state = quasiadiabatic_evolution(ctx, opt_angles);
+        double sample_exp = 0;
+        for (int l = 0; l < ctx->num_states; ++l) {
+            sample_exp += pow(cabs(opt_angle_state[l]), 2) * (double) get_profit(&ctx->sol_profits, l);
+        }
+        interpolant += sample_exp * dirichlet_kernel(3, 0.22 - opt_angles[1]);
+    }
+    if (fabs(interpolant - exp) < pow(10, -9)) printf("Correct interpolation in beta!\n");
+    else printf("Incorrect interpolation in beta!\n");
+
+    // Check, if the lockstep evaluation of a batch reproduces the evolution of every single instance
+    instance_context_t prepared;
+    memset(&prepared, 0, sizeof(prepared));
+    prepared.num_states = ctx->num_states;
+    prepared.qtg_nodes = ctx->qtg_nodes;
+    prepared.sol_profits = ctx->sol_profits;
+    prepared.gamma_period = 2 * M_PI;
+    instance_context_t* batch_prepared[2] = {&prepared, &prepared};
+    batch_t* batch = create_batch(batch_prepared, 2, 2);
+    const double batch_angles[8] = {0.11, 0.22, 0.35, 1.4, 0.5, 2.1, 0.7, 0.9};
+    double batch_values[2];
+    evaluate_batch(batch, batch_angles, 2, batch_values);
+    ctx->depth = 2;
+    int correct_batch = 1;
+    for (int instance = 0; instance < 2; ++instance) {
+        opt_angle_state = quasiadiabatic_evolution(ctx, batch_angles + 4 * instance);
+        double single_exp = 0;
+        for (int l = 0; l < ctx->num_states; ++l) {
+            single_exp += pow(cabs(opt_angle_state[l]), 2) * (double) get_profit(&ctx->sol_profits, l);
+        }
+        if (fabs(batch_values[instance] - single_exp) > pow(10, -9)) correct_batch = 0;
+    }
+    if (correct_batch) printf("Correct batch evaluation!\n");
+    else printf("Incorrect batch evaluation!\n");
+    free_batch(batch);
+    free_context(ctx);
+
+    // Check, if benchmark lines choose their objective function, so that linear instances can be run
+    job_t job;
+    const int correct_kp = parse_job("qkp4 qtg 1 powell 10 2 10 -1 20", 1, QUADRATIC, &job) && job.kp_type == QUADRATIC
+        && parse_job("n_10 copula 2 powell 10 2 10 -1 20 kp=linear backend=mps", 2, QUADRATIC, &job)
+        && job.kp_type == LINEAR && job.options.backend == MPS;
+    if (correct_kp) printf("Correct objective functions of the lines!\n");
+    else printf("Incorrect objective functions of the lines!\n");
+
+    // Check, if the singular value decomposition reproduces the matrix
+    const cmplx mat[6] = {1 + 2 * I, -0.5, 3 * I, 2 - I, 0.25 + I, -1};
+    cmplx u[6], v[4];
+    double sing[2];
+    svd(mat, 3, 2, u, sing, v);
+    double svd_error = 0;
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 2; ++col) {
+            cmplx entry = 0;
+            for (int idx = 0; idx < 2; ++idx) entry += u[row * 2 + idx] * sing[idx] * conj(v[col * 2 + idx]);
+            svd_error = fmax(svd_error, cabs(entry - mat[row * 2 + col]));
+        }
+    }
+    if (svd_error < pow(10, -12) && sing[0] >= sing[1]) printf("Correct singular value decomposition!\n");
+    else printf("Incorrect singular value decomposition!\n");
+
+    // Linear Copula instance with 10 items, whose phases are factorised and which the MPS backend can simulate
+    knapsack_t *lin_k = create_empty_knapsack(10, 60);
+    const num_t lin_profits[10] = {14, 9, 23, 5, 17, 11, 8, 20, 6, 13};
+    const num_t lin_costs[10] = {12, 7, 19, 6, 15, 10, 9, 16, 4, 11};
+    for (int i = 0; i < 10; ++i) {
+        lin_k->items[i].profit = lin_profits[i];
+        lin_k->items[i].cost = lin_costs[i];
+    }
+    run_options_t lin_options = default_run_options();
+    qaoa_context_t* lin_ctx = create_context(lin_k, COPULA, 2, POWELL, 0, 0, 10, -1, 0, LINEAR, &lin_options);
+    num_t lin_greedy, lin_optimal;
+    prepare_instance(lin_ctx, &lin_greedy, &lin_optimal);
+    build_prob_dist_vals(lin_ctx);
+    prepare_initial_state(lin_ctx);
+
+    // Check, if the factorised phase separator multiplies every state by the phase of its total profit
+    const double lin_angles[4] = {0.31, 0.87, 0.12, 2.3};
+    cmplx* lin_state = quasiadiabatic_evolution(lin_ctx, lin_angles);
+    cmplx* phased = malloc(lin_ctx->num_states * sizeof(cmplx));
+    memcpy(phased, lin_state, lin_ctx->num_states * sizeof(cmplx));
+    phase_separation_unitary(lin_ctx, phased, lin_angles[0]);
+    double phase_error = 0;
+    for (size_t l = 0; l < lin_ctx->num_states; ++l) {
+        num_t profit = 0;
+        for (int i = 0; i < 10; ++i) if (l >> i & 1) profit += lin_k->items[i].profit;
+        phase_error = fmax(phase_error, cabs(phased[l] - lin_state[l] * cexp(-I * lin_angles[0] * profit)));
+    }
+    if (phase_error < pow(10, -12)) printf("Correct factorised phase separation!\n");
+    else printf("Incorrect factorised phase separation!\n");
+    free(phased);
+
+    // Check, if the MPS backend agrees with the state vector without truncation, and only approximately with it
+    const double sv_exp = expectation_value(lin_ctx, lin_state);
+    double mps_exp[2], mps_trunc[2];
+    const int bonds[2] = {32, 2};
+    for (int run = 0; run < 2; ++run) {
+        lin_options.backend = MPS;
+        lin_options.max_bond_dim = bonds[run];
+        qaoa_context_t* mps_ctx = create_context(lin_k, COPULA, 2, POWELL, 0, 0, 10, -1, 0, LINEAR, &lin_options);
+        mps_ctx->gamma_period = lin_ctx->gamma_period;
+        build_prob_dist_vals(mps_ctx);
+        mps_t* mps = mps_quasiadiabatic_evolution(mps_ctx, lin_angles);
+        mps_exp[run] = mps_feasible_expectation(mps, lin_k);
+        mps_trunc[run] = mps->trunc_weight;
+        free_mps(mps);
+        free_context(mps_ctx);
+    }
+    if (fabs(mps_exp[0] - sv_exp) < pow(10, -8) && mps_trunc[0] < pow(10, -20)) printf("Correct MPS expectation!\n");
+    else printf("Incorrect MPS expectation!\n");
+    if (mps_trunc[1] > 0 && fabs(mps_exp[1] - sv_exp) > pow(10, -8)) printf("Correct MPS truncation!\n");
+    else printf("Incorrect MPS truncation!\n");
+    free(lin_state);
+    free_context(lin_ctx);
+    free_knapsack(lin_k);
+
+    // Check, if a record survives its way through the results log, also when continuing a torn record
+    const char* log_path = "unit_test_results.log";
+    remove(log_path);
+    result_record_t imported = {
+        .key = {"test_instance", "copula", 1, "powell", ""}, .num_states = 1024, .optimal_sol_val = 300,
+        .greedy_ratio = 0.9, .approx_ratio = 0.8, .prob_beating_greedy = 0.1
+    };
+    format_result_params(imported.key.params, -1, -1, 10, -1, "");
+    result_record_t live = imported;
+    format_result_params(live.key.params, 10, 2, 10, -1, "grid=8");
+    live.approx_ratio = 0.85;
+    live.num_evals = 77;
+    live.elapsed = 1.5;
+    result_record_t other = imported;
+    strcpy(other.key.instance, "other_instance");
+    format_result_params(other.key.params, -1, -1, NAN, NAN, "");
+    append_result(log_path, &imported);
+    append_result(log_path, &other);
+    append_result(log_path, &live);
+    live.approx_ratio = 0.875;
+    append_result(log_path, &live);
+
+    FILE* log_file = fopen(log_path, "r");
+    char log_line[RESULT_MAX_LINE];
+    for (int line = 0; line < 3; ++line) fgets(log_line, sizeof(log_line), log_file);
+    fclose(log_file);
+    log_file = fopen(log_path, "a");
+    fputs("@result\tgarbage\n", log_file);
+    fwrite(log_line, 1, strlen(log_line) / 2, log_file); // Torn by a crash, then continued by the next record
+    fputs(log_line, log_file);
+    fclose(log_file);
+
+    result_record_t parsed;
+    if (strcmp(imported.key.params, "m=? bias=? k=10 theta=-1") == 0
+        && strcmp(live.key.params, "m=10 bias=2 k=10 theta=-1 grid=8") == 0) printf("Correct result parameters!\n");
+    else printf("Incorrect result parameters!\n");
+    if (parse_result(log_line, &parsed) && strcmp(parsed.key.params, live.key.params) == 0
+        && parsed.num_evals == 77 && parsed.approx_ratio == 0.85 && parsed.elapsed == 1.5
+        && !parse_result("@result\tgarbage", &parsed)) printf("Correct result record!\n");
+    else printf("Incorrect result record!\n");
+
+    // Check, if the index keeps the latest record per key, and the live run replaces the imported one of it
+    results_index_t index;
+    const result_record_t* found_live = NULL;
+    const result_record_t* found_other = NULL;
+    result_key_t other_live = other.key;
+    format_result_params(other_live.params, 10, 2, 10, -1, "");
+    if (load_results_index(log_path, &index)) {
+        found_live = lookup_result(&index, &live.key);
+        found_other = lookup_result(&index, &other_live);
+    }
+    if (index.num_records == 2 && index.num_superseded == 3 && index.num_damaged == 1
+        && found_live != NULL && found_live->approx_ratio == 0.85 && found_other != NULL
+        && strcmp(found_other->key.instance, "other_instance") == 0) printf("Correct results index!\n");
+    else printf("Incorrect results index!\n");
+    free_results_index(&index);
+    remove(log_path);
 }
\ No newline at end of file